@@ -0,0 +1,133 @@
+/*
+ * BlobMetadataCache.h
+ *
+ * Copyright (c) 2016, Andreas Griesshammer <andreas@formationds.com>
+ * Copyright (c) 2016, Formation Data Systems
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _BLOBMETADATACACHE_H
+#define _BLOBMETADATACACHE_H
+
+// System includes
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+
+// FDS includes
+#include "xdi/ApiTypes.h"
+#include "IntervalIndex.h"
+
+namespace fds {
+namespace block {
+
+/**
+ * The BlobMetadataCache keeps the offset to ObjectId mapping of the volume
+ * blob so tasks can skip the ReadBlob when every offset they cover is known.
+ * Offsets known to have no object are kept as holes with an empty ObjectId.
+ *
+ * The mapping is learned from ReadBlob responses and updated whenever one of
+ * our WriteBlobs succeeds. It is only authoritative as long as nobody else
+ * modifies the blob, the invalidation rules are:
+ *  - a failed WriteBlob or ReadBlob drops the range, its state is unknown
+ *  - extents older than the configured lifetime are ignored and get refreshed
+ *    by the next ReadBlob, this bounds how long a change made by another
+ *    access manager can go unnoticed. A lifetime of 0 disables the cache.
+ *  - a ReadBlob response only fills offsets that are not known yet, and not
+ *    at all if anything was dropped after the ReadBlob was sent, so a stale
+ *    response can't overwrite what a later WriteBlob committed.
+ *  - once maxExtents is exceeded everything is dropped.
+ */
+class BlobMetadataCache {
+    using clock = std::chrono::steady_clock;
+
+    struct Extent {
+        xdi::ObjectOffsetVal    numObjects {1};
+        xdi::ObjectId           id;
+        clock::time_point       stamp;
+    };
+    using extent_index = IntervalIndex<xdi::ObjectOffsetVal, Extent>;
+
+public:
+    using object_map = std::map<xdi::ObjectOffsetVal, xdi::ObjectId>;
+
+    struct Stats {
+        uint64_t hits {0};
+        uint64_t misses {0};
+        uint64_t invalidations {0};
+        size_t   extents {0};
+    };
+
+    BlobMetadataCache(size_t const maxExtents, std::chrono::milliseconds const lifetime);
+    BlobMetadataCache(BlobMetadataCache const&) = delete;
+    BlobMetadataCache& operator=(BlobMetadataCache const&) = delete;
+
+    bool enabled() const { return (0 < _lifetime.count()); }
+
+    /**
+     * \return a token to pass to populate() for a ReadBlob sent now
+     */
+    uint64_t version() const { return _version.load(); }
+
+    /**
+     * Fill objects with the ObjectIds of [start, end] like a ReadBlob
+     * response would, holes are left out.
+     * \return false if any offset in the range is unknown
+     */
+    bool lookup(xdi::ObjectOffsetVal const start, xdi::ObjectOffsetVal const end, object_map& objects);
+
+    // Learn [start, end] from a ReadBlob response sent at version
+    void populate
+    (
+      xdi::ObjectOffsetVal const    start,
+      xdi::ObjectOffsetVal const    end,
+      object_map const&             objects,
+      uint64_t const                version
+    );
+
+    // [start, end] was committed with id by a WriteBlob
+    void assign(xdi::ObjectOffsetVal const start, xdi::ObjectOffsetVal const end, xdi::ObjectId const& id);
+
+    void invalidate(xdi::ObjectOffsetVal const start, xdi::ObjectOffsetVal const end);
+    void clear();
+
+    Stats getStats();
+
+private:
+    void isolate(xdi::ObjectOffsetVal const start, xdi::ObjectOffsetVal const end);
+    void split(xdi::ObjectOffsetVal const offset);
+    void erase(xdi::ObjectOffsetVal const start, xdi::ObjectOffsetVal const end);
+    void add(xdi::ObjectOffsetVal const start, xdi::ObjectOffsetVal const end, xdi::ObjectId const& id, clock::time_point const stamp);
+    bool expired(Extent const& extent, clock::time_point const now) const;
+    void checkLimit();
+
+    size_t const                        _maxExtents;
+    std::chrono::milliseconds const     _lifetime;
+
+    std::mutex                          _lock;
+    extent_index                        _extents;
+
+    // Bumped whenever known state is dropped
+    std::atomic<uint64_t>               _version {1};
+
+    std::atomic<uint64_t>               _hits {0};
+    std::atomic<uint64_t>               _misses {0};
+    std::atomic<uint64_t>               _invalidations {0};
+};
+
+} // namespace block
+} // namespace fds
+
+#endif // _BLOBMETADATACACHE_H
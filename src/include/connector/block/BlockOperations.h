@@ -21,17 +21,23 @@
 #ifndef BLOCKOPERATIONS_H_
 #define BLOCKOPERATIONS_H_
 
+#include <atomic>
+#include <chrono>
+#include <deque>
 #include <map>
 #include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 #include <memory>
+#include <mutex>
 #include <queue>
 
 #include "xdi/ApiResponseInterface.h"
 #include "BlockTask.h"
 #include "BlockTools.h"
+#include "BufferView.h"
+#include "TaskTable.h"
 #include "xdi/ApiTypes.h"
 
 #define EMPTY_ID "0000000000000000000000000000000000000000"
@@ -43,6 +49,14 @@ namespace xdi {
 namespace fds {
 namespace block {
 
+class BlobMetadataCache;
+class BufferPool;
+class CommitGroup;
+class ObjectCache;
+class ReadAhead;
+class TaskPool;
+class WriteBarrier;
+class WriteCombiner;
 class WriteContext;
 
 enum class BlockError : uint8_t {
@@ -57,6 +71,12 @@ enum class BlockError : uint8_t {
  * rollup all happens in here allowing block connectors to issue their requests
  * as fast as possible without having to deal with consistency themselves and
  * map I/O to XdiAsyncDataApi calls.
+ *
+ * Every connection to a volume runs its tasks on an engine, a BlockOperations
+ * of the volume shared by all connections to it. Write ordering, caches and
+ * the tasks in flight are kept there so overlapping writes from different
+ * connections are serialized like those of a single one. Each task is
+ * responded to by the connection it was executed on.
  */
 class BlockOperations
     :   public xdi::ApiResponseInterface
@@ -71,19 +91,103 @@ class BlockOperations
     using read_map = std::map<uint32_t, xdi::ObjectId>;
     using write_map = std::map<uint32_t, std::shared_ptr<std::string>>;
 
-    typedef std::unordered_map<int64_t, task_type*> response_map_type;
+    typedef TaskTable<task_type> response_map_type;
+
+    /**
+     * WriteContext state is partitioned by object offset. Offsets are grouped
+     * into regions which are spread over the stripes, each stripe has its own
+     * WriteContext and lock. Operations spanning stripes take the locks in
+     * ascending stripe order. The regions of a stripe are contiguous in its
+     * WriteContext, so an operation has a single range in each stripe.
+     */
+    struct WriteStripe {
+        std::mutex                      lock;
+        std::shared_ptr<WriteContext>   ctx;
+    };
+
+    // Part of an object range that falls into a single stripe, start and end
+    // are the first and last offsets of the range the stripe owns
+    struct StripeRange {
+        size_t      stripe;
+        uint64_t    start;
+        uint64_t    end;
+    };
+    using stripe_ranges = std::vector<StripeRange>;
+
+    struct StripeLock {
+        StripeLock(BlockOperations& ops, stripe_ranges const& ranges);
+        void unlock() { locks.clear(); }
+      private:
+        std::vector<std::unique_lock<std::mutex>>   locks;
+    };
   public:
 
     BlockOperations(std::shared_ptr<xdi::ApiInterface> interface);
     explicit BlockOperations(BlockOperations const& rhs) = delete;
     BlockOperations& operator=(BlockOperations const& rhs) = delete;
-    ~BlockOperations() = default;
+    ~BlockOperations();
 
     void init(std::string                      vol_name,
               uint64_t const                   vol_id,
               uint32_t const                   obj_size);
     void detachVolume();
 
+    // Memory limit of the object cache for volumes attached from now on,
+    // 0 disables caching
+    static void setObjectCacheSize(size_t const bytes);
+    std::shared_ptr<ObjectCache> getObjectCache() const { return objectCache; }
+
+    // Limits of the blob metadata cache for volumes attached from now on,
+    // a lifetime of 0 disables it
+    static void setBlobMetadataCache(size_t const maxExtents, std::chrono::milliseconds const lifetime);
+    std::shared_ptr<BlobMetadataCache> getBlobMetadataCache() const { return blobMetadata; }
+
+    // Memory kept in free object buffers for volumes attached from now on,
+    // 0 allocates every buffer
+    static void setBufferPoolSize(size_t const bytes);
+    std::shared_ptr<BufferPool> getBufferPool() const { return bufferPool; }
+
+    // Tasks of this connection are taken from here, finished tasks go back
+    std::shared_ptr<TaskPool> getTaskPool() const { return taskPool; }
+
+    // How long writes smaller than an object are held back to be combined
+    // with adjacent ones for volumes attached from now on, 0 disables it
+    static void setWriteCombineWindow(std::chrono::microseconds const window);
+    std::shared_ptr<WriteCombiner> getWriteCombiner() const { return engine->writeCombiner; }
+
+    // Ranges ready to be committed are sent as one WriteBlob every interval
+    // or once maxRanges are ready, for volumes attached from now on. An
+    // interval of 0 sends every WriteBlob right away.
+    static void setCommitGroup(std::chrono::microseconds const interval, size_t const maxRanges);
+    std::shared_ptr<CommitGroup> getCommitGroup() const { return engine->commitGroup; }
+
+    // Tasks that can be in flight on volumes attached from now on, shared by
+    // all of a volume's connections. Should cover their total queue depth
+    // and the writes held back, a task beyond it fails with a retryable error.
+    static void setTaskTableSize(size_t const tasks);
+
+    // Flushes wait here for the writes executed before them
+    std::shared_ptr<WriteBarrier> getWriteBarrier() const { return engine->writeBarrier; }
+
+    // Read ahead window in objects for sequential reads on volumes attached
+    // from now on. A max of 0 disables it.
+    static void setReadAheadWindow(uint32_t const minObjects, uint32_t const maxObjects);
+    std::shared_ptr<ReadAhead> getReadAhead() const { return readAhead; }
+
+    // Number of readObjects of holes answered locally with zeros
+    uint64_t getHoleReadsAvoided() const { return engine->holeReadsAvoided.load(); }
+
+    // Number of object writes of all zeros committed as holes instead
+    uint64_t getZeroObjectsSkipped() const { return engine->zeroObjectsSkipped.load(); }
+
+    // Number of WRITE SAMEs whose full object was already built
+    uint64_t getPatternHits() const { return engine->patternHits.load(); }
+
+    // Buffers for a write of length bytes at offset split at object
+    // boundaries, handed to WriteTask::setWriteBuffers they let full objects
+    // be written without another copy
+    void allocateWriteBuffers(uint64_t const offset, size_t const length, std::vector<string_ptr>& bufs);
+
     void executeTask(RWTask* task);
 
     void shutdown();
@@ -104,20 +208,61 @@ class BlockOperations
     void listAllVolumesResp(xdi_handle const&, xdi::ListAllVolumesResponse const&, xdi_error const&) override {};
 
   private:
+    void attach(uint64_t const vol_id, uint32_t const obj_size);
+    void stop();
+    void disown();
+
+    void runTask(RWTask* task);
+
     void finishResponse(task_type* response);
+    void respond(task_type* response);
 
     std::pair<bool,std::shared_ptr<std::string>>
-     drainUpdateChain(xdi_handle const&             requestId,
+     drainUpdateChain(WriteContext&                 writeCtx,
+                      xdi_handle const&             requestId,
                       uint64_t const                offset);
 
+    WriteStripe& stripeFor(uint64_t const offset);
+
+    bool stripeRange(size_t const stripe, uint64_t const start, uint64_t const end, StripeRange& range) const;
+
+    void stripeRanges(uint64_t const start, uint64_t const end, stripe_ranges& ranges) const;
+
+    bool addPendingWrite(stripe_ranges& ranges, BlockTask* task);
+
+    bool inRanges(stripe_ranges const& ranges, uint64_t const offset) const;
+
+    void sendWriteBlob
+    (
+      BlockTask* task,
+      xdi_handle const& requestId,
+      WriteContext& writeCtx,
+      uint64_t const offset,
+      std::unique_lock<std::mutex>& l
+    );
+
     BlockTask* findResponse(uint64_t handle);
 
+    void sendCommitGroup
+    (
+      xdi_handle const& requestId,
+      xdi::WriteBlobRequest& req,
+      std::vector<xdi_handle>& group
+    );
+
+    void completeWriteBlob(xdi_handle const& requestId, xdi_error const& e);
+
     void respondToWrites(std::queue<BlockTask*>& q, xdi_error const& e);
 
+    void flushWrites(BlockTask* task);
+
     void _executeTask(RWTask* task);
+    void flushCombined(WriteTask* task);
 
     void enqueueOperations(BlockTask* task, read_map const& r, write_map const& w);
 
+    void sendWriteObject(xdi_handle const& requestId, string_ptr const& buffer, bool const noHole);
+
     void performRead
     (
       xdi_handle const&              requestId,
@@ -146,16 +291,30 @@ class BlockOperations
       xdi_error const&               e
     );
 
+    string_ptr patternObject(std::string const& pattern);
+
+    bool queueRepeatingBlock
+    (
+      xdi_handle const& requestId,
+      WriteTask* task,
+      uint32_t& seqId,
+      std::map<uint64_t, uint64_t> const& fullObjects,
+      stripe_ranges const& ranges,
+      std::shared_ptr<std::string>& buf,
+      write_map& wmap
+    );
+
     void queuePartialWrite
     (
+      WriteContext& writeCtx,
       xdi_handle const& requestId,
       xdi::ReadBlobResponse const& resp,
       WriteTask* task,
       uint32_t& seqId,
       read_map& rmap,
       write_map& wmap,
-      std::shared_ptr<std::string>& buf,
-      uint32_t const& blockOffset,
+      BufferView const& buf,
+      uint64_t const& blockOffset,
       uint32_t const& writeOffset,
       bool const isNewBlob
     );
@@ -165,8 +324,9 @@ class BlockOperations
     uint64_t                volumeId;
     string_ptr              empty_buffer;
     uint32_t                maxObjectSizeInBytes {0};
+    ObjectGeometry          objectGeometry;
 
-    bool shutting_down {false};
+    std::atomic<bool> shutting_down {false};
 
     // for all reads/writes to AM
     string_ptr             blobName;
@@ -175,17 +335,39 @@ class BlockOperations
     std::shared_ptr< std::map<std::string, std::string> > emptyMeta;
 
     std::shared_ptr<xdi::ApiInterface>      api;
-    std::shared_ptr<WriteContext>           ctx;
+    std::vector<std::unique_ptr<WriteStripe>>   stripes;
+
+    // shared by all connections to the volume
+    std::shared_ptr<ObjectCache>            objectCache;
+    std::shared_ptr<BlobMetadataCache>      blobMetadata;
+    std::shared_ptr<ReadAhead>              readAhead;
+    std::shared_ptr<BufferPool>             bufferPool;
+
+    std::shared_ptr<TaskPool>               taskPool;
+    std::shared_ptr<TaskOwner>              owner;
+
+    // The engine of the volume, handles of its tasks are given out in order
+    std::shared_ptr<BlockOperations>        engine;
+    std::atomic<uint64_t>                   nextHandle {1};
+
+    std::atomic<uint64_t>                   holeReadsAvoided {0};
+    std::atomic<uint64_t>                   zeroObjectsSkipped {0};
+
+    using pattern_object = std::pair<std::string, string_ptr>;
+    std::mutex                              patternLock;
+    std::deque<pattern_object>              patternObjects;
+    std::atomic<uint64_t>                   patternHits {0};
+
+    std::shared_ptr<WriteCombiner>          writeCombiner;
+    std::shared_ptr<CommitGroup>            commitGroup;
+    std::shared_ptr<WriteBarrier>           writeBarrier;
 
     std::mutex readObjectsLock;
     std::unordered_map<uint64_t, std::shared_ptr<read_objects>>      readObjects;
 
-    // keep current handles for which we are waiting responses
-    std::mutex respLock;
-    response_map_type responses;
-
-    // Make sure only one thread is draining the update chain at a time
-    std::mutex        drainChainMutex;
+    // keep current handles for which we are waiting responses, looked up
+    // without locking by every completion
+    std::unique_ptr<response_map_type> responses;
 };
 
 }  // namespace block
@@ -21,33 +21,49 @@
 #define BLOCKTASK_H_
 
 // System includes
+#include <algorithm>
 #include <atomic>
 #include <deque>
+#include <map>
 #include <mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
 #include <memory>
 #include <queue>
+#include <utility>
 
+#include "BlockTools.h"
 #include "ProtoTask.h"
 
 namespace fds {
 namespace block {
 
+class BlockOperations;
 struct RWTask;
 struct ReadTask;
 struct WriteTask;
 struct WriteSameTask;
 struct UnmapTask;
+struct FlushTask;
 
-enum class TaskType { READ, WRITE, WRITESAME, UNMAPTASK };
+enum class TaskType { READ, WRITE, WRITESAME, UNMAPTASK, FLUSH };
 
 struct TaskVisitor {
     virtual TaskType matchRead(ReadTask*) const { return TaskType::READ; }
     virtual TaskType matchWrite(WriteTask*) const { return TaskType::WRITE; }
     virtual TaskType matchWriteSame(WriteSameTask*) const { return TaskType::WRITESAME; }
     virtual TaskType matchUnmap(UnmapTask*) const { return TaskType::UNMAPTASK; }
+    virtual TaskType matchFlush(FlushTask*) const { return TaskType::FLUSH; }
+};
+
+/**
+ * The connection a task was executed on. It outlives the connection, once
+ * the connection is gone its tasks still in flight are not responded to.
+ */
+struct TaskOwner {
+    std::mutex          lock;
+    BlockOperations*    connection {nullptr};
 };
 
 /**
@@ -61,38 +77,142 @@ struct BlockTask {
     using buffer_ptr_type = std::shared_ptr<buffer_type>;
     using sequence_type = uint32_t;
 
-    explicit BlockTask(ProtoTask* p_task) : protoTask(p_task) {}
+    BlockTask(ProtoTask* p_task, TaskType const type) : protoTask(p_task), taskType(type) {}
     virtual ~BlockTask() = default;
 
-    uint32_t maxObjectSize() const { return maxObjectSizeInBytes; }
+    /// The kind of task, fixed at construction. Dispatching on it spares
+    /// the data path the double virtual call of match().
+    TaskType getType() const { return taskType; }
 
-    /// Task setters
-    void setMaxObjectSize(uint32_t const size) { maxObjectSizeInBytes = size; }
+    uint32_t maxObjectSize() const { return maxObjectSizeInBytes; }
 
-    void setNumBlocks(uint32_t const b) { numBlocks = b; }
-    uint32_t getNumBlocks() { return numBlocks; }
+    /// Handle the task's requests are sent with, unique among the tasks of
+    /// a volume unlike the protocol handle which only is per connection
+    void setHandle(uint64_t const h) { handle = h; }
+    uint64_t getHandle() const { return handle; }
 
-    void setStartBlockOffset(uint32_t const b) { startBlockOffset = b; }
-    uint32_t getStartBlockOffset() { return startBlockOffset; }
+    void setOwner(std::shared_ptr<TaskOwner> const& o) { owner = o; }
+    std::shared_ptr<TaskOwner> const& getOwner() const { return owner; }
 
-    void getChain(std::queue<BlockTask*>& q) { q.swap(chainedResponses); }
-    void setChain(std::queue<BlockTask*>&& q) { chainedResponses.swap(q); }
+    /// Task setters
+    void setMaxObjectSize(uint32_t const size) { setObjectGeometry(ObjectGeometry(size)); }
+    void setObjectGeometry(ObjectGeometry const& g) {
+        geometry = g;
+        maxObjectSizeInBytes = g.size;
+    }
+
+    void setNumBlocks(uint64_t const b) { numBlocks = b; }
+    uint64_t getNumBlocks() { return numBlocks; }
+
+    void setStartBlockOffset(uint64_t const b) { startBlockOffset = b; }
+    uint64_t getStartBlockOffset() { return startBlockOffset; }
+
+    /// Blob metadata cache version the ReadBlob was sent at, 0 if the
+    /// response came from the cache itself
+    void setBlobMetadataVersion(uint64_t const v) { blobMetadataVersion = v; }
+    uint64_t getBlobMetadataVersion() const { return blobMetadataVersion; }
+
+    /// A task can have a WriteBlob outstanding per stripe it covers, the
+    /// chain of tasks to respond to is kept per sequence id of the WriteBlob.
+    void getChain(sequence_type const seqId, std::queue<BlockTask*>& q) {
+        std::lock_guard<std::mutex> lg(chainLock);
+        auto itr = chainedResponses.find(seqId);
+        if (chainedResponses.end() != itr) {
+            q.swap(itr->second);
+            chainedResponses.erase(itr);
+        }
+    }
+    void setChain(sequence_type const seqId, std::queue<BlockTask*>&& q) {
+        std::lock_guard<std::mutex> lg(chainLock);
+        auto& chain = chainedResponses[seqId];
+        while (false == q.empty()) {
+            chain.push(q.front());
+            q.pop();
+        }
+    }
+
+    /// The WriteBlob sent with seqId can commit the ranges of other tasks
+    /// as well, each identified by the handle its WriteBlob would have had.
+    void getCommitGroup(sequence_type const seqId, std::vector<xdi::RequestHandle>& group) {
+        std::lock_guard<std::mutex> lg(chainLock);
+        auto itr = commitGroups.find(seqId);
+        if (commitGroups.end() != itr) {
+            group.swap(itr->second);
+            commitGroups.erase(itr);
+        }
+    }
+    void setCommitGroup(sequence_type const seqId, std::vector<xdi::RequestHandle>&& group) {
+        std::lock_guard<std::mutex> lg(chainLock);
+        commitGroups[seqId] = std::move(group);
+    }
+
+    /// ObjectIds of the readObject requests sent for this task by sequence
+    /// id, set before any of them is sent. The ids are copied into the
+    /// strings kept from earlier uses of the task.
+    void setReadObjectIds(std::map<sequence_type, std::string> const& ids) {
+        if (readObjectIds.size() < ids.size()) {
+            readObjectIds.resize(ids.size());
+        }
+        numReadObjectIds = 0;
+        for (auto const& i : ids) {
+            auto& id = readObjectIds[numReadObjectIds++];
+            id.first = i.first;
+            id.second = i.second;
+        }
+    }
+    std::string const& getReadObjectId(sequence_type const seqId) const {
+        static std::string const none;
+        auto end = readObjectIds.begin() + numReadObjectIds;
+        auto itr = std::lower_bound(readObjectIds.begin(), end, seqId,
+                                    [] (read_object_id const& id, sequence_type const s) { return id.first < s; });
+        return ((end != itr) && (seqId == itr->first)) ? itr->second : none;
+    }
 
     virtual TaskType match(const TaskVisitor* v) = 0;
 
     ProtoTask* getProtoTask() { return protoTask; }
     void setError(xdi::ApiErrorCode const& error) { if (nullptr != protoTask) protoTask->setError(error); }
 
+  protected:
+    /// Back to the state of a task just constructed for p_task, containers
+    /// are cleared but keep their capacity for the next use. Every task
+    /// type resets its own state and that of its base.
+    void reset(ProtoTask* p_task) {
+        protoTask = p_task;
+        handle = 0;
+        owner.reset();
+        chainedResponses.clear();
+        commitGroups.clear();
+        numReadObjectIds = 0;
+        geometry = ObjectGeometry();
+        maxObjectSizeInBytes = 0;
+        numBlocks = 0;
+        startBlockOffset = 0;
+        blobMetadataVersion = 0;
+    }
+
   private:
+    using read_object_id = std::pair<sequence_type, std::string>;
+
     ProtoTask* protoTask;
+    TaskType const taskType;
+    uint64_t handle {0};
+    std::shared_ptr<TaskOwner> owner;
 
-    std::queue<BlockTask*>        chainedResponses;
+    std::mutex                                                    chainLock;
+    std::unordered_map<sequence_type, std::queue<BlockTask*>>     chainedResponses;
+    std::unordered_map<sequence_type, std::vector<xdi::RequestHandle>>  commitGroups;
+    // Ordered by sequence id, only the first numReadObjectIds are set
+    std::vector<read_object_id>                                   readObjectIds;
+    size_t                                                        numReadObjectIds {0};
 
   protected:
     // offset
+    ObjectGeometry geometry;
     uint32_t maxObjectSizeInBytes {0};
-    uint32_t numBlocks {0};
-    uint32_t startBlockOffset {0};
+    uint64_t numBlocks {0};
+    uint64_t startBlockOffset {0};
+    uint64_t blobMetadataVersion {0};
 };
 
 }  // namespace block
@@ -32,25 +32,60 @@ struct OffsetInfo {
     // This structure is used to calculate block offsets for a given offset and length
     // startBlockOffset and endBlockOffset shall always be valid
     // startDiffOffset and endDiffOffset shall always be valid
-    uint32_t       startBlockOffset;
-    uint32_t       endBlockOffset;
+    uint64_t       startBlockOffset;
+    uint64_t       endBlockOffset;
     // Offset in the first object to location of start
     uint32_t       startDiffOffset {0};
     // Amount of data in last object if not a complete object
     uint32_t       endDiffOffset {0};
     // If spansFullBlocks is true then fullStartBlockOffset and fullEndBlockOffset shall be valid
     bool           spansFullBlocks {false};
-    uint32_t       numFullBlocks {0};
-    uint32_t       fullStartBlockOffset {0};
-    uint32_t       fullEndBlockOffset {0};
+    uint64_t       numFullBlocks {0};
+    uint64_t       fullStartBlockOffset {0};
+    uint64_t       fullEndBlockOffset {0};
 
     bool isSingleObject() { return startBlockOffset == endBlockOffset; }
-    uint32_t numTotalBlocks() { return endBlockOffset - startBlockOffset + 1; }
+    uint64_t numTotalBlocks() { return endBlockOffset - startBlockOffset + 1; }
 };
 
 std::ostream& operator<< (std::ostream &os, const OffsetInfo &oi);
 
-void calculateOffsets(OffsetInfo& info, uint64_t const& offset, uint32_t const& length, uint32_t const& maxObjectSizeInBytes);
+/**
+ * Object size of a volume along with what it takes to map offsets to
+ * objects. Object sizes are usually a power of two, those are mapped with
+ * a shift and a mask instead of a division.
+ */
+struct ObjectGeometry {
+    ObjectGeometry() = default;
+    explicit ObjectGeometry(uint32_t const objectSize);
+
+    uint64_t object(uint64_t const offset) const {
+        return (true == pow2) ? (offset >> shift) : (offset / size);
+    }
+    uint32_t offsetInObject(uint64_t const offset) const {
+        return (true == pow2) ? (offset & mask) : (offset % size);
+    }
+    uint64_t objectStart(uint64_t const object) const {
+        return (true == pow2) ? (object << shift) : (object * size);
+    }
+
+    uint32_t    size {0};
+    uint32_t    shift {0};
+    uint32_t    mask {0};
+    bool        pow2 {false};
+};
+
+void calculateOffsets(OffsetInfo& info, uint64_t const& offset, uint64_t const& length, uint32_t const& maxObjectSizeInBytes);
+// Same as above, takes the shift and mask path for power of two sizes
+void calculateOffsets(OffsetInfo& info, uint64_t const& offset, uint64_t const& length, ObjectGeometry const& geometry);
+
+// Fill length bytes at dst with the pattern repeated, the last repetition
+// is cut short if length isn't a multiple of the pattern
+void fillPattern(char* dst, size_t const length, char const* pattern, size_t const patternLength);
+
+// True if all length bytes at data are zero, uses AVX2 or SSE2 where the
+// cpu has them
+bool isZero(char const* data, size_t const length);
 
 }  // namespace block
 }  // namespace fds
@@ -0,0 +1,86 @@
+/*
+ * BufferPool.h
+ *
+ * Copyright (c) 2016, Andreas Griesshammer <andreas@formationds.com>
+ * Copyright (c) 2016, Formation Data Systems
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _BUFFERPOOL_H
+#define _BUFFERPOOL_H
+
+// System includes
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace fds {
+namespace block {
+
+/**
+ * The BufferPool hands out object sized buffers and takes them back once
+ * the last reference to them is gone, so the data path doesn't have to go
+ * to the allocator for every object it touches.
+ *
+ * Buffers are the std::string shared_ptrs the xdi API and the tasks pass
+ * around, they can be kept, cached and handed to the API like any other.
+ * A buffer returns to the pool when its last shared_ptr is released, even
+ * if the pool itself is gone by then. Every buffer of the pool has room
+ * for bufferSize bytes, longer ones are allocated as usual and not kept.
+ */
+class BufferPool {
+public:
+    using buffer_type = std::string;
+    using buffer_ptr_type = std::shared_ptr<buffer_type>;
+
+    struct Stats {
+        uint64_t allocations {0};
+        uint64_t reuses {0};
+        uint64_t releases {0};
+        uint64_t discards {0};
+        size_t   buffers {0};
+    };
+
+    /**
+     * \param maxBuffers free buffers kept at most, 0 disables pooling
+     */
+    BufferPool(size_t const bufferSize, size_t const maxBuffers);
+    BufferPool(BufferPool const&) = delete;
+    BufferPool& operator=(BufferPool const&) = delete;
+    ~BufferPool();
+
+    // A buffer of length bytes, its contents are left as they are
+    buffer_ptr_type get(size_t const length);
+    // A buffer of length zeros
+    buffer_ptr_type zeroed(size_t const length);
+    // A buffer holding a copy of length bytes at data
+    buffer_ptr_type copy(char const* data, size_t const length);
+
+    bool enabled() const;
+    size_t bufferSize() const;
+    Stats getStats() const;
+
+private:
+    struct Free;
+    struct Release;
+
+    std::shared_ptr<Free>   _free;
+};
+
+} // namespace block
+} // namespace fds
+
+#endif // _BUFFERPOOL_H
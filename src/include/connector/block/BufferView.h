@@ -0,0 +1,73 @@
+/*
+ * BufferView.h
+ *
+ * Copyright (c) 2016, Andreas Griesshammer <andreas@formationds.com>
+ * Copyright (c) 2016, Formation Data Systems
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _BUFFERVIEW_H
+#define _BUFFERVIEW_H
+
+// System includes
+#include <memory>
+#include <string>
+
+namespace fds {
+namespace block {
+
+/**
+ * A BufferView is a range of a shared buffer. It keeps the buffer alive
+ * and lets a read hand out just the part of an object that was asked for
+ * without copying it. The buffer must not be modified while viewed.
+ */
+struct BufferView {
+    using buffer_ptr_type = std::shared_ptr<std::string>;
+
+    BufferView() = default;
+    explicit BufferView(buffer_ptr_type b)
+        : buf(std::move(b)),
+          length((nullptr != buf) ? buf->size() : 0)
+    {}
+    BufferView(buffer_ptr_type b, size_t const off, size_t const len)
+        : buf(std::move(b)),
+          offset(off),
+          length(len)
+    {}
+
+    char const* data() const        { return buf->data() + offset; }
+    size_t size() const             { return length; }
+    bool empty() const              { return (0 == length); }
+    // Whether the view covers all of its buffer
+    bool whole() const              { return (nullptr != buf) && (0 == offset) && (buf->size() == length); }
+    buffer_ptr_type const& buffer() const { return buf; }
+
+    // Narrow the view to len bytes starting off bytes into it
+    void trim(size_t const off, size_t const len) {
+        offset += off;
+        length = len;
+    }
+
+    std::string str() const         { return std::string(data(), size()); }
+
+  private:
+    buffer_ptr_type buf;
+    size_t          offset {0};
+    size_t          length {0};
+};
+
+}  // namespace block
+}  // namespace fds
+
+#endif  // _BUFFERVIEW_H
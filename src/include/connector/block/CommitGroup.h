@@ -0,0 +1,104 @@
+/*
+ * CommitGroup.h
+ *
+ * Copyright (c) 2016, Andreas Griesshammer <andreas@formationds.com>
+ * Copyright (c) 2016, Formation Data Systems
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _COMMITGROUP_H
+#define _COMMITGROUP_H
+
+// System includes
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// FDS includes
+#include "xdi/ApiTypes.h"
+
+namespace fds {
+namespace block {
+
+/**
+ * A CommitGroup collects the WriteBlobs of ranges that are ready to be
+ * committed and sends them as a single WriteBlob, either once the interval
+ * since the first one was added has passed or once maxRanges were added.
+ *
+ * Every range is identified by the RequestHandle its WriteBlob would have
+ * been sent with. The group is sent with the handle of the first range and
+ * the handles of all ranges in it, the first one included.
+ */
+class CommitGroup {
+    using clock = std::chrono::steady_clock;
+
+public:
+    using send_fn = std::function<void(xdi::RequestHandle const&,
+                                       xdi::WriteBlobRequest&,
+                                       std::vector<xdi::RequestHandle>&)>;
+
+    struct Stats {
+        uint64_t ranges {0};
+        uint64_t commits {0};
+    };
+
+    /**
+     * \param interval an interval of 0 disables grouping
+     * \param send is called without any lock held
+     */
+    CommitGroup(std::chrono::microseconds const interval, size_t const maxRanges, send_fn send);
+    CommitGroup(CommitGroup const&) = delete;
+    CommitGroup& operator=(CommitGroup const&) = delete;
+    ~CommitGroup();
+
+    void add(xdi::RequestHandle const& requestId, xdi::WriteBlobRequest const& req);
+
+    // Send whatever has been collected right away
+    void flush();
+
+    // Stop sending, ranges still collected are dropped
+    void stop();
+
+    bool enabled() const { return (0 < _interval.count()); }
+    Stats getStats() const;
+
+private:
+    // NOTE: the lock should be held when calling this
+    bool take(xdi::WriteBlobRequest& req, std::vector<xdi::RequestHandle>& ids);
+    void run();
+
+    std::chrono::microseconds const     _interval;
+    size_t const                        _maxRanges;
+    send_fn const                       _send;
+
+    mutable std::mutex                  _lock;
+    std::condition_variable             _cv;
+    xdi::WriteBlobRequest               _req;
+    std::vector<xdi::RequestHandle>     _ids;
+    clock::time_point                   _deadline;
+    bool                                _stopping {false};
+    std::thread                         _sender;
+
+    std::atomic<uint64_t>               _ranges {0};
+    std::atomic<uint64_t>               _commits {0};
+};
+
+} // namespace block
+} // namespace fds
+
+#endif // _COMMITGROUP_H
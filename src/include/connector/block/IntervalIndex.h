@@ -0,0 +1,102 @@
+/*
+ * IntervalIndex.h
+ *
+ * Copyright (c) 2016, Andreas Griesshammer <andreas@formationds.com>
+ * Copyright (c) 2016, Formation Data Systems
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _INTERVALINDEX_H
+#define _INTERVALINDEX_H
+
+// System includes
+#include <map>
+#include <utility>
+
+namespace fds {
+namespace block {
+
+/**
+ * An IntervalIndex holds a set of non-overlapping offset ranges ordered by
+ * their start offset. The stored value describes the range and has to provide
+ * a numObjects member holding the number of offsets it covers.
+ *
+ * Because the ranges never overlap, the range ends are ordered the same way
+ * as the starts. This lets both point and range lookups be answered with a
+ * single tree search instead of walking every range from the beginning.
+ */
+template<typename K, typename T>
+class IntervalIndex {
+    using map_type = std::map<K, T>;
+
+public:
+    using iterator = typename map_type::iterator;
+    using const_iterator = typename map_type::const_iterator;
+
+    iterator begin()                    { return _ranges.begin(); }
+    iterator end()                      { return _ranges.end(); }
+    const_iterator begin() const        { return _ranges.begin(); }
+    const_iterator end() const          { return _ranges.end(); }
+    size_t size() const                 { return _ranges.size(); }
+    bool empty() const                  { return _ranges.empty(); }
+    void clear()                        { _ranges.clear(); }
+    iterator erase(iterator itr)        { return _ranges.erase(itr); }
+
+    std::pair<iterator, bool> emplace(K const& start, T&& value) {
+        return _ranges.emplace(start, std::move(value));
+    }
+
+    /**
+     * \return the range containing offset or end() if there is none
+     */
+    iterator find(K const& offset) {
+        auto itr = _ranges.upper_bound(offset);
+        if (_ranges.begin() == itr) return _ranges.end();
+        --itr;
+        return contains(itr, offset) ? itr : _ranges.end();
+    }
+
+    /**
+     * \return the lowest range overlapping [start, end] or end() if there is
+     * none. Every following range with a start <= end overlaps as well.
+     */
+    iterator findOverlapping(K const& start, K const& end) {
+        auto itr = _ranges.upper_bound(start);
+        if (_ranges.begin() != itr) {
+            auto prev = std::prev(itr);
+            if (true == contains(prev, start)) return prev;
+        }
+        if ((_ranges.end() != itr) && (itr->first <= end)) return itr;
+        return _ranges.end();
+    }
+
+    /**
+     * \return the last offset covered by the range at itr
+     */
+    static K lastOffset(const_iterator itr) {
+        return itr->first + itr->second.numObjects - 1;
+    }
+
+private:
+    static bool contains(const_iterator itr, K const& offset) {
+        return (itr->first <= offset) && (offset <= lastOffset(itr));
+    }
+
+    map_type    _ranges;
+};
+
+} // namespace block
+} // namespace fds
+
+#endif // _INTERVALINDEX_H
@@ -0,0 +1,107 @@
+/*
+ * ObjectCache.h
+ *
+ * Copyright (c) 2016, Andreas Griesshammer <andreas@formationds.com>
+ * Copyright (c) 2016, Formation Data Systems
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _OBJECTCACHE_H
+#define _OBJECTCACHE_H
+
+// System includes
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// FDS includes
+#include "xdi/ApiTypes.h"
+
+namespace fds {
+namespace block {
+
+/**
+ * The ObjectCache keeps recently read and written object buffers keyed by
+ * their ObjectId. ObjectIds identify the object content so a cached buffer
+ * never goes stale, it only gets evicted once the cache is over its memory
+ * limit. Buffers handed out by the cache must not be modified.
+ *
+ * The cache is split into shards by ObjectId, each holding an LRU list and
+ * an equal part of the memory limit.
+ */
+class ObjectCache {
+    using buffer_ptr = std::shared_ptr<std::string>;
+
+public:
+    struct Stats {
+        uint64_t hits {0};
+        uint64_t misses {0};
+        uint64_t insertions {0};
+        uint64_t evictions {0};
+        size_t   bytes {0};
+        size_t   objects {0};
+    };
+
+    explicit ObjectCache(size_t const maxBytes);
+    ObjectCache(ObjectCache const&) = delete;
+    ObjectCache& operator=(ObjectCache const&) = delete;
+
+    /**
+     * \return the cached buffer for id or nullptr on a miss
+     */
+    buffer_ptr get(xdi::ObjectId const& id);
+    // Like get without counting or touching the LRU
+    bool contains(xdi::ObjectId const& id) const;
+    void insert(xdi::ObjectId const& id, buffer_ptr const& buf);
+    void clear();
+
+    bool enabled() const { return (0 < _maxBytes); }
+    size_t maxBytes() const { return _maxBytes; }
+    Stats getStats() const;
+
+private:
+    struct Entry {
+        xdi::ObjectId   id;
+        buffer_ptr      buf;
+    };
+    using lru_list = std::list<Entry>;
+
+    struct Shard {
+        mutable std::mutex                                          lock;
+        lru_list                                                    lru;
+        std::unordered_map<xdi::ObjectId, lru_list::iterator>       index;
+        size_t                                                      bytes {0};
+    };
+
+    Shard& shardFor(xdi::ObjectId const& id);
+    Shard const& shardFor(xdi::ObjectId const& id) const;
+    void evict(Shard& shard);
+
+    size_t const                _maxBytes;
+    size_t const                _shardBytes;
+    std::vector<Shard>          _shards;
+
+    std::atomic<uint64_t>       _hits {0};
+    std::atomic<uint64_t>       _misses {0};
+    std::atomic<uint64_t>       _insertions {0};
+    std::atomic<uint64_t>       _evictions {0};
+};
+
+} // namespace block
+} // namespace fds
+
+#endif // _OBJECTCACHE_H
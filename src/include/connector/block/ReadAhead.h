@@ -0,0 +1,158 @@
+/*
+ * ReadAhead.h
+ *
+ * Copyright (c) 2016, Andreas Griesshammer <andreas@formationds.com>
+ * Copyright (c) 2016, Formation Data Systems
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _READAHEAD_H
+#define _READAHEAD_H
+
+// System includes
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// FDS includes
+#include "xdi/ApiResponseInterface.h"
+#include "xdi/ApiTypes.h"
+
+namespace xdi {
+    class ApiInterface;
+}
+
+namespace fds {
+namespace block {
+
+class BlobMetadataCache;
+class ObjectCache;
+
+/**
+ * ReadAhead watches the object ranges read from a volume for sequential
+ * streams and reads the objects following a stream into the ObjectCache
+ * before they are asked for.
+ *
+ * A read continuing where a stream left off extends it, any other read
+ * starts a new stream in place of the least recently used one. Once a
+ * stream has been continued often enough, every read of it prefetches the
+ * next window of objects that isn't prefetched yet. The window starts out
+ * at minWindow objects and doubles up to maxWindow as the stream goes on.
+ * Random reads never get to prefetch anything.
+ *
+ * Prefetching takes the ObjectIds from the BlobMetadataCache, or sends
+ * its own ReadBlob to learn them. Requests in flight keep the ReadAhead
+ * alive, it has to be owned by a shared_ptr.
+ */
+class ReadAhead
+    :   public xdi::ApiResponseInterface,
+        public std::enable_shared_from_this<ReadAhead>
+{
+    using xdi_error = xdi::ApiErrorCode;
+    using xdi_handle = xdi::RequestHandle;
+
+public:
+    struct Stats {
+        uint64_t streams {0};
+        uint64_t prefetches {0};
+        uint64_t objects {0};
+    };
+
+    /**
+     * \param maxWindow a window of 0 disables read ahead
+     */
+    ReadAhead(std::shared_ptr<xdi::ApiInterface> api,
+              xdi::VolumeId const volumeId,
+              std::string const& blobName,
+              std::shared_ptr<ObjectCache> objectCache,
+              std::shared_ptr<BlobMetadataCache> blobMetadata,
+              uint32_t const minWindow,
+              uint32_t const maxWindow);
+    ReadAhead(ReadAhead const&) = delete;
+    ReadAhead& operator=(ReadAhead const&) = delete;
+
+    // The objects start to end are being read
+    void read(xdi::ObjectOffsetVal const start, xdi::ObjectOffsetVal const end);
+
+    bool enabled() const;
+    Stats getStats() const;
+
+    void listResp(xdi_handle const&, xdi::ListBlobsResponse const&, xdi_error const&) override {}
+    void readVolumeMetaResp(xdi_handle const&, xdi::VolumeMetadata const&, xdi_error const&) override {}
+    void writeVolumeMetaResp(xdi_handle const&, bool const&, xdi_error const&) override {}
+    void readBlobResp(xdi_handle const& requestId, xdi::ReadBlobResponse const& resp, xdi_error const& e) override;
+    void writeBlobResp(xdi_handle const&, xdi::WriteBlobResponse const&, xdi_error const&) override {}
+    void upsertBlobMetadataCasResp(xdi_handle const&, bool const&, xdi_error const&) override {}
+    void upsertBlobObjectCasResp(xdi_handle const&, bool const&, xdi_error const&) override {}
+    void readObjectResp(xdi_handle const& requestId, xdi::BufferPtr const& resp, xdi_error const& e) override;
+    void writeObjectResp(xdi_handle const&, xdi::ObjectId const&, xdi_error const&) override {}
+    void deleteBlobResp(xdi_handle const&, bool const&, xdi_error const&) override {}
+    void statVolumeResp(xdi_handle const&, xdi::VolumeStatusPtr const&, xdi_error const&) override {}
+    void listAllVolumesResp(xdi_handle const&, xdi::ListAllVolumesResponse const&, xdi_error const&) override {}
+
+private:
+    struct Stream {
+        xdi::ObjectOffsetVal    last {0};
+        xdi::ObjectOffsetVal    prefetched {0};
+        uint32_t                window {0};
+        uint32_t                reads {0};
+        uint64_t                used {0};
+    };
+
+    struct BlobRange {
+        xdi::ObjectOffsetVal    start;
+        xdi::ObjectOffsetVal    end;
+        uint64_t                version;
+    };
+
+    void prefetch(xdi::ObjectOffsetVal const start, xdi::ObjectOffsetVal const end);
+    void readObjects(std::map<xdi::ObjectOffsetVal, xdi::ObjectId> const& objects);
+
+    // NOTE: the lock should be held when calling these
+    void keepAlive();
+    std::shared_ptr<ReadAhead> release();
+
+    std::shared_ptr<xdi::ApiInterface>      api;
+    xdi::VolumeId const                     volumeId;
+    std::string const                       blobName;
+    std::shared_ptr<ObjectCache>            objectCache;
+    std::shared_ptr<BlobMetadataCache>      blobMetadata;
+    uint32_t const                          minWindow;
+    uint32_t const                          maxWindow;
+
+    mutable std::mutex                      lock;
+    std::vector<Stream>                     streams;
+    uint64_t                                tick {0};
+
+    // Requests in flight by handle
+    uint64_t                                                nextHandle {0};
+    std::unordered_map<uint64_t, BlobRange>                 blobReads;
+    std::unordered_map<uint64_t, xdi::ObjectId>             objectReads;
+    std::unordered_set<xdi::ObjectId>                       pendingObjects;
+    std::shared_ptr<ReadAhead>                              self;
+
+    std::atomic<uint64_t>                   newStreams {0};
+    std::atomic<uint64_t>                   prefetches {0};
+    std::atomic<uint64_t>                   objectsRead {0};
+};
+
+} // namespace block
+} // namespace fds
+
+#endif // _READAHEAD_H
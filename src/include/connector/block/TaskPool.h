@@ -0,0 +1,98 @@
+/*
+ * TaskPool.h
+ *
+ * Copyright (c) 2016, Andreas Griesshammer <andreas@formationds.com>
+ * Copyright (c) 2016, Formation Data Systems
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _TASKPOOL_H
+#define _TASKPOOL_H
+
+// System includes
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace fds {
+namespace block {
+
+struct BlockTask;
+struct ProtoTask;
+struct ReadTask;
+struct WriteTask;
+struct WriteSameTask;
+
+/**
+ * The TaskPool keeps the tasks of a connection once they are done, so the
+ * next request of the same kind reuses one instead of allocating it along
+ * with the vectors it fills on the way.
+ *
+ * A released task is reset right away, the buffers it held are let go of
+ * then and not when it is reused. Tasks are handed out by the connection
+ * and released by whichever thread completes them. Any task created with
+ * new can be released to the pool, UnmapTasks are deleted.
+ */
+class TaskPool {
+public:
+    struct Stats {
+        uint64_t allocations {0};
+        uint64_t reuses {0};
+        uint64_t releases {0};
+        uint64_t discards {0};
+        size_t   tasks {0};
+    };
+
+    /**
+     * \param maxTasks free tasks kept at most of every kind, 0 disables
+     *        pooling
+     */
+    explicit TaskPool(size_t const maxTasks);
+    TaskPool(TaskPool const&) = delete;
+    TaskPool& operator=(TaskPool const&) = delete;
+    ~TaskPool();
+
+    ReadTask* getRead(ProtoTask* p_task);
+    WriteTask* getWrite(ProtoTask* p_task);
+    WriteSameTask* getWriteSame(ProtoTask* p_task);
+
+    // Take back a task that is done, it must not be touched afterwards
+    void release(BlockTask* task);
+
+    bool enabled() const { return (0 < _maxTasks); }
+    Stats getStats() const;
+
+private:
+    template<typename T>
+    T* get(std::vector<T*>& free, ProtoTask* p_task);
+    template<typename T>
+    void put(std::vector<T*>& free, T* task);
+
+    size_t const                _maxTasks;
+
+    mutable std::mutex          _lock;
+    std::vector<ReadTask*>      _reads;
+    std::vector<WriteTask*>     _writes;
+    std::vector<WriteSameTask*> _writeSames;
+
+    std::atomic<uint64_t>       _allocations {0};
+    std::atomic<uint64_t>       _reuses {0};
+    std::atomic<uint64_t>       _releases {0};
+    std::atomic<uint64_t>       _discards {0};
+};
+
+} // namespace block
+} // namespace fds
+
+#endif // _TASKPOOL_H
@@ -0,0 +1,197 @@
+/*
+ * TaskTable.h
+ *
+ * Copyright (c) 2016, Andreas Griesshammer <andreas@formationds.com>
+ * Copyright (c) 2016, Formation Data Systems
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _TASKTABLE_H
+#define _TASKTABLE_H
+
+// System includes
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+namespace fds {
+namespace block {
+
+/**
+ * A TaskTable maps the protocol handle of every in-flight task to the task.
+ * It is a fixed size open-addressed table using linear probing so that the
+ * lookup done at the top of every completion never takes a lock.
+ *
+ * Inserts are serialized among themselves, removals and lookups are not.
+ * Removed slots are not marked with tombstones, instead every probe looks
+ * at up to maxProbe slots which is the longest distance any entry in the
+ * table had to walk from the home slot of its handle. It shrinks again
+ * once the last entry that far out is removed.
+ *
+ * Tasks are reused, so a slot can be emptied and filled again with the
+ * same task under a new handle while a lookup reads it. Every slot has a
+ * sequence that is bumped by both and a lookup only trusts what it read if
+ * the sequence didn't move meanwhile.
+ */
+template<typename T>
+class TaskTable {
+    struct Slot {
+        std::atomic<uint64_t>   seq {0};
+        std::atomic<uint64_t>   handle {0};
+        std::atomic<T*>         task {nullptr};
+    };
+
+public:
+    /**
+     * \param capacity is rounded up to the next power of two
+     */
+    explicit TaskTable(size_t const capacity = 4096) {
+        while (mask + 1 < capacity) mask = (mask << 1) | 1;
+        slots.reset(new Slot[mask + 1]);
+        probes.reset(new std::atomic<size_t>[mask + 1]);
+        for (size_t i = 0; i <= mask; ++i) {
+            probes[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    TaskTable(TaskTable const&) = delete;
+    TaskTable& operator=(TaskTable const&) = delete;
+
+    /**
+     * \return false if handle is already in the table or there is no free slot
+     */
+    bool insert(uint64_t const handle, T* task) {
+        std::lock_guard<std::mutex> lg(insertLock);
+        if (nullptr != find(handle)) return false;
+        auto home = hash(handle);
+        for (size_t i = 0; i <= mask; ++i) {
+            auto& slot = slots[(home + i) & mask];
+            // Only inserts turn an empty slot into a used one and we hold
+            // the lock, a concurrent remove can only free more slots.
+            if (nullptr != slot.task.load(std::memory_order_acquire)) continue;
+            probes[i].fetch_add(1, std::memory_order_relaxed);
+            if (i > maxProbe.load(std::memory_order_relaxed)) {
+                maxProbe.store(i, std::memory_order_release);
+            }
+            slot.seq.fetch_add(1, std::memory_order_acq_rel);
+            slot.handle.store(handle, std::memory_order_release);
+            slot.task.store(task, std::memory_order_release);
+            slot.seq.fetch_add(1, std::memory_order_acq_rel);
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * \return the task for handle or nullptr if it is not in the table
+     */
+    T* find(uint64_t const handle) const {
+        auto home = hash(handle);
+        auto probe = maxProbe.load(std::memory_order_acquire);
+        for (size_t i = 0; i <= probe; ++i) {
+            auto& slot = slots[(home + i) & mask];
+            auto seq = slot.seq.load(std::memory_order_acquire);
+            auto task = slot.task.load(std::memory_order_acquire);
+            if (nullptr == task) continue;
+            if (handle != slot.handle.load(std::memory_order_acquire)) continue;
+            // The slot could have been emptied and reused, maybe by the same
+            // task, between the loads above
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq == slot.seq.load(std::memory_order_relaxed)) return task;
+        }
+        return nullptr;
+    }
+
+    /**
+     * Remove the entry for handle if it still refers to task.
+     * \return true for exactly one of any concurrent callers
+     */
+    bool remove(uint64_t const handle, T* task) {
+        auto home = hash(handle);
+        auto probe = maxProbe.load(std::memory_order_acquire);
+        for (size_t i = 0; i <= probe; ++i) {
+            auto& slot = slots[(home + i) & mask];
+            if (task != slot.task.load(std::memory_order_acquire)) continue;
+            if (handle != slot.handle.load(std::memory_order_acquire)) continue;
+            T* expected = task;
+            if (false == slot.task.compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel)) {
+                return false;
+            }
+            slot.seq.fetch_add(2, std::memory_order_acq_rel);
+            if ((1 == probes[i].fetch_sub(1, std::memory_order_acq_rel)) && (i == probe)) {
+                shrinkProbe();
+            }
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * Remove every entry, calling f with each task that was removed.
+     */
+    template<typename F>
+    void drain(F f) {
+        for (size_t i = 0; i <= mask; ++i) {
+            auto task = slots[i].task.exchange(nullptr, std::memory_order_acq_rel);
+            if (nullptr != task) {
+                slots[i].seq.fetch_add(2, std::memory_order_acq_rel);
+                f(task);
+            }
+        }
+        std::lock_guard<std::mutex> lg(insertLock);
+        for (size_t i = 0; i <= mask; ++i) {
+            probes[i].store(0, std::memory_order_relaxed);
+        }
+        maxProbe.store(0, std::memory_order_release);
+    }
+
+    size_t capacity() const { return mask + 1; }
+    size_t probeLength() const { return maxProbe.load(std::memory_order_acquire); }
+
+private:
+    // Bring maxProbe back to the longest distance still in use. Inserts are
+    // the only ones to raise it, so hold them off meanwhile.
+    void shrinkProbe() {
+        std::lock_guard<std::mutex> lg(insertLock);
+        auto probe = maxProbe.load(std::memory_order_relaxed);
+        while ((0 < probe) && (0 == probes[probe].load(std::memory_order_acquire))) {
+            --probe;
+        }
+        maxProbe.store(probe, std::memory_order_release);
+    }
+
+    size_t hash(uint64_t h) const {
+        // 64 bit finalizer from MurmurHash3, handles are often sequential
+        // or pointers so spread them over the whole table
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h & mask;
+    }
+
+    size_t                      mask {0};
+    std::unique_ptr<Slot[]>     slots;
+    // Number of entries at each distance from their home slot
+    std::unique_ptr<std::atomic<size_t>[]>  probes;
+    std::atomic<size_t>         maxProbe {0};
+    std::mutex                  insertLock;
+};
+
+} // namespace block
+} // namespace fds
+
+#endif // _TASKTABLE_H
@@ -22,16 +22,18 @@
 #define TASKS_H_
 
 // System includes
-#include <set>
+#include <map>
 
 // FDS includes
 #include "BlockTask.h"
+#include "BufferPool.h"
+#include "BufferView.h"
 
 namespace fds {
 namespace block {
 
 struct RWTask : public BlockTask {
-    RWTask(ProtoTask* p_task) : BlockTask(p_task)
+    RWTask(ProtoTask* p_task, TaskType const type) : BlockTask(p_task, type)
     {
         bufVec.reserve(1);
         offVec.reserve(1);
@@ -39,16 +41,16 @@ struct RWTask : public BlockTask {
     virtual ~RWTask() = default;
     virtual TaskType match(const TaskVisitor* v) = 0;
 
-    void set(uint64_t const off, uint32_t const bytes) {
+    void set(uint64_t const off, uint64_t const bytes) {
         offset = off;
         length = bytes;
     }
     uint64_t getOffset() const  { return offset; }
-    uint32_t getLength() const  { return length; }
+    uint64_t getLength() const  { return length; }
 
     /// Sub-task operations
     uint64_t getOffset(sequence_type const seqId) const          { return offVec[seqId]; }
-    buffer_ptr_type getBuffer(sequence_type const seqId) const   { return bufVec[seqId]; }
+    BufferView const& getBuffer(sequence_type const seqId) const { return bufVec[seqId]; }
 
     void setObjectCount(size_t const count) {
         bufVec.reserve(count);
@@ -57,27 +59,35 @@ struct RWTask : public BlockTask {
 
 private:
     uint64_t offset {0};
-    uint32_t length {0};
+    uint64_t length {0};
 
 protected:
-    std::vector<buffer_ptr_type>   bufVec;
+    void reset(ProtoTask* p_task) {
+        BlockTask::reset(p_task);
+        offset = 0;
+        length = 0;
+        bufVec.clear();
+        offVec.clear();
+    }
+
+    std::vector<BufferView>        bufVec;
     std::vector<uint64_t>          offVec;
 };
 
 struct ReadTask : public RWTask {
-    ReadTask(ProtoTask* p_task) : RWTask(p_task) {}
+    ReadTask(ProtoTask* p_task) : RWTask(p_task, TaskType::READ) {}
     virtual TaskType match(const TaskVisitor* v) { return v->matchRead(this); }
 
-    /// Buffer operations
-    buffer_ptr_type getNextReadBuffer(uint32_t& context) {
-        if (context >= bufVec.size()) {
+    /// Buffer operations, the views cover exactly the data read
+    BufferView const* getNextReadBuffer(uint32_t& context) const {
+        if (context >= readVec.size()) {
             return nullptr;
         }
-        return bufVec[context++];
+        return &readVec[context++];
     }
 
-    void swapReadBuffers(std::vector<buffer_ptr_type>& vec) {
-        vec.swap(bufVec);
+    void swapReadBuffers(std::vector<BufferView>& vec) {
+        vec.swap(readVec);
     }
 
     void increaseReadBlockCount() { ++readObjectCount; }
@@ -89,24 +99,40 @@ struct ReadTask : public RWTask {
     void handleReadResponse(std::vector<buffer_ptr_type>& buffers,
                             buffer_ptr_type& empty_buffer);
 
+    /// Reuse the task for p_task, see BlockTask::reset
+    void reset(ProtoTask* p_task) {
+        RWTask::reset(p_task);
+        readObjectCount = 0;
+        readVec.clear();
+    }
+
 private:
     uint32_t readObjectCount {0};
+
+    std::vector<BufferView>   readVec;
 };
 
 struct WriteTask : public RWTask {
-    WriteTask(ProtoTask* p_task) : RWTask(p_task) {}
+    WriteTask(ProtoTask* p_task) : RWTask(p_task, TaskType::WRITE) {}
     virtual TaskType match(const TaskVisitor* v) { return v->matchWrite(this); }
 
-    void setWriteBuffer(std::shared_ptr<std::string>& buf) { writeBuffer = buf; }
-    void getWriteBuffer(std::shared_ptr<std::string>& buf) { buf = writeBuffer; }
+    void setWriteBuffer(std::shared_ptr<std::string>& buf) { writeBuffers.assign(1, buf); }
+    /// The data of the write in consecutive buffers, connectors split it at
+    /// object boundaries so full objects can be written without a copy
+    void setWriteBuffers(std::vector<buffer_ptr_type>&& bufs) { writeBuffers = std::move(bufs); }
+    /// The data as a single buffer, joined if it came in pieces
+    void getWriteBuffer(std::shared_ptr<std::string>& buf);
+    /// len bytes of the data starting off bytes into it, a view of the buffer
+    /// holding them or a copy if they span buffers
+    BufferView getWriteSlice(size_t const off, size_t const len, BufferPool& pool) const;
 
     void keepBufferForWrite(sequence_type const seqId,
                             uint64_t const objectOff,
                             uint32_t const writeOffset,
-                            buffer_ptr_type& buf) {
+                            BufferView const& buf) {
         bufVec.emplace_back(buf);
         offVec.emplace_back(objectOff);
-        if (0 != writeOffset) writeOffsetInBlockMap.emplace(seqId, writeOffset);
+        if (0 != writeOffset) writeOffsetsInBlock.emplace_back(seqId, writeOffset);
     }
 
     void setRepeatingBlock(sequence_type const seqId) { repeatingBlock = seqId; hasRepeatingBlock = true; }
@@ -115,6 +141,54 @@ struct WriteTask : public RWTask {
         else return (seqId == repeatingBlock) ? true : false;
     }
 
+    /**
+     * Run of full objects that gets the repeating block. There is a run for
+     * every stripe range covered, each committed with its own seqId.
+     */
+    struct FullBlockRun {
+        uint64_t        start;
+        uint64_t        end;
+        sequence_type   seqId;
+    };
+    using full_block_runs = std::vector<FullBlockRun>;
+
+    void addFullBlockRun(uint64_t const start, uint64_t const end, sequence_type const seqId) {
+        fullBlockRuns.push_back(FullBlockRun{start, end, seqId});
+    }
+    void swapFullBlockRuns(full_block_runs& runs) { fullBlockRuns.swap(runs); }
+
+    /**
+     * A task is part of one WriteBlob for every stripe range it covers and
+     * is only done once all of them have been responded to.
+     */
+    void setPendingCommits(uint32_t const commits) { pendingCommits = commits; }
+    bool commitDone() { return (1 >= pendingCommits.fetch_sub(1)); }
+
+    /**
+     * Writes the WriteCombiner merged into this one, they are responded to
+     * along with it.
+     */
+    void addCombined(WriteTask* task) { combinedTasks.push_back(task); }
+    void swapCombined(std::vector<WriteTask*>& tasks) { combinedTasks.swap(tasks); }
+
+    /**
+     * A forced unit access write is responded to once committed like any
+     * other, but is neither combined nor left waiting in a commit group.
+     */
+    void setFua(bool const f) { fua = f; }
+    bool isFua() const { return fua; }
+
+    /**
+     * Objects of all zeros a no hole write leaves behind are written as
+     * such rather than committed as holes, the range stays provisioned.
+     */
+    void setNoHole(bool const n) { noHole = n; }
+    bool isNoHole() const { return noHole; }
+
+    /// Epoch of the WriteBarrier the write was started in
+    void setEpoch(uint64_t const e) { epoch = e; }
+    uint64_t getEpoch() const { return epoch; }
+
     /**
      * Handle read response for read-modify-write
      * \return true if all responses were received or operation error
@@ -122,34 +196,64 @@ struct WriteTask : public RWTask {
     buffer_ptr_type
         handleRMWResponse(buffer_ptr_type const& retBuf,
                           sequence_type seqId,
+                          BufferPool& pool,
                           bool const mutable_buffer = false);
 
+    /// Reuse the task for p_task, see BlockTask::reset
+    void reset(ProtoTask* p_task) {
+        RWTask::reset(p_task);
+        writeBuffers.clear();
+        writeOffsetsInBlock.clear();
+        repeatingBlock = 0;
+        hasRepeatingBlock = false;
+        fullBlockRuns.clear();
+        pendingCommits = 1;
+        combinedTasks.clear();
+        fua = false;
+        noHole = false;
+        epoch = 0;
+    }
+
+protected:
+    WriteTask(ProtoTask* p_task, TaskType const type) : RWTask(p_task, type) {}
+
 private:
-    std::shared_ptr<std::string>  writeBuffer;
+    std::vector<buffer_ptr_type>  writeBuffers;
 
-    // Track offset inside block if not aligned
-    std::unordered_map<sequence_type, uint32_t>   writeOffsetInBlockMap;
+    // Track offset inside block if not aligned, only the partial objects
+    // at either end of a range have one
+    std::vector<std::pair<sequence_type, uint32_t>>   writeOffsetsInBlock;
 
     sequence_type  repeatingBlock {0};
     bool           hasRepeatingBlock {false};
+
+    full_block_runs         fullBlockRuns;
+    std::atomic<uint32_t>   pendingCommits {1};
+
+    std::vector<WriteTask*> combinedTasks;
+
+    bool                    fua {false};
+    bool                    noHole {false};
+    uint64_t                epoch {0};
 };
 
 struct WriteSameTask : public WriteTask {
-    WriteSameTask(ProtoTask* p_task) : WriteTask(p_task) {}
+    WriteSameTask(ProtoTask* p_task) : WriteTask(p_task, TaskType::WRITESAME) {}
     virtual TaskType match(const TaskVisitor* v) { return v->matchWriteSame(this); }
 };
 
 struct UnmapTask : public WriteTask {
     struct UnmapRange {
         uint64_t offset;
-        uint32_t length;
+        uint64_t length;
     };
     using unmap_vec = std::vector<UnmapRange>;
     using unmap_vec_ptr = std::unique_ptr<unmap_vec>;
-    using block_offset_list = std::set<uint32_t>;
+    // Runs of fully unmapped objects, first offset -> last offset
+    using block_offset_list = std::map<uint64_t, uint64_t>;
 
     UnmapTask(ProtoTask* p_task, std::unique_ptr<std::vector<UnmapRange>>&& wv) :
-        WriteTask(p_task),
+        WriteTask(p_task, TaskType::UNMAPTASK),
         write_vec(std::move(wv))
     {
         uint64_t startOffset {0};
@@ -169,7 +273,7 @@ struct UnmapTask : public WriteTask {
     }
     virtual TaskType match(const TaskVisitor* v) { return v->matchUnmap(this); }
 
-    bool getNextRange(uint32_t& context, uint64_t& offset, uint32_t& length) {
+    bool getNextRange(uint32_t& context, uint64_t& offset, uint64_t& length) {
         if (context >= write_vec->size()) return false;
         offset = (*write_vec)[context].offset;
         length = (*write_vec)[context].length;
@@ -177,13 +281,31 @@ struct UnmapTask : public WriteTask {
         return true;
     }
 
-    void swapFullBlockOffsets(block_offset_list& offsets) {
-        fullBlockOffsets.swap(offsets);
+    // Add a run of full objects, overlapping or adjacent runs are joined
+    static void addFullBlockRange(block_offset_list& offsets, uint64_t start, uint64_t end) {
+        auto itr = offsets.upper_bound(start);
+        if ((offsets.begin() != itr) && (std::prev(itr)->second + 1 >= start)) {
+            --itr;
+            start = itr->first;
+        }
+        while ((offsets.end() != itr) && (itr->first <= end + 1)) {
+            if (itr->second > end) end = itr->second;
+            itr = offsets.erase(itr);
+        }
+        offsets.emplace(start, end);
     }
 
 private:
     unmap_vec_ptr       write_vec;
-    block_offset_list   fullBlockOffsets;
+};
+
+/**
+ * Responded to once every write executed before it on the volume has been
+ * committed, it covers no range of its own.
+ */
+struct FlushTask : public RWTask {
+    FlushTask(ProtoTask* p_task) : RWTask(p_task, TaskType::FLUSH) {}
+    virtual TaskType match(const TaskVisitor* v) { return v->matchFlush(this); }
 };
 
 }  // namespace block
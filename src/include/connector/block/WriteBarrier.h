@@ -0,0 +1,89 @@
+/*
+ * WriteBarrier.h
+ *
+ * Copyright (c) 2016, Andreas Griesshammer <andreas@formationds.com>
+ * Copyright (c) 2016, Formation Data Systems
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _WRITEBARRIER_H
+#define _WRITEBARRIER_H
+
+// System includes
+#include <atomic>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace fds {
+namespace block {
+
+struct BlockTask;
+
+/**
+ * A WriteBarrier holds tasks back until every write started before them is
+ * done, which is what a flush has to wait for.
+ *
+ * Writes are counted per epoch rather than tracked one by one, a new epoch
+ * only begins when a task starts waiting. With no flush around starting and
+ * finishing a write is a counter update under a lock.
+ */
+class WriteBarrier {
+public:
+    struct Stats {
+        uint64_t barriers {0};
+        uint64_t waited {0};
+    };
+
+    WriteBarrier() = default;
+    WriteBarrier(WriteBarrier const&) = delete;
+    WriteBarrier& operator=(WriteBarrier const&) = delete;
+
+    // A write starts, the epoch returned is handed back once it is done
+    uint64_t start();
+
+    // The write started in epoch is done, tasks no longer held back by
+    // any write are added to passed
+    void done(uint64_t const epoch, std::vector<BlockTask*>& passed);
+
+    /**
+     * Hold task back until all writes started so far are done
+     * \return false if there are none and task can go on right away
+     */
+    bool wait(BlockTask* task);
+
+    // Some task is being held back
+    bool waiting() const { return (0 < _waitingCount.load(std::memory_order_relaxed)); }
+
+    Stats getStats() const;
+
+private:
+    mutable std::mutex                              _lock;
+    uint64_t                                        _epoch {0};
+    // Writes in flight by the epoch they started in
+    std::map<uint64_t, uint64_t>                    _writes;
+    // Tasks by the last epoch they wait for, oldest first
+    std::deque<std::pair<uint64_t, BlockTask*>>     _waiting;
+
+    std::atomic<size_t>                             _waitingCount {0};
+    std::atomic<uint64_t>                           _barriers {0};
+    std::atomic<uint64_t>                           _waited {0};
+};
+
+} // namespace block
+} // namespace fds
+
+#endif // _WRITEBARRIER_H
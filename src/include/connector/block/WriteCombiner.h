@@ -0,0 +1,133 @@
+/*
+ * WriteCombiner.h
+ *
+ * Copyright (c) 2016, Andreas Griesshammer <andreas@formationds.com>
+ * Copyright (c) 2016, Formation Data Systems
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _WRITECOMBINER_H
+#define _WRITECOMBINER_H
+
+// System includes
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// FDS includes
+#include "BlockTools.h"
+
+namespace fds {
+namespace block {
+
+class BufferPool;
+struct WriteTask;
+
+/**
+ * The WriteCombiner holds back writes smaller than an object for a short
+ * window so that adjacent writes to the same object can go out as one.
+ * A buffered object is flushed when its writes cover all of it, when a
+ * write that isn't adjacent arrives or once the window has passed.
+ *
+ * A flush hands the first task of the object to the flush function with
+ * its offset, length and buffer set to the combined write. The other
+ * tasks are added to it with WriteTask::addCombined and are responded to
+ * when it is, writes are still only acknowledged once committed. The
+ * combined objects are buffers of the volume's BufferPool.
+ */
+class WriteCombiner {
+    using clock = std::chrono::steady_clock;
+
+public:
+    using flush_fn = std::function<void(WriteTask*)>;
+
+    struct Stats {
+        uint64_t combined {0};
+        uint64_t flushes {0};
+        uint64_t fullObjects {0};
+        size_t   objects {0};
+    };
+
+    /**
+     * \param window a window of 0 disables combining
+     * \param pool the combined objects are taken from
+     * \param flush is called without any lock held
+     */
+    WriteCombiner(uint32_t const objectSize,
+                  std::chrono::microseconds const window,
+                  std::shared_ptr<BufferPool> pool,
+                  flush_fn flush);
+    WriteCombiner(WriteCombiner const&) = delete;
+    WriteCombiner& operator=(WriteCombiner const&) = delete;
+    ~WriteCombiner();
+
+    /**
+     * Buffer a write, the task must not be touched after this returns true.
+     * \return false if the write can't be combined, the caller has to flush
+     *         the objects it covers and execute it
+     */
+    bool add(WriteTask* task);
+
+    // Flush the buffered writes of the objects start to end
+    void flush(uint64_t const start, uint64_t const end);
+
+    // Stop buffering, writes still buffered are flushed right away
+    void stop();
+
+    bool enabled() const { return (0 < _window.count()); }
+    std::chrono::microseconds window() const { return _window; }
+    Stats getStats() const;
+
+private:
+    struct Pending {
+        uint32_t                    lo;
+        uint32_t                    hi;
+        std::shared_ptr<std::string> data;
+        std::vector<WriteTask*>     tasks;
+        clock::time_point           deadline;
+    };
+    using pending_map = std::map<uint64_t, Pending>;
+
+    void merge(Pending& p, WriteTask* task, uint32_t const lo, uint32_t const hi);
+    WriteTask* take(pending_map::iterator itr);
+    void run();
+
+    uint32_t const                      _objectSize;
+    ObjectGeometry const                _geometry;
+    std::chrono::microseconds const     _window;
+    std::shared_ptr<BufferPool> const   _pool;
+    flush_fn const                      _flush;
+
+    mutable std::mutex                  _lock;
+    std::condition_variable             _cv;
+    pending_map                         _pending;
+    bool                                _stopping {false};
+    std::thread                         _flusher;
+
+    std::atomic<uint64_t>               _combined {0};
+    std::atomic<uint64_t>               _flushes {0};
+    std::atomic<uint64_t>               _fullObjects {0};
+};
+
+} // namespace block
+} // namespace fds
+
+#endif // _WRITECOMBINER_H
@@ -21,14 +21,17 @@
 #define _WRITECONTEXT_H
 
 // System includes
+#include <algorithm>
 #include <atomic>
 #include <queue>
 #include <map>
 #include <mutex>
 #include <set>
+#include <vector>
 
 // FDS includes
 #include "xdi/ApiTypes.h"
+#include "IntervalIndex.h"
 
 using namespace xdi;
 
@@ -44,7 +47,21 @@ public:
     enum class ReadBlobResult { OK, PENDING, UNAVAILABLE };
 
     using PendingTasks = std::queue<BlockTask*>;
-    WriteContext(VolumeId volId, std::string& name, uint32_t size);
+
+    // Offsets [start, start + numObjects) committed with id by a WriteBlob
+    struct ObjectExtent {
+        ObjectOffsetVal     start;
+        ObjectOffsetVal     numObjects;
+        ObjectId            id;
+    };
+    using ObjectExtents = std::vector<ObjectExtent>;
+
+    // A WriteContext of a stripe only sees the offsets of its own regions,
+    // every regionObjects offsets in turn belong to one of numStripes
+    // stripes. The regions of the stripe are tracked as a single contiguous
+    // range so a range spanning many regions is still a single blob write.
+    WriteContext(VolumeId volId, std::string& name, uint32_t size,
+                 ObjectOffsetVal regionObjects = 0, ObjectOffsetVal numStripes = 1, ObjectOffsetVal stripe = 0);
     ~WriteContext();
 
     bool addPendingWrite(ObjectOffsetVal const& newStart, ObjectOffsetVal const& newEnd, BlockTask* task);
@@ -53,29 +70,96 @@ public:
     bool getWriteBlobRequest(ObjectOffsetVal const& offset, WriteBlobRequest& req, PendingTasks& queue);
     bool failWriteBlobRequest(ObjectOffsetVal const& offset, PendingTasks& queue);
     void triggerWrite(ObjectOffsetVal const& offset);
+    void triggerWrite(ObjectOffsetVal const& startOffset, ObjectOffsetVal const& endOffset);
 
     int getNumPendingBlobs() { return _pendingBlobWrites.size(); };
 
     QueueResult queue_update(ObjectOffsetVal const& offset, RequestHandle handle);
+    // Range version for tasks that reserved the range, either every offset
+    // gets the update chain (FirstEntry) or none does (Failure)
+    QueueResult queue_update(ObjectOffsetVal const& startOffset, ObjectOffsetVal const& endOffset, RequestHandle handle);
     std::pair<bool, RequestHandle> pop(ObjectOffsetVal const& offset);
 
     void completeBlobWrite(ObjectOffsetVal const& offset, PendingTasks& queue);
+    void completeBlobWrite(ObjectOffsetVal const& offset, PendingTasks& queue, ObjectExtents& committed);
 
     void setOffsetObjectBuffer(ObjectOffsetVal const& offset, std::shared_ptr<std::string> buf);
+    void setOffsetObjectBuffer(ObjectOffsetVal const& startOffset, ObjectOffsetVal const& endOffset, std::shared_ptr<std::string> buf);
     std::shared_ptr<std::string> getOffsetObjectBuffer(ObjectOffsetVal const& offset);
 
     void updateOffset(ObjectOffsetVal const& offset, ObjectId const& id);
+    void updateOffset(ObjectOffsetVal const& startOffset, ObjectOffsetVal const& endOffset, ObjectId const& id);
+
+    // The steps of addReadBlob, for a task whose range is split over
+    // several WriteContexts. Each step has to pass for every range
+    // before the next one is taken.
+    bool checkOverlappingAwaitingBlobWrite
+    (
+      ObjectOffsetVal const&      startOffset,
+      ObjectOffsetVal const&      endOffset,
+      BlockTask*                  task
+    );
+
+    void mergeRanges
+    (
+      ObjectOffsetVal const&      newStart,
+      ObjectOffsetVal const&      newEnd,
+      BlockTask*                  task
+    );
+
+    bool isRangeAvailable
+    (
+      ObjectOffsetVal const&      newStart,
+      ObjectOffsetVal const&      newEnd
+    );
+
+    bool isPendingBlobRead(ObjectOffsetVal const& offset, BlockTask* task);
 
 private:
     BlobPath                     _path;
     uint32_t                     _objectSize;
+    ObjectOffsetVal              _regionObjects;
+    ObjectOffsetVal              _numStripes;
+    ObjectOffsetVal              _stripe;
+
+    // Translate between the volume's offsets and the offsets of the stripe
+    ObjectOffsetVal toLocal(ObjectOffsetVal const& offset) const {
+        if (0 == _regionObjects) return offset;
+        return ((offset / _regionObjects / _numStripes) * _regionObjects) + (offset % _regionObjects);
+    }
+    ObjectOffsetVal toGlobal(ObjectOffsetVal const& offset) const {
+        if (0 == _regionObjects) return offset;
+        return ((((offset / _regionObjects) * _numStripes) + _stripe) * _regionObjects) + (offset % _regionObjects);
+    }
 
     /********************************************
     ** The following structures are used to track
     ** an outstanding Blob and the status off each
     ** offset in that Blob.
+    ** Consecutive offsets in the same state share
+    ** a single PendingOffsetWrite extent, which is
+    ** split up once an offset needs its own state.
     ********************************************/
     struct PendingOffsetWrite {
+        PendingOffsetWrite() = default;
+        PendingOffsetWrite(PendingOffsetWrite&&) = default;
+        PendingOffsetWrite& operator=(PendingOffsetWrite&&) = default;
+
+        // Copy of the state for the tail of a split extent
+        PendingOffsetWrite clone(ObjectOffsetVal const& tailObjects) const {
+            PendingOffsetWrite pow;
+            pow.numObjects = tailObjects;
+            pow.id = id;
+            pow.isStable = isStable;
+            pow.hasPendingWrite = hasPendingWrite;
+            if (nullptr != updateChain) {
+                pow.updateChain.reset(new std::queue<RequestHandle>(*updateChain));
+            }
+            pow.buf = buf;
+            return pow;
+        }
+
+        ObjectOffsetVal numObjects {1};
         ObjectId    id;
         //TODO: isStable could just be absence of ObjectId
         bool        isStable {false};
@@ -84,6 +168,8 @@ private:
         std::shared_ptr<std::string>                  buf;
     };
 
+    using OffsetStatus = IntervalIndex<ObjectOffsetVal, PendingOffsetWrite>;
+
     struct PendingBlobWrite {
         PendingBlobWrite() : numObjects(0) {};
         PendingBlobWrite(PendingBlobWrite&& other) :   numObjects(other.numObjects),
@@ -102,20 +188,20 @@ private:
             }
             other.pendingBlobReads.clear();
             for (auto& s : other.offsetStatus) {
+                numObjects += s.second.numObjects;
                 offsetStatus.emplace(s.first, std::move(s.second));
-                ++numObjects;
             }
             other.offsetStatus.clear();
             return *this;
         }
 
-        int                                            numObjects;
+        ObjectOffsetVal                                numObjects;
         PendingTasks                                   pendingTasks;
         std::set<BlockTask*>                           pendingBlobReads;
-        std::map<ObjectOffsetVal, PendingOffsetWrite>  offsetStatus;
+        OffsetStatus                                   offsetStatus;
     };
 
-    std::map<ObjectOffsetVal, PendingBlobWrite>     _pendingBlobWrites;
+    IntervalIndex<ObjectOffsetVal, PendingBlobWrite>     _pendingBlobWrites;
 
     /********************************************
     ** The following structures are used to track
@@ -124,38 +210,26 @@ private:
     ** for that offset range.
     ********************************************/
     struct AwaitingBlobWrite {
-        int                                numObjects;
+        ObjectOffsetVal                    numObjects;
         PendingTasks                       pendingTasks;
+        ObjectExtents                      committed;
     };
 
-    std::map<ObjectOffsetVal, AwaitingBlobWrite>    _awaitingBlobWrites;
+    IntervalIndex<ObjectOffsetVal, AwaitingBlobWrite>    _awaitingBlobWrites;
 
-    bool checkOverlappingAwaitingBlobWrite
-    (
-      ObjectOffsetVal const&      startOffset,
-      ObjectOffsetVal const&      endOffset,
-      BlockTask*                  task
-    );
+    OffsetStatus* findOffsetStatus(ObjectOffsetVal const& offset);
 
-    bool checkForOverlap
+    static void splitExtent
     (
-      ObjectOffsetVal const&      newStart,
-      ObjectOffsetVal const&      newEnd,
-      ObjectOffsetVal const&      origStart,
-      ObjectOffsetVal const&      origEnd
+      OffsetStatus&               status,
+      ObjectOffsetVal const&      offset
     );
 
-    void mergeRanges
+    static OffsetStatus::iterator isolateRange
     (
-      ObjectOffsetVal const&      newStart,
-      ObjectOffsetVal const&      newEnd,
-      BlockTask*                  task
-    );
-
-    bool isRangeAvailable
-    (
-      ObjectOffsetVal const&      newStart,
-      ObjectOffsetVal const&      newEnd
+      OffsetStatus&               status,
+      ObjectOffsetVal const&      startOffset,
+      ObjectOffsetVal const&      endOffset
     );
 
 };
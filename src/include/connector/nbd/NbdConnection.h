@@ -48,15 +48,16 @@ struct attach_header {
 };
 
 struct handshake_header {
-    uint32_t ack;
+    uint32_t flags;
 };
 
 struct request_header {
     uint8_t magic[4];
-    int32_t opType;
+    uint16_t flags;
+    uint16_t opType;
     int64_t handle;
     int64_t offset;
-    int32_t length;
+    uint32_t length;
 };
 #pragma pack(pop)
 
@@ -95,12 +96,15 @@ struct NbdConnection : public fds::block::BlockOperations {
     int clientSocket;
     size_t volume_size;
     size_t object_size;
+    // Client asked us to leave out the padding of the export name reply
+    bool no_zeroes {false};
 
     NbdConnector* nbd_server;
 
     message<attach_header, std::array<char, 1024>> attach;
     message<handshake_header, std::nullptr_t> handshake;
-    message<request_header, std::shared_ptr<std::string>> request;
+    // Write payloads are read straight into a buffer per object
+    message<request_header, std::vector<std::shared_ptr<std::string>>> request;
 
     resp_vector_type response;
     size_t total_blocks;
@@ -108,6 +112,10 @@ struct NbdConnection : public fds::block::BlockOperations {
 
     boost::lockfree::queue<NbdTask*> readyResponses;
     std::unique_ptr<NbdTask> current_response;
+    // Tasks that have been responded to, reused for new requests
+    std::vector<std::unique_ptr<NbdTask>> free_tasks;
+
+    NbdTask* newTask(uint64_t const handle);
 
     std::unique_ptr<ev::io> ioWatcher;
     std::unique_ptr<ev::async> asyncWatcher;
@@ -129,6 +137,11 @@ struct NbdConnection : public fds::block::BlockOperations {
 
     NbdProtoState nbd_state;
 
+    // Reply to the current option and the state to go to once it's sent,
+    // INVALID closes the connection
+    std::string option_buffer;
+    NbdProtoState option_next {NbdProtoState::AWAITOPTS};
+
     std::shared_ptr<xdi::ApiInterface> api_;
 
     // Handshake State
@@ -138,6 +151,9 @@ struct NbdConnection : public fds::block::BlockOperations {
     // Option Negotiation State
     void option_request(ev::io &watcher);
     bool option_reply(ev::io &watcher);
+    void option_export_name();
+    void option_info(bool const go);
+    void queue_option_reply(uint32_t const type, std::string const& data = std::string());
 
     // Data IO State
     bool io_request(ev::io &watcher);
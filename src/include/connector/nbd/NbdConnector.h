@@ -22,6 +22,7 @@
 
 #include <memory>
 #include <mutex>
+#include <vector>
 
 #include "connector/nbd/common.h"
 
@@ -36,7 +37,7 @@ namespace fds {
 namespace connector {
 namespace nbd {
 
-struct NbdConnection;
+struct NbdReactor;
 
 struct NbdConnector : public xdi::ApiResponseInterface
 {
@@ -76,11 +77,17 @@ struct NbdConnector : public xdi::ApiResponseInterface
     bool cfg_no_delay {true};
     uint32_t cfg_keep_alive {30};
 
+    // How accepted sockets are spread across the event loops
+    enum class LoopPolicy { ROUND_ROBIN, LEAST_LOADED };
+    // Number of event loops running connections, 0 for one per CPU
+    uint32_t cfg_loops {0};
+    bool cfg_pin_loops {true};
+    LoopPolicy cfg_loop_policy {LoopPolicy::LEAST_LOADED};
+
     template<typename T>
     using shared = std::shared_ptr<T>;
-    using connection_ptr = shared<NbdConnection>;
+    using reactor_ptr = shared<NbdReactor>;
 
-    using conn_map_type = std::map<int, connection_ptr>;
     using vol_map_type = std::map<std::string, volume_ptr>;
 
     static std::shared_ptr<NbdConnector> instance_;
@@ -88,9 +95,12 @@ struct NbdConnector : public xdi::ApiResponseInterface
     bool stopping {false};
 
     std::mutex connection_lock;
-    conn_map_type connection_map;
     vol_map_type volume_id_map;
 
+    // Connections run on these loops, the accepting loop only accepts
+    std::vector<reactor_ptr> reactors;
+    size_t next_reactor {0};
+
     std::shared_ptr<ev::dynamic_loop> evLoop;
     std::unique_ptr<ev::io> evIoWatcher;
     std::unique_ptr<ev::async> asyncWatcher;
@@ -103,6 +113,8 @@ struct NbdConnector : public xdi::ApiResponseInterface
     void configureSocket(int fd) const;
     void discoverTargets();
     void initialize();
+    void startReactors();
+    NbdReactor& pickReactor();
     void reset();
     void nbdAcceptCb(ev::io &watcher, int revents);
     void startShutdown();
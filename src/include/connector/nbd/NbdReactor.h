@@ -0,0 +1,99 @@
+/*
+ * NbdReactor.h
+ *
+ * Copyright (c) 2016, Andreas Griesshammer <andreas@formationds.com>
+ * Copyright (c) 2016, Formation Data Systems
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef SOURCE_ACCESS_MGR_INCLUDE_CONNECTOR_NBD_NBDREACTOR_H_
+#define SOURCE_ACCESS_MGR_INCLUDE_CONNECTOR_NBD_NBDREACTOR_H_
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "connector/nbd/common.h"
+
+namespace xdi
+{
+class ApiInterface;
+}  // namespace xdi
+
+namespace fds {
+namespace connector {
+namespace nbd {
+
+struct NbdConnection;
+struct NbdConnector;
+
+/**
+ * An event loop of its own thread, optionally pinned to a CPU, that runs
+ * the NbdConnections handed to it. Sockets are accepted elsewhere and
+ * passed in with add(), the connection is created on the reactor's thread
+ * so all of its watchers only ever run there.
+ */
+struct NbdReactor
+{
+    /**
+     * \param cpu the CPU to pin the loop's thread to, -1 to not pin it
+     */
+    NbdReactor(NbdConnector* server, std::shared_ptr<xdi::ApiInterface> api, int const cpu);
+    NbdReactor(NbdReactor const& rhs) = delete;
+    NbdReactor& operator=(NbdReactor const& rhs) = delete;
+    ~NbdReactor() = default;
+
+    // Start the loop's thread
+    void start();
+
+    // Create a connection for the accepted socket on this loop
+    void add(int const clientsd);
+
+    // Forget the connection of clientsd, false if it isn't one of ours
+    bool remove(int const clientsd);
+
+    // Terminate every connection and close the sockets not yet picked up
+    void terminate();
+
+    // Connections running on or handed to this loop
+    size_t load() const { return connectionCount.load(std::memory_order_relaxed); }
+
+ private:
+    using connection_ptr = std::shared_ptr<NbdConnection>;
+    using conn_map_type = std::map<int, connection_ptr>;
+
+    NbdConnector* nbd_server;
+    std::shared_ptr<xdi::ApiInterface> api_;
+    int const cpu;
+
+    std::mutex connection_lock;
+    bool stopping {false};
+    std::vector<int> accepted;
+    conn_map_type connection_map;
+    std::atomic<size_t> connectionCount {0};
+
+    std::shared_ptr<ev::dynamic_loop> evLoop;
+    std::unique_ptr<ev::async> asyncWatcher;
+
+    void run();
+    void acceptedCb(ev::async &watcher, int revents);
+};
+
+}  // namespace nbd
+}  // namespace connector
+}  // namespace fds
+
+#endif  // SOURCE_ACCESS_MGR_INCLUDE_CONNECTOR_NBD_NBDREACTOR_H_
@@ -6,6 +6,7 @@
 #define NBDTASK_H_
 
 // FDS includes
+#include "connector/block/BufferView.h"
 #include "connector/block/ProtoTask.h"
 
 namespace fds {
@@ -13,8 +14,7 @@ namespace connector {
 namespace nbd {
 
 struct NbdTask : public fds::block::ProtoTask {
-    using buffer_type = std::string;
-    using buffer_ptr_type = std::shared_ptr<buffer_type>;
+    using buffer_view_type = fds::block::BufferView;
 
     NbdTask(uint64_t const hdl);
     ~NbdTask() = default;
@@ -23,19 +23,27 @@ struct NbdTask : public fds::block::ProtoTask {
     void setRead() { readTask = true; }
 
     /// Buffer operations
-    buffer_ptr_type getNextReadBuffer(uint32_t& context) {
+    buffer_view_type const* getNextReadBuffer(uint32_t& context) const {
         if (context >= bufVec.size()) {
             return nullptr;
         }
-        return bufVec[context++];
+        return &bufVec[context++];
     }
 
-    std::vector<buffer_ptr_type>& getBufVec() { return bufVec; }
+    std::vector<buffer_view_type>& getBufVec() { return bufVec; }
+
+    /// Reuse the task for another request, keeps the capacity of bufVec
+    void reset(uint64_t const hdl) {
+        handle = hdl;
+        setError(xdi::ApiErrorCode::XDI_OK);
+        readTask = false;
+        bufVec.clear();
+    }
 
 private:
     bool    readTask{false};
 
-    std::vector<buffer_ptr_type>   bufVec;
+    std::vector<buffer_view_type>  bufVec;
 };
 
 }  // namespace scst
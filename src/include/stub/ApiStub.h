@@ -19,6 +19,13 @@
 #ifndef SRC_APISTUB_H
 #define SRC_APISTUB_H
 
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
 #include "xdi/ApiTypes.h"
 #include "stub/FdsStub.h"
 
@@ -53,10 +60,13 @@ private:
 // then detaches from it.  This makes the response call
 // to come back on a separate thread and allow the request
 // call to immediately return.
+// If a number of threads is given the calls are instead
+// queued up for that many completion threads.
 class AsyncApiStub : public ApiStub {
 
 public:
-    AsyncApiStub(std::shared_ptr<FdsStub> stub, uint32_t delay);
+    AsyncApiStub(std::shared_ptr<FdsStub> stub, uint32_t delay, uint32_t threads = 0);
+    ~AsyncApiStub();
 
     virtual void list(Request const& requestId, ListBlobsRequest const& request) override;
     virtual void readBlob(Request const& requestId, ReadBlobRequest const& request) override;
@@ -68,6 +78,21 @@ public:
     virtual void deleteBlob(Request const& requestId, BlobPath const& target) override;
     virtual void statVolume(Request const& requestId, VolumeId const volumeId) override;
     virtual void listAllVolumes(Request const& requestId, ListAllVolumesRequest const& request) override;
+
+    // Wait until the completion threads have run every queued call,
+    // only usable when the stub was created with threads
+    void waitIdle();
+private:
+    std::mutex                                _callsLock;
+    std::condition_variable                   _callsCv;
+    std::condition_variable                   _idleCv;
+    std::queue<std::function<void()>>         _calls;
+    std::vector<std::thread>                  _workers;
+    uint32_t                                  _running {0};
+    bool                                      _stopping {false};
+
+    void dispatch(std::function<void()>&& call);
+    void run();
 };
 
 } // namespace xdi
@@ -0,0 +1,224 @@
+/*
+ * BlobMetadataCache.cpp
+ *
+ * Copyright (c) 2016, Andreas Griesshammer <andreas@formationds.com>
+ * Copyright (c) 2016, Formation Data Systems
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+// System includes
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+// FDS includes
+#include "connector/block/BlobMetadataCache.h"
+
+namespace fds {
+namespace block {
+
+BlobMetadataCache::BlobMetadataCache(size_t const maxExtents, std::chrono::milliseconds const lifetime)
+        : _maxExtents(maxExtents),
+          _lifetime(lifetime)
+{
+}
+
+bool BlobMetadataCache::expired(Extent const& extent, clock::time_point const now) const {
+    return ((extent.stamp + _lifetime) <= now);
+}
+
+// Split the extent containing offset so that one starts at offset
+// NOTE: _lock should be held when calling this
+void BlobMetadataCache::split(xdi::ObjectOffsetVal const offset) {
+    auto itr = _extents.find(offset);
+    if ((_extents.end() == itr) || (offset == itr->first)) return;
+    Extent tail;
+    tail.numObjects = itr->second.numObjects - (offset - itr->first);
+    tail.id = itr->second.id;
+    tail.stamp = itr->second.stamp;
+    itr->second.numObjects = offset - itr->first;
+    _extents.emplace(offset, std::move(tail));
+}
+
+// NOTE: _lock should be held when calling this
+void BlobMetadataCache::isolate(xdi::ObjectOffsetVal const start, xdi::ObjectOffsetVal const end) {
+    split(end + 1);
+    split(start);
+}
+
+// NOTE: _lock should be held when calling this
+void BlobMetadataCache::erase(xdi::ObjectOffsetVal const start, xdi::ObjectOffsetVal const end) {
+    isolate(start, end);
+    auto itr = _extents.findOverlapping(start, end);
+    while ((_extents.end() != itr) && (itr->first <= end)) {
+        itr = _extents.erase(itr);
+    }
+}
+
+// NOTE: _lock should be held and [start, end] be unknown when calling this
+void BlobMetadataCache::add
+(
+  xdi::ObjectOffsetVal const    start,
+  xdi::ObjectOffsetVal const    end,
+  xdi::ObjectId const&          id,
+  clock::time_point const       stamp
+)
+{
+    Extent extent;
+    extent.numObjects = end - start + 1;
+    extent.id = id;
+    extent.stamp = stamp;
+    _extents.emplace(start, std::move(extent));
+}
+
+// NOTE: _lock should be held when calling this
+void BlobMetadataCache::checkLimit() {
+    if (_maxExtents < _extents.size()) {
+        _extents.clear();
+        ++_version;
+        ++_invalidations;
+    }
+}
+
+bool BlobMetadataCache::lookup(xdi::ObjectOffsetVal const start, xdi::ObjectOffsetVal const end, object_map& objects) {
+    if (false == enabled()) return false;
+    auto now = clock::now();
+    std::lock_guard<std::mutex> lg(_lock);
+    auto next = start;
+    for (auto itr = _extents.findOverlapping(start, end); next <= end; ++itr) {
+        if ((_extents.end() == itr) || (itr->first > next) || (true == expired(itr->second, now))) {
+            objects.clear();
+            ++_misses;
+            return false;
+        }
+        auto last = std::min(extent_index::lastOffset(itr), end);
+        if (false == itr->second.id.empty()) {
+            for (auto o = next; o <= last; ++o) {
+                objects.emplace_hint(objects.end(), o, itr->second.id);
+            }
+        }
+        next = last + 1;
+    }
+    ++_hits;
+    return true;
+}
+
+void BlobMetadataCache::populate
+(
+  xdi::ObjectOffsetVal const    start,
+  xdi::ObjectOffsetVal const    end,
+  object_map const&             objects,
+  uint64_t const                version
+)
+{
+    if (false == enabled()) return;
+    auto now = clock::now();
+    std::lock_guard<std::mutex> lg(_lock);
+    if (version != _version.load()) return;
+
+    // Expired extents are refreshed like unknown ones
+    std::vector<std::pair<xdi::ObjectOffsetVal, xdi::ObjectOffsetVal>> stale;
+    for (auto itr = _extents.findOverlapping(start, end); (_extents.end() != itr) && (itr->first <= end); ++itr) {
+        if (true == expired(itr->second, now)) {
+            stale.emplace_back(std::max(itr->first, start), std::min(extent_index::lastOffset(itr), end));
+        }
+    }
+    for (auto const& s : stale) {
+        erase(s.first, s.second);
+    }
+
+    // Fill every gap in [start, end], consecutive offsets with the same
+    // ObjectId (or hole) become a single extent
+    auto fill = [this, &objects, now] (xdi::ObjectOffsetVal const gapStart, xdi::ObjectOffsetVal const gapEnd) {
+        auto runStart = gapStart;
+        xdi::ObjectId runId;
+        auto o_itr = objects.lower_bound(gapStart);
+        if ((objects.end() != o_itr) && (gapStart == o_itr->first)) {
+            runId = o_itr->second;
+        }
+        auto next = gapStart;
+        while (next <= gapEnd) {
+            // Next offset where the ObjectId might change
+            xdi::ObjectOffsetVal change;
+            xdi::ObjectId id;
+            if ((objects.end() != o_itr) && (o_itr->first <= gapEnd)) {
+                if (o_itr->first == next) {
+                    id = o_itr->second;
+                    change = next + 1;
+                    ++o_itr;
+                } else {
+                    change = o_itr->first;
+                }
+            } else {
+                change = gapEnd + 1;
+            }
+            if (id != runId) {
+                add(runStart, next - 1, runId, now);
+                runStart = next;
+                runId = id;
+            }
+            next = change;
+        }
+        add(runStart, gapEnd, runId, now);
+    };
+
+    auto next = start;
+    auto itr = _extents.findOverlapping(start, end);
+    while (next <= end) {
+        if ((_extents.end() != itr) && (itr->first <= next)) {
+            next = extent_index::lastOffset(itr) + 1;
+            ++itr;
+            continue;
+        }
+        auto gapEnd = ((_extents.end() != itr) && (itr->first <= end)) ? (itr->first - 1) : end;
+        fill(next, gapEnd);
+        next = gapEnd + 1;
+    }
+    checkLimit();
+}
+
+void BlobMetadataCache::assign(xdi::ObjectOffsetVal const start, xdi::ObjectOffsetVal const end, xdi::ObjectId const& id) {
+    if (false == enabled()) return;
+    auto now = clock::now();
+    std::lock_guard<std::mutex> lg(_lock);
+    erase(start, end);
+    add(start, end, id, now);
+    checkLimit();
+}
+
+void BlobMetadataCache::invalidate(xdi::ObjectOffsetVal const start, xdi::ObjectOffsetVal const end) {
+    std::lock_guard<std::mutex> lg(_lock);
+    erase(start, end);
+    ++_version;
+    ++_invalidations;
+}
+
+void BlobMetadataCache::clear() {
+    std::lock_guard<std::mutex> lg(_lock);
+    _extents.clear();
+    ++_version;
+}
+
+BlobMetadataCache::Stats BlobMetadataCache::getStats() {
+    Stats stats;
+    stats.hits = _hits.load();
+    stats.misses = _misses.load();
+    stats.invalidations = _invalidations.load();
+    std::lock_guard<std::mutex> lg(_lock);
+    stats.extents = _extents.size();
+    return stats;
+}
+
+} // namespace block
+} // namespace fds
@@ -21,7 +21,9 @@
 // System includes
 #include <algorithm>
 #include <deque>
+#include <limits>
 #include <map>
+#include <set>
 #include <string>
 #include <thread>
 #include <utility>
@@ -30,30 +32,128 @@
 // FDS includes
 #include "connector/block/Tasks.h"
 #include "connector/block/BlockOperations.h"
+#include "connector/block/BlobMetadataCache.h"
+#include "connector/block/BufferPool.h"
+#include "connector/block/CommitGroup.h"
+#include "connector/block/ObjectCache.h"
+#include "connector/block/ReadAhead.h"
+#include "connector/block/TaskPool.h"
+#include "connector/block/WriteBarrier.h"
+#include "connector/block/WriteCombiner.h"
 #include "connector/block/WriteContext.h"
 #include "log/Logger.h"
 
 namespace fds {
 namespace block {
 
+/**
+ * The BlockOperations running the tasks of every connection to a volume.
+ * It is never executed on itself, tasks are responded to by their owners.
+ */
+class VolumeEngine final : public BlockOperations {
+  public:
+    using BlockOperations::BlockOperations;
+    void respondTask(BlockTask*) override {}
+};
+
 /**
  * Since multiple connections can serve the same volume we need
  * to keep this association information somewhere so we can
- * properly detach from the volume when unused.
+ * properly detach from the volume when unused. The engine shared
+ * by all connections to a volume lives here as well.
  */
-static std::unordered_map<std::string, std::uint_fast16_t> assoc_map {};
+struct VolumeAssoc {
+    std::uint_fast16_t                  connections {0};
+    std::shared_ptr<BlockOperations>    engine;
+};
+static std::unordered_map<std::string, VolumeAssoc> assoc_map {};
 static std::mutex assoc_map_lock {};
 
+// Object cache memory limit per volume, protected by assoc_map_lock
+static size_t object_cache_bytes {64 * 1024 * 1024};
+// Blob metadata cache limits per volume, protected by assoc_map_lock
+static size_t blob_metadata_extents {1024 * 1024};
+static std::chrono::milliseconds blob_metadata_lifetime {10000};
+// Memory kept in free object buffers per volume, protected by assoc_map_lock
+static size_t buffer_pool_bytes {32 * 1024 * 1024};
+// Write combining window for new connections, protected by assoc_map_lock
+static std::chrono::microseconds write_combine_window {0};
+// WriteBlob grouping for new connections, protected by assoc_map_lock
+static std::chrono::microseconds commit_group_interval {0};
+static size_t commit_group_ranges {64};
+// Tasks in flight per volume, protected by assoc_map_lock
+static size_t task_table_size {4096};
+// Read ahead window in objects per volume, protected by assoc_map_lock
+static uint32_t read_ahead_min {1};
+static uint32_t read_ahead_max {16};
+
 static const uint32_t ZERO_OFFSET = 0;
 
+// Full objects of recent WRITE SAME patterns kept per connection
+static const size_t PATTERN_OBJECTS = 4;
+
+// Finished tasks of every kind kept for reuse per connection
+static const size_t POOLED_TASKS = 256;
+
+// Objects per stripe region and number of stripes the regions are spread over
+static const uint64_t STRIPE_REGION_OBJECTS = 1024;
+static const size_t WRITE_STRIPES = 16;
+
 BlockOperations::BlockOperations(std::shared_ptr<ApiInterface> interface)
         : volumeName(nullptr),
           blobName(new std::string("BlockBlob")),
           domainName(new std::string("TestDomain")),
           blobMode(new int32_t(0)),
           emptyMeta(new std::map<std::string, std::string>()),
-          api(interface)
+          api(interface),
+          taskPool(std::make_shared<TaskPool>(POOLED_TASKS)),
+          owner(std::make_shared<TaskOwner>())
 {
+    owner->connection = this;
+}
+
+BlockOperations::~BlockOperations() {
+    if (writeCombiner) writeCombiner->stop();
+    if (commitGroup) commitGroup->stop();
+    detachVolume();
+}
+
+void BlockOperations::setObjectCacheSize(size_t const bytes) {
+    std::lock_guard<std::mutex> lk(assoc_map_lock);
+    object_cache_bytes = bytes;
+}
+
+void BlockOperations::setBlobMetadataCache(size_t const maxExtents, std::chrono::milliseconds const lifetime) {
+    std::lock_guard<std::mutex> lk(assoc_map_lock);
+    blob_metadata_extents = maxExtents;
+    blob_metadata_lifetime = lifetime;
+}
+
+void BlockOperations::setBufferPoolSize(size_t const bytes) {
+    std::lock_guard<std::mutex> lk(assoc_map_lock);
+    buffer_pool_bytes = bytes;
+}
+
+void BlockOperations::setWriteCombineWindow(std::chrono::microseconds const window) {
+    std::lock_guard<std::mutex> lk(assoc_map_lock);
+    write_combine_window = window;
+}
+
+void BlockOperations::setTaskTableSize(size_t const tasks) {
+    std::lock_guard<std::mutex> lk(assoc_map_lock);
+    task_table_size = tasks;
+}
+
+void BlockOperations::setReadAheadWindow(uint32_t const minObjects, uint32_t const maxObjects) {
+    std::lock_guard<std::mutex> lk(assoc_map_lock);
+    read_ahead_min = minObjects;
+    read_ahead_max = maxObjects;
+}
+
+void BlockOperations::setCommitGroup(std::chrono::microseconds const interval, size_t const maxRanges) {
+    std::lock_guard<std::mutex> lk(assoc_map_lock);
+    commit_group_interval = interval;
+    commit_group_ranges = maxRanges;
 }
 
 // We can't initialize this in the constructor since we want to pass
@@ -68,35 +168,184 @@ BlockOperations::init(std::string                    vol_name,
     volumeId = vol_id;
 
     maxObjectSizeInBytes = obj_size;
-    empty_buffer = std::make_shared<std::string>(maxObjectSizeInBytes, '\0');
-    // Reference count this association
+    objectGeometry = ObjectGeometry(obj_size);
+    // Reference count this association, the first connection starts the engine
     std::lock_guard<std::mutex> lk(assoc_map_lock);
-    ++assoc_map[*volumeName];
-    ctx.reset(new WriteContext(volumeId, *blobName, maxObjectSizeInBytes));
+    auto& assoc = assoc_map[*volumeName];
+    if (0 == assoc.connections++) {
+        assoc.engine = std::make_shared<VolumeEngine>(api);
+        assoc.engine->attach(vol_id, obj_size);
+    }
+    engine = assoc.engine;
+    empty_buffer = engine->empty_buffer;
+    objectCache = engine->objectCache;
+    blobMetadata = engine->blobMetadata;
+    readAhead = engine->readAhead;
+    bufferPool = engine->bufferPool;
+}
+
+// Set up the engine of a volume
+// NOTE: the assoc_map lock should be held when calling this
+void
+BlockOperations::attach(uint64_t const vol_id, uint32_t const obj_size)
+{
+    volumeId = vol_id;
+    maxObjectSizeInBytes = obj_size;
+    objectGeometry = ObjectGeometry(obj_size);
+    empty_buffer = std::make_shared<std::string>(maxObjectSizeInBytes, '\0');
+    responses.reset(new response_map_type(task_table_size));
+    objectCache = std::make_shared<ObjectCache>(object_cache_bytes);
+    blobMetadata = std::make_shared<BlobMetadataCache>(blob_metadata_extents, blob_metadata_lifetime);
+    readAhead = std::make_shared<ReadAhead>(api, volumeId, *blobName, objectCache, blobMetadata,
+                                            read_ahead_min, read_ahead_max);
+    bufferPool = std::make_shared<BufferPool>(maxObjectSizeInBytes, buffer_pool_bytes / maxObjectSizeInBytes);
+    writeCombiner = std::make_shared<WriteCombiner>(maxObjectSizeInBytes, write_combine_window, bufferPool,
+                                                    [this] (WriteTask* t) { flushCombined(t); });
+    commitGroup = std::make_shared<CommitGroup>(commit_group_interval, commit_group_ranges,
+                                                [this] (xdi_handle const& requestId,
+                                                        WriteBlobRequest& req,
+                                                        std::vector<xdi_handle>& group)
+                                                { sendCommitGroup(requestId, req, group); });
+    writeBarrier = std::make_shared<WriteBarrier>();
+    stripes.clear();
+    for (size_t i = 0; i < WRITE_STRIPES; ++i) {
+        std::unique_ptr<WriteStripe> stripe(new WriteStripe());
+        stripe->ctx.reset(new WriteContext(volumeId, *blobName, maxObjectSizeInBytes,
+                                           STRIPE_REGION_OBJECTS, WRITE_STRIPES, i));
+        stripes.emplace_back(std::move(stripe));
+    }
+}
+
+void BlockOperations::allocateWriteBuffers(uint64_t const offset, size_t const length, std::vector<string_ptr>& bufs) {
+    bufs.clear();
+    size_t allocated {0};
+    while (allocated < length) {
+        auto piece = std::min(length - allocated,
+                              static_cast<size_t>(maxObjectSizeInBytes - objectGeometry.offsetInObject(offset + allocated)));
+        bufs.emplace_back(bufferPool->get(piece));
+        allocated += piece;
+    }
+}
+
+BlockOperations::StripeLock::StripeLock(BlockOperations& ops, stripe_ranges const& ranges) {
+    std::set<size_t> indexes;
+    for (auto const& r : ranges) {
+        indexes.insert(r.stripe);
+    }
+    // Always lock in ascending order so tasks spanning stripes can't deadlock
+    for (auto const& i : indexes) {
+        locks.emplace_back(ops.stripes[i]->lock);
+    }
+}
+
+BlockOperations::WriteStripe& BlockOperations::stripeFor(uint64_t const offset) {
+    return *stripes[(offset / STRIPE_REGION_OBJECTS) % stripes.size()];
+}
+
+// The offsets of [start, end] owned by stripe run from its first region in
+// the range to its last one. Returns false if it owns none of them.
+bool BlockOperations::stripeRange(size_t const stripe, uint64_t const start, uint64_t const end, StripeRange& range) const {
+    uint64_t const numStripes = stripes.size();
+    auto const firstRegion = start / STRIPE_REGION_OBJECTS;
+    auto const lastRegion = end / STRIPE_REGION_OBJECTS;
+    auto const region = firstRegion + ((stripe + numStripes - (firstRegion % numStripes)) % numStripes);
+    if (region > lastRegion) return false;
+    auto const last = region + (((lastRegion - region) / numStripes) * numStripes);
+    range.stripe = stripe;
+    range.start = std::max(start, region * STRIPE_REGION_OBJECTS);
+    range.end = std::min(end, ((last + 1) * STRIPE_REGION_OBJECTS) - 1);
+    return true;
+}
+
+void BlockOperations::stripeRanges(uint64_t const start, uint64_t const end, stripe_ranges& ranges) const {
+    ranges.clear();
+    uint64_t const numStripes = stripes.size();
+    auto const firstRegion = start / STRIPE_REGION_OBJECTS;
+    auto const lastRegion = end / STRIPE_REGION_OBJECTS;
+    StripeRange range;
+    for (auto region = firstRegion; (region <= lastRegion) && (region < (firstRegion + numStripes)); ++region) {
+        if (true == stripeRange(region % numStripes, start, end, range)) {
+            ranges.push_back(range);
+        }
+    }
+}
+
+bool BlockOperations::inRanges(stripe_ranges const& ranges, uint64_t const offset) const {
+    auto const stripe = (offset / STRIPE_REGION_OBJECTS) % stripes.size();
+    return std::any_of(ranges.begin(), ranges.end(),
+                       [stripe, offset] (StripeRange const& r)
+                       { return (stripe == r.stripe) && (r.start <= offset) && (offset <= r.end); });
 }
 
 
 void
 BlockOperations::detachVolume() {
+    disown();
     if (volumeName) {
         // Only close the volume if it's the last connection
-        std::lock_guard<std::mutex> lk(assoc_map_lock);
-        auto it = assoc_map.find(*volumeName);
-        if (assoc_map.end() != it) {
-            if (0 == --it->second) {
-                assoc_map.erase(it);
+        std::shared_ptr<BlockOperations> last;
+        {
+            std::lock_guard<std::mutex> lk(assoc_map_lock);
+            auto it = assoc_map.find(*volumeName);
+            if (assoc_map.end() != it) {
+                if (0 == --it->second.connections) {
+                    last = it->second.engine;
+                    assoc_map.erase(it);
+                }
             }
         }
+        if (last) last->stop();
+        volumeName.reset();
     }
 }
 
+// Tasks of this connection still in flight finish without a response
+void
+BlockOperations::disown() {
+    std::lock_guard<std::mutex> lg(owner->lock);
+    owner->connection = nullptr;
+}
+
 void
 BlockOperations::executeTask(RWTask* task) {
-    task->setMaxObjectSize(maxObjectSizeInBytes);
+    if ((nullptr == engine) || (true == shutting_down)) {
+        throw BlockError::connection_closed;
+    }
+    task->setOwner(owner);
+    task->setHandle(engine->nextHandle++);
+    engine->runTask(task);
+}
+
+void
+BlockOperations::runTask(RWTask* task) {
+    task->setObjectGeometry(objectGeometry);
     {   // add response that we will fill in with data
-        std::unique_lock<std::mutex> l(respLock);
-        if (false == responses.emplace(std::make_pair(task->getProtoTask()->getHandle(), task)).second)
-            { throw BlockError::connection_closed; }
+        if (false == responses->insert(task->getHandle(), task)) {
+            // Too many tasks in flight on the volume, only this one fails
+            // and it can be retried
+            LOGWARN("handle:{} task table full", task->getHandle());
+            task->getProtoTask()->setError(ApiErrorCode::XDI_SERVICE_NOT_READY);
+            respond(task);
+            return;
+        }
+    }
+    auto taskType = task->getType();
+    if (TaskType::FLUSH == taskType) {
+        flushWrites(task);
+        return;
+    }
+    if (TaskType::READ != taskType) {
+        auto writeTask = static_cast<WriteTask*>(task);
+        writeTask->setEpoch(writeBarrier->start());
+        if ((TaskType::WRITE == taskType) && (false == writeTask->isFua()) &&
+            (true == writeCombiner->add(writeTask))) {
+            return;
+        }
+        // Buffered writes to the same objects have to go out first
+        if (0 < task->getLength()) {
+            writeCombiner->flush(objectGeometry.object(task->getOffset()),
+                                 objectGeometry.object(task->getOffset() + task->getLength() - 1));
+        }
     }
     _executeTask(task);
 }
@@ -106,21 +355,20 @@ BlockOperations::_executeTask(RWTask* task) {
     auto length = task->getLength();
     auto offset = task->getOffset();
     if (length == 0) {
-        LOGERROR("handle:{} length:{} invalid", task->getProtoTask()->getHandle(), length);
+        LOGERROR("handle:{} length:{} invalid", task->getHandle(), length);
         task->getProtoTask()->setError(ApiErrorCode::XDI_BAD_REQUEST);
         finishResponse(task);
         return;
     }
     OffsetInfo blockRange;
-    calculateOffsets(blockRange, offset, length, maxObjectSizeInBytes);
+    calculateOffsets(blockRange, offset, length, objectGeometry);
     auto const& numBlocks = blockRange.numTotalBlocks();
     task->setNumBlocks(numBlocks);
     task->setStartBlockOffset(blockRange.startBlockOffset);
-    xdi_handle reqId{task->getProtoTask()->getHandle(), 0};
+    xdi_handle reqId{task->getHandle(), 0};
     bool reservedRange {false};
 
-    TaskVisitor v;
-    auto taskType = task->match(&v);
+    auto taskType = task->getType();
     std::string taskString;
     switch (taskType) {
     case TaskType::READ:
@@ -143,9 +391,13 @@ BlockOperations::_executeTask(RWTask* task) {
     }
 
     LOGDEBUG("handle:{} op:{} startoffset:{} endoffset:{} blocks:{} absoluteoffset:{} length:{}",
-            task->getProtoTask()->getHandle(), taskString, blockRange.startBlockOffset, blockRange.endBlockOffset,
+            task->getHandle(), taskString, blockRange.startBlockOffset, blockRange.endBlockOffset,
             numBlocks, offset, length);
 
+    if (TaskType::READ == taskType) {
+        readAhead->read(blockRange.startBlockOffset, blockRange.endBlockOffset);
+    }
+
     if (1 <= numBlocks) {
        ReadBlobRequest readReq;
        readReq.path.blobName = *blobName;
@@ -153,30 +405,50 @@ BlockOperations::_executeTask(RWTask* task) {
        readReq.range.startObjectOffset = blockRange.startBlockOffset;
        readReq.range.endObjectOffset = blockRange.endBlockOffset;
        if (TaskType::READ != taskType) {
-           std::unique_lock<std::mutex> l(drainChainMutex);
-
-           auto result = ctx->addReadBlob(blockRange.startBlockOffset, blockRange.endBlockOffset, task, reservedRange);
-           if (WriteContext::ReadBlobResult::PENDING == result) {
-               LOGDEBUG("handle:{} will be restarted", task->getProtoTask()->getHandle());
-               // Task will be restarted
-               return;
-           } else if (WriteContext::ReadBlobResult::UNAVAILABLE == result) {
-               LOGDEBUG("handle:{} offset range unavailable", task->getProtoTask()->getHandle());
-               l.unlock();
-               task->getProtoTask()->setError(ApiErrorCode::XDI_SERVICE_NOT_READY);
-               finishResponse(task);
-               return;
+           stripe_ranges ranges;
+           stripeRanges(blockRange.startBlockOffset, blockRange.endBlockOffset, ranges);
+           StripeLock l(*this, ranges);
+
+           // Every stripe range has to pass the checks before any gets merged
+           for (auto const& r : ranges) {
+               if (true == stripes[r.stripe]->ctx->checkOverlappingAwaitingBlobWrite(r.start, r.end, task)) {
+                   LOGDEBUG("handle:{} will be restarted", task->getHandle());
+                   // Task will be restarted
+                   return;
+               }
+           }
+           for (auto const& r : ranges) {
+               if ((true == reservedRange) && (false == stripes[r.stripe]->ctx->isRangeAvailable(r.start, r.end))) {
+                   LOGDEBUG("handle:{} offset range unavailable", task->getHandle());
+                   l.unlock();
+                   task->getProtoTask()->setError(ApiErrorCode::XDI_SERVICE_NOT_READY);
+                   finishResponse(task);
+                   return;
+               }
+           }
+           for (auto const& r : ranges) {
+               stripes[r.stripe]->ctx->mergeRanges(r.start, r.end, task);
            }
+           static_cast<WriteTask*>(task)->setPendingCommits(ranges.size());
        }
+       // Skip the ReadBlob if the whole range is known
+       ReadBlobResponse cached;
+       if (true == blobMetadata->lookup(blockRange.startBlockOffset, blockRange.endBlockOffset, cached.blob.objects)) {
+           task->setBlobMetadataVersion(0);
+           readBlobResp(reqId, cached, ApiErrorCode::XDI_OK);
+           return;
+       }
+       task->setBlobMetadataVersion(blobMetadata->version());
        Request r{reqId, RequestType::READ_BLOB_TYPE, this};
        api->readBlob(r, readReq);
    }
 }
 
-// NOTE: drainChainMutex should be held when calling this
+// NOTE: the stripe lock for offset should be held when calling this
 std::pair<bool,std::shared_ptr<std::string>>
 BlockOperations::drainUpdateChain
 (
+  WriteContext&                 writeCtx,
 #ifdef DEBUG
   RequestHandle const&          requestId,
 #else
@@ -190,9 +462,9 @@ BlockOperations::drainUpdateChain
     xdi_handle queued_handle;
     BlockTask* queued_task = nullptr;
 
-    std::tie(update_queued, queued_handle) = ctx->pop(offset);
+    std::tie(update_queued, queued_handle) = writeCtx.pop(offset);
 
-    auto buf = ctx->getOffsetObjectBuffer(offset);
+    auto buf = writeCtx.getOffsetObjectBuffer(offset);
     if (nullptr == buf) {
         LOGERROR("offset:{} no buffer found", offset);
         return std::make_pair(haveNewObject, buf);
@@ -201,74 +473,225 @@ BlockOperations::drainUpdateChain
     while (update_queued) {
         queued_task = findResponse(queued_handle.handle);
         if (queued_task) {
-            LOGTRACE("handle:{} queued:{} offset:{} draining", requestId.handle, queued_task->getProtoTask()->getHandle(), offset);
+            LOGTRACE("handle:{} queued:{} offset:{} draining", requestId.handle, queued_task->getHandle(), offset);
             auto writeTask = static_cast<WriteTask*>(queued_task);
-            auto new_data = writeTask->getBuffer(queued_handle.seq);
-            if (nullptr != new_data) {
-                if (maxObjectSizeInBytes > new_data->length()) {
-                    new_data = writeTask->handleRMWResponse(buf,
-                                                            queued_handle.seq,
-                                                            haveNewObject);
+            auto const& new_data = writeTask->getBuffer(queued_handle.seq);
+            if (nullptr != new_data.buffer()) {
+                if (maxObjectSizeInBytes > new_data.size()) {
+                    buf = writeTask->handleRMWResponse(buf,
+                                                       queued_handle.seq,
+                                                       *bufferPool,
+                                                       haveNewObject);
+                } else {
+                    // Full objects are always kept as a buffer of their own
+                    buf = new_data.buffer();
                 }
-                buf = new_data;
                 haveNewObject = true;
             }
         }
 
-        std::tie(update_queued, queued_handle) = ctx->pop(offset);
+        std::tie(update_queued, queued_handle) = writeCtx.pop(offset);
     }
 
     return std::make_pair(haveNewObject, buf);
 }
 
 
+// Move the task from reading the blob to writing in every stripe range.
+// Ranges that already failed while the blob was read are dropped, the
+// remaining ones are the ranges the task should write.
+// NOTE: the stripe locks for ranges should be held when calling this
+bool BlockOperations::addPendingWrite(stripe_ranges& ranges, BlockTask* task) {
+    auto itr = ranges.begin();
+    while (ranges.end() != itr) {
+        auto& writeCtx = *stripes[itr->stripe]->ctx;
+        if ((true == writeCtx.isPendingBlobRead(itr->start, task)) &&
+            (true == writeCtx.addPendingWrite(itr->start, itr->end, task))) {
+            ++itr;
+        } else {
+            LOGDEBUG("handle:{} offset:{} range failed", task->getHandle(), itr->start);
+            itr = ranges.erase(itr);
+        }
+    }
+    return (false == ranges.empty());
+}
+
+// Send out the WriteBlob for the range containing offset if all of it is
+// stable. The stripe lock held by l is released before sending.
+void BlockOperations::sendWriteBlob
+(
+  BlockTask*                    task,
+  xdi_handle const&             requestId,
+  WriteContext&                 writeCtx,
+  uint64_t const                offset,
+  std::unique_lock<std::mutex>& l
+)
+{
+    WriteBlobRequest req;
+    std::queue<BlockTask*> queue;
+    if (true == writeCtx.getWriteBlobRequest(offset, req, queue)) {
+        LOGDEBUG("numobjects:{}", req.blob.objects.size());
+        task->setChain(requestId.seq, std::move(queue));
+        l.unlock();
+        if (true == commitGroup->enabled()) {
+            commitGroup->add(requestId, req);
+            // Nothing anyone waits for is left sitting in the group
+            if ((true == writeBarrier->waiting()) || (true == static_cast<WriteTask*>(task)->isFua())) {
+                commitGroup->flush();
+            }
+            return;
+        }
+        Request r{requestId, RequestType::WRITE_BLOB_TYPE, this};
+        api->writeBlob(r, req);
+    }
+}
+
+// Send the WriteBlob for a group of ranges, its response completes all of
+// them. It goes out with the handle of the first range which keeps the rest.
+void BlockOperations::sendCommitGroup
+(
+  xdi_handle const&         requestId,
+  WriteBlobRequest&         req,
+  std::vector<xdi_handle>&  group
+)
+{
+    LOGDEBUG("handle:{} ranges:{} numobjects:{}", requestId.handle, group.size(), req.blob.objects.size());
+    if (1 < group.size()) {
+        auto task = findResponse(requestId.handle);
+        if (nullptr == task) return;
+        task->setCommitGroup(requestId.seq, std::move(group));
+    }
+    Request r{requestId, RequestType::WRITE_BLOB_TYPE, this};
+    api->writeBlob(r, req);
+}
+
 void BlockOperations::finishResponse
 (
   BlockTask*    response
 )
 {
     // block connector will free resp, just accounting here
-    bool response_removed;
-    {
-        std::unique_lock<std::mutex> l(respLock);
-        response_removed = (1 == responses.erase(response->getProtoTask()->getHandle()));
+    if (responses->remove(response->getHandle(), response)) {
+        auto const taskType = response->getType();
+        // Writes combined into this one are done along with it
+        if (TaskType::WRITE == taskType) {
+            std::vector<WriteTask*> combined;
+            static_cast<WriteTask*>(response)->swapCombined(combined);
+            auto const err = response->getProtoTask()->getError();
+            for (auto t : combined) {
+                if (ApiErrorCode::XDI_OK != err) {
+                    t->getProtoTask()->setError(err);
+                }
+                finishResponse(t);
+            }
+        }
+        std::vector<BlockTask*> passed;
+        if ((TaskType::READ != taskType) && (TaskType::FLUSH != taskType)) {
+            writeBarrier->done(static_cast<WriteTask*>(response)->getEpoch(), passed);
+        }
+        respond(response);
+        // Flushes the write was the last one to hold back
+        for (auto t : passed) {
+            finishResponse(t);
+        }
     }
-    if (response_removed) {
-        respondTask(response);
+}
+
+// Hand the task to the connection it came from, or free it if that is gone
+void BlockOperations::respond(BlockTask* response) {
+    // The owner can't go away while it is responding
+    auto taskOwner = response->getOwner();
+    std::lock_guard<std::mutex> lg(taskOwner->lock);
+    if (nullptr != taskOwner->connection) {
+        // Responding can let the task be reused, the pool has to outlive it
+        auto pool = taskOwner->connection->taskPool;
+        taskOwner->connection->respondTask(response);
+        pool->release(response);
+    } else {
+        // Nobody is left to respond to, the task is ours to free
+        delete response->getProtoTask();
         delete response;
     }
 }
 
+// Writes the combiner held back go out, unless the volume is going away
+// and they are failed instead as nothing would be waiting for the result
+void BlockOperations::flushCombined(WriteTask* task) {
+    if (true == shutting_down) {
+        task->getProtoTask()->setError(ApiErrorCode::XDI_SERVICE_NOT_READY);
+        finishResponse(task);
+        return;
+    }
+    _executeTask(task);
+}
+
+// A flush is responded to once every write executed before it is committed,
+// whatever is buffered goes out right away rather than waiting its turn
+void BlockOperations::flushWrites(BlockTask* task) {
+    bool const waiting = writeBarrier->wait(task);
+    writeCombiner->flush(0, std::numeric_limits<uint64_t>::max());
+    commitGroup->flush();
+    if (false == waiting) {
+        finishResponse(task);
+    }
+}
+
 void BlockOperations::shutdown()
 {
-    std::unique_lock<std::mutex> l(respLock);
-    if (!shutting_down) {
-        shutting_down = true;
-        responses.clear();
+    if (false == shutting_down.exchange(true)) {
         detachVolume();
     }
 }
 
+// The last connection to the volume is gone
+void BlockOperations::stop()
+{
+    if (false == shutting_down.exchange(true)) {
+        writeCombiner->stop();
+        commitGroup->stop();
+        // Outstanding callbacks will no longer find their task, every
+        // connection is gone so nobody else will free it
+        responses->drain([] (task_type* t) {
+            delete t->getProtoTask();
+            delete t;
+        });
+    }
+}
+
 BlockTask* BlockOperations::findResponse
 (
   uint64_t handle
 )
 {
-    std::unique_lock<std::mutex> l(respLock);
     // if we are not waiting for this response, we probably already
     // returned an error
-    auto it = responses.find(handle);
-    if (responses.end() == it) {
+    auto task = responses->find(handle);
+    if (nullptr == task) {
         LOGWARN("handle:{} not waiting for response", handle);
-        return nullptr;
     }
-    return it->second;
+    return task;
 }
 
 void BlockOperations::enqueueOperations(BlockTask* task, read_map const& r, write_map const& w) {
+    auto handle = task->getHandle();
+    // The reads can finish the task, nothing may look at it after them
+    auto const noHole = (TaskType::READ != task->getType()) && (true == static_cast<WriteTask*>(task)->isNoHole());
+    task->setReadObjectIds(r);
     for (auto& o_read : r) {
         auto readSeqId = o_read.first;
-        xdi_handle reqId{task->getProtoTask()->getHandle(), readSeqId};
+        xdi_handle reqId{handle, readSeqId};
+        // Holes read as zeros, there is nothing to fetch
+        if (EMPTY_ID == o_read.second) {
+            ++holeReadsAvoided;
+            readObjectResp(reqId, empty_buffer, ApiErrorCode::XDI_OK);
+            continue;
+        }
+        // ObjectIds are immutable, a cached buffer is the object
+        auto buf = objectCache->get(o_read.second);
+        if (nullptr != buf) {
+            readObjectResp(reqId, buf, ApiErrorCode::XDI_OK);
+            continue;
+        }
         Request r{reqId, RequestType::READ_OBJECT_TYPE, this};
         ReadObjectRequest req;
         req.id = o_read.second;
@@ -276,16 +699,27 @@ void BlockOperations::enqueueOperations(BlockTask* task, read_map const& r, writ
         api->readObject(r, req);
     }
     for (auto& o_write : w) {
-        WriteObjectRequest writeReq;
-        writeReq.buffer = o_write.second;
-        writeReq.volId = volumeId;
-        auto writeSeqId = o_write.first;
-        xdi_handle reqId{task->getProtoTask()->getHandle(), writeSeqId};
-        Request r{reqId, RequestType::WRITE_OBJECT_TYPE, this};
-        api->writeObject(r, writeReq);
+        sendWriteObject(xdi_handle{handle, o_write.first}, o_write.second, noHole);
     }
 }
 
+// An object of all zeros reads the same as a hole, the offset is committed
+// with EMPTY_ID and nothing is written. The empty buffer itself is known
+// to be zeros and needs no scan. A no hole write writes the object anyway.
+// NOTE: no stripe lock may be held when calling this
+void BlockOperations::sendWriteObject(xdi_handle const& requestId, string_ptr const& buffer, bool const noHole) {
+    if ((false == noHole) && ((empty_buffer == buffer) || (true == isZero(buffer->data(), buffer->size())))) {
+        ++zeroObjectsSkipped;
+        writeObjectResp(requestId, EMPTY_ID, ApiErrorCode::XDI_OK);
+        return;
+    }
+    WriteObjectRequest writeReq;
+    writeReq.buffer = buffer;
+    writeReq.volId = volumeId;
+    Request r{requestId, RequestType::WRITE_OBJECT_TYPE, this};
+    api->writeObject(r, writeReq);
+}
+
 void BlockOperations::readBlobResp
 (
   RequestHandle const&           requestId,
@@ -295,15 +729,34 @@ void BlockOperations::readBlobResp
 {
     auto task = findResponse(requestId.handle);
     if (nullptr == task) return;
-    TaskVisitor v;
-    if (TaskType::READ == task->match(&v)) {
+    if (0 != task->getBlobMetadataVersion()) {
+        static BlobMetadataCache::object_map const noObjects;
+        auto start = task->getStartBlockOffset();
+        auto end = start + task->getNumBlocks() - 1;
+        if (ApiErrorCode::XDI_OK == e) {
+            blobMetadata->populate(start, end, resp.blob.objects, task->getBlobMetadataVersion());
+        } else if (ApiErrorCode::XDI_MISSING_BLOB == e) {
+            blobMetadata->populate(start, end, noObjects, task->getBlobMetadataVersion());
+        } else {
+            blobMetadata->invalidate(start, end);
+        }
+    }
+    switch (task->getType()) {
+    case TaskType::READ:
         performRead(requestId, resp, e);
-    } else if (TaskType::WRITE == task->match(&v)) {
+        break;
+    case TaskType::WRITE:
         performWrite(requestId, resp, e);
-    } else if (TaskType::WRITESAME == task->match(&v)) {
+        break;
+    case TaskType::WRITESAME:
         performWriteSame(requestId, resp, e);
-    } else if (TaskType::UNMAPTASK == task->match(&v)) {
+        break;
+    case TaskType::UNMAPTASK:
         performUnmap(requestId, resp, e);
+        break;
+    case TaskType::FLUSH:
+        // Flushes read no blob
+        break;
     }
 }
 
@@ -367,18 +820,18 @@ void BlockOperations::performWrite
     auto task = findResponse(requestId.handle);
     if (nullptr == task) return;
     auto isNewBlob = (ApiErrorCode::XDI_MISSING_BLOB == e);
-    std::shared_ptr<std::string> bytes;
     auto writeTask = static_cast<WriteTask*>(task);
-    writeTask->getWriteBuffer(bytes);
     auto length = writeTask->getLength();
     auto offset = writeTask->getOffset();
     auto startOffset = writeTask->getStartBlockOffset();
     auto endOffset = writeTask->getStartBlockOffset() + writeTask->getNumBlocks() - 1;
     writeTask->setObjectCount(writeTask->getNumBlocks());
 
-    std::unique_lock<std::mutex> l(drainChainMutex);
+    stripe_ranges ranges;
+    stripeRanges(startOffset, endOffset, ranges);
+    StripeLock l(*this, ranges);
     LOGDEBUG("handle:{} numObjects:{} startOffset:{}", requestId.handle, resp.blob.objects.size(), writeTask->getStartBlockOffset());
-    if (false == ctx->addPendingWrite(startOffset, endOffset, task)) {
+    if (false == addPendingWrite(ranges, task)) {
         LOGERROR("unable to add pending write");
         return;
     }
@@ -389,8 +842,8 @@ void BlockOperations::performWrite
     write_map objectsToWrite;
     while (amBytesWritten < length) {
         uint64_t curOffset = offset + amBytesWritten;
-        uint64_t objectOff = curOffset / maxObjectSizeInBytes;
-        uint32_t iOff = curOffset % maxObjectSizeInBytes;
+        uint64_t objectOff = objectGeometry.object(curOffset);
+        uint32_t iOff = objectGeometry.offsetInObject(curOffset);
         size_t iLength = length - amBytesWritten;
 
         if ((iLength + iOff) >= maxObjectSizeInBytes) {
@@ -399,28 +852,37 @@ void BlockOperations::performWrite
 
         LOGTRACE("offset:{} length:{}", curOffset, iLength);
 
-        auto objBuf = (iLength == bytes->length()) ?
-            bytes : std::make_shared<std::string>(*bytes, amBytesWritten, iLength);
+        if (false == inRanges(ranges, objectOff)) {
+            amBytesWritten += iLength;
+            continue;
+        }
+        auto& writeCtx = *stripeFor(objectOff).ctx;
+
+        auto slice = writeTask->getWriteSlice(amBytesWritten, iLength, *bufferPool);
 
         auto partial_write = (iLength != maxObjectSizeInBytes);
         if (true == partial_write) {
-           queuePartialWrite(requestId, resp, writeTask, seqId, objectsToRead, objectsToWrite, objBuf, objectOff, iOff, isNewBlob);
+           // The read-modify-write copies the slice into the object
+           queuePartialWrite(writeCtx, requestId, resp, writeTask, seqId, objectsToRead, objectsToWrite, slice, objectOff, iOff, isNewBlob);
         } else {
-           writeTask->keepBufferForWrite(seqId, objectOff, ZERO_OFFSET, objBuf);
-           xdi_handle reqId{task->getProtoTask()->getHandle(), seqId};
-           auto queueResp = ctx->queue_update(objectOff, reqId);
+           // The object is written from a buffer of its own, only copy the
+           // slice if the connector didn't hand it in as one
+           auto objBuf = (true == slice.whole()) ? slice.buffer() : bufferPool->copy(slice.data(), slice.size());
+           writeTask->keepBufferForWrite(seqId, objectOff, ZERO_OFFSET, BufferView(objBuf));
+           xdi_handle reqId{task->getHandle(), seqId};
+           auto queueResp = writeCtx.queue_update(objectOff, reqId);
            if (WriteContext::QueueResult::FirstEntry == queueResp) {
-              ctx->setOffsetObjectBuffer(objectOff, objBuf);
-              ctx->triggerWrite(objectOff);
+              writeCtx.setOffsetObjectBuffer(objectOff, objBuf);
+              writeCtx.triggerWrite(objectOff);
               objectsToWrite.emplace(seqId, objBuf);
            } else if (WriteContext::QueueResult::UpdateStable == queueResp) {
                bool haveNewObject {false};
                std::shared_ptr<std::string> newBuf;
-               std::tie(haveNewObject, newBuf) = drainUpdateChain(requestId, objectOff);
+               std::tie(haveNewObject, newBuf) = drainUpdateChain(writeCtx, requestId, objectOff);
 
                if (true == haveNewObject) {
-                   ctx->setOffsetObjectBuffer(objectOff, newBuf);
-                   ctx->triggerWrite(objectOff);
+                   writeCtx.setOffsetObjectBuffer(objectOff, newBuf);
+                   writeCtx.triggerWrite(objectOff);
                    objectsToWrite.emplace(seqId, newBuf);
                }
            }
@@ -453,17 +915,20 @@ void BlockOperations::performWriteSame
     auto length = writeTask->getLength();
     auto offset = writeTask->getOffset();
     auto isNewBlob = (ApiErrorCode::XDI_MISSING_BLOB == e);
-    writeTask->setObjectCount(writeTask->getNumBlocks());
+    // At most the repeated full object and the two partial ends
+    writeTask->setObjectCount(3);
 
     OffsetInfo newOffset;
-    calculateOffsets(newOffset, offset, length, maxObjectSizeInBytes);
+    calculateOffsets(newOffset, offset, length, objectGeometry);
     //TODO (andreas): fix output operator for OffsetInfo to logger
     //    also in performUnmap
     //LOGTRACE("{}", newOffset);
 
-    std::unique_lock<std::mutex> l(drainChainMutex);
+    stripe_ranges ranges;
+    stripeRanges(newOffset.startBlockOffset, newOffset.endBlockOffset, ranges);
+    StripeLock l(*this, ranges);
     LOGDEBUG("handle:{} numObjects:{} startOffset:{}", requestId.handle, resp.blob.objects.size(), newOffset.startBlockOffset);
-    if (false == ctx->addPendingWrite(newOffset.startBlockOffset, newOffset.endBlockOffset, task)) {
+    if (false == addPendingWrite(ranges, task)) {
         LOGERROR("unable to add pending write");
         return;
     }
@@ -473,9 +938,6 @@ void BlockOperations::performWriteSame
 
     auto bufsize = bytes->size();
 
-    // Override the number of objects will full objects being written.
-    writeTask->setNumBlocks(newOffset.numFullBlocks);
-
     read_map objectsToRead;
     write_map objectsToWrite;
 
@@ -483,50 +945,36 @@ void BlockOperations::performWriteSame
     // Determine if we need to write a full object
     if (0 < newOffset.numFullBlocks) {
         LOGTRACE("fullobjects:{} blockoffset:{}", newOffset.numFullBlocks, newOffset.fullStartBlockOffset);
-        auto writeBuf = std::make_shared<std::string>();
-        for (unsigned int i = 0; i < maxObjectSizeInBytes / bufsize; ++i) {
-            *writeBuf += *bytes;
-        }
-        writeTask->keepBufferForWrite(seqId, newOffset.fullStartBlockOffset, ZERO_OFFSET, writeBuf);
-        writeTask->setRepeatingBlock(seqId);
-        xdi_handle reqId{task->getProtoTask()->getHandle(), seqId};
-        for (unsigned int o = 0; o < newOffset.numFullBlocks; ++o) {
-            auto currentOffset = newOffset.fullStartBlockOffset + o;
-            auto queueResp = ctx->queue_update(currentOffset, reqId);
-            if (WriteContext::QueueResult::FirstEntry == queueResp) {
-                ctx->setOffsetObjectBuffer(currentOffset, writeBuf);
-                ctx->triggerWrite(currentOffset);
-            } else {
-                LOGERROR("handle:{} requires exclusive access to range", requestId.handle);
-                return;
-            }
+        // Full objects of zeros are committed as holes without any data,
+        // unless the write asked for no holes
+        auto writeBuf = ((false == writeTask->isNoHole()) && (true == isZero(bytes->data(), bytes->size()))) ?
+                        empty_buffer : patternObject(*bytes);
+        std::map<uint64_t, uint64_t> fullObjects;
+        fullObjects.emplace(newOffset.fullStartBlockOffset, newOffset.fullStartBlockOffset + newOffset.numFullBlocks - 1);
+        if (false == queueRepeatingBlock(requestId, writeTask, seqId, fullObjects, ranges, writeBuf, objectsToWrite)) {
+            return;
         }
-        objectsToWrite.emplace(seqId, writeBuf);
-        seqId++;
     }
     // Determine if we need a RMW for the first block
-    if (0 < newOffset.startDiffOffset) {
+    if ((0 < newOffset.startDiffOffset) && (true == inRanges(ranges, newOffset.startBlockOffset))) {
         auto const& startBlockOffset = newOffset.startBlockOffset;
         LOGDEBUG("offset:{}", startBlockOffset);
-        auto writeBuf = std::make_shared<std::string>();
         auto writeLength = (maxObjectSizeInBytes - newOffset.startDiffOffset);
         if (true == newOffset.isSingleObject()) {
             writeLength -= newOffset.endDiffOffset;
         }
-        for (unsigned int i = 0; i <  writeLength / bufsize; ++i) {
-            *writeBuf += *bytes;
-        }
-        queuePartialWrite(requestId, resp, writeTask, seqId, objectsToRead, objectsToWrite, writeBuf, startBlockOffset, newOffset.startDiffOffset, isNewBlob);
+        auto writeBuf = bufferPool->get((writeLength / bufsize) * bufsize);
+        fillPattern(&(*writeBuf)[0], writeBuf->size(), bytes->data(), bufsize);
+        queuePartialWrite(*stripeFor(startBlockOffset).ctx, requestId, resp, writeTask, seqId, objectsToRead, objectsToWrite, BufferView(writeBuf), startBlockOffset, newOffset.startDiffOffset, isNewBlob);
     }
     // Determine if we need a RMW for the last block
-    if (((false == newOffset.isSingleObject()) || (0 == newOffset.startDiffOffset)) && (0 < newOffset.endDiffOffset)) {
+    if (((false == newOffset.isSingleObject()) || (0 == newOffset.startDiffOffset)) && (0 < newOffset.endDiffOffset) &&
+        (true == inRanges(ranges, newOffset.endBlockOffset))) {
         auto const& endBlockOffset = newOffset.endBlockOffset;
         LOGDEBUG("offset:{}", endBlockOffset);
-        auto writeBuf = std::make_shared<std::string>();
-        for (unsigned int i = 0; i < (maxObjectSizeInBytes - newOffset.endDiffOffset) / bufsize; ++i) {
-            *writeBuf += *bytes;
-        }
-        queuePartialWrite(requestId, resp, writeTask, seqId, objectsToRead, objectsToWrite, writeBuf, endBlockOffset, ZERO_OFFSET, isNewBlob);
+        auto writeBuf = bufferPool->get(((maxObjectSizeInBytes - newOffset.endDiffOffset) / bufsize) * bufsize);
+        fillPattern(&(*writeBuf)[0], writeBuf->size(), bytes->data(), bufsize);
+        queuePartialWrite(*stripeFor(endBlockOffset).ctx, requestId, resp, writeTask, seqId, objectsToRead, objectsToWrite, BufferView(writeBuf), endBlockOffset, ZERO_OFFSET, isNewBlob);
     }
     l.unlock();
     enqueueOperations(task, objectsToRead, objectsToWrite);
@@ -545,14 +993,16 @@ void BlockOperations::performUnmap
     auto unmapTask = static_cast<UnmapTask*>(task);
     uint32_t context = 0;
     uint64_t offset;
-    uint32_t length;
+    uint64_t length;
     auto totalStartBlockOffset = unmapTask->getStartBlockOffset();
     auto totalEndBlockOffset = unmapTask->getStartBlockOffset() + unmapTask->getNumBlocks() - 1;
     auto isNewBlob = (ApiErrorCode::XDI_MISSING_BLOB == e);
 
-    std::unique_lock<std::mutex> l(drainChainMutex);
+    stripe_ranges ranges;
+    stripeRanges(totalStartBlockOffset, totalEndBlockOffset, ranges);
+    StripeLock l(*this, ranges);
     LOGDEBUG("handle:{} numObjects:{} startOffset:{}", requestId.handle, resp.blob.objects.size(), totalStartBlockOffset);
-    if (false == ctx->addPendingWrite(totalStartBlockOffset, totalEndBlockOffset, task)) {
+    if (false == addPendingWrite(ranges, task)) {
         LOGERROR("unable to add pending write");
         return;
     }
@@ -563,66 +1013,129 @@ void BlockOperations::performUnmap
     uint32_t seqId = 0;
     while (true == unmapTask->getNextRange(context, offset, length)) {
         OffsetInfo newOffset;
-        calculateOffsets(newOffset, offset, length, maxObjectSizeInBytes);
+        calculateOffsets(newOffset, offset, length, objectGeometry);
         //LOGTRACE("{}", newOffset);
+        auto const& startBlockOffset = newOffset.startBlockOffset;
+        auto const& endBlockOffset = newOffset.endBlockOffset;
         if ((true == newOffset.isSingleObject()) && (length < maxObjectSizeInBytes)) {
-            auto writeBuf = std::make_shared<std::string>(length, '\0');
-            queuePartialWrite(requestId, resp, unmapTask, seqId, objectsToRead, objectsToWrite, writeBuf, newOffset.startBlockOffset, newOffset.startDiffOffset, isNewBlob);
+            if (true == inRanges(ranges, startBlockOffset)) {
+                auto writeBuf = bufferPool->zeroed(length);
+                queuePartialWrite(*stripeFor(startBlockOffset).ctx, requestId, resp, unmapTask, seqId, objectsToRead, objectsToWrite, BufferView(writeBuf), startBlockOffset, newOffset.startDiffOffset, isNewBlob);
+            }
         } else {
             if (true == newOffset.spansFullBlocks) {
-                for (auto i = newOffset.fullStartBlockOffset; i <= newOffset.fullEndBlockOffset; ++i) {
-                    fullObjects.emplace(i);
-                }
+                UnmapTask::addFullBlockRange(fullObjects, newOffset.fullStartBlockOffset, newOffset.fullEndBlockOffset);
             }
-            if (0 < newOffset.startDiffOffset) {
-                auto writeBuf = std::make_shared<std::string>(maxObjectSizeInBytes - newOffset.startDiffOffset, '\0');
-                queuePartialWrite(requestId, resp, unmapTask, seqId, objectsToRead, objectsToWrite, writeBuf, newOffset.startBlockOffset, newOffset.startDiffOffset, isNewBlob);
+            if ((0 < newOffset.startDiffOffset) && (true == inRanges(ranges, startBlockOffset))) {
+                auto writeBuf = bufferPool->zeroed(maxObjectSizeInBytes - newOffset.startDiffOffset);
+                queuePartialWrite(*stripeFor(startBlockOffset).ctx, requestId, resp, unmapTask, seqId, objectsToRead, objectsToWrite, BufferView(writeBuf), startBlockOffset, newOffset.startDiffOffset, isNewBlob);
             }
-            if (0 < newOffset.endDiffOffset) {
-                auto writeBuf = std::make_shared<std::string>(maxObjectSizeInBytes - newOffset.endDiffOffset, '\0');
-                queuePartialWrite(requestId, resp, unmapTask, seqId, objectsToRead, objectsToWrite, writeBuf, newOffset.endBlockOffset, ZERO_OFFSET, isNewBlob);
+            if ((0 < newOffset.endDiffOffset) && (true == inRanges(ranges, endBlockOffset))) {
+                auto writeBuf = bufferPool->zeroed(maxObjectSizeInBytes - newOffset.endDiffOffset);
+                queuePartialWrite(*stripeFor(endBlockOffset).ctx, requestId, resp, unmapTask, seqId, objectsToRead, objectsToWrite, BufferView(writeBuf), endBlockOffset, ZERO_OFFSET, isNewBlob);
             }
         }
     }
     if (0 < fullObjects.size()) {
-        auto writeBuf = std::make_shared<std::string>(maxObjectSizeInBytes, '\0');
-        unmapTask->keepBufferForWrite(seqId, *(fullObjects.begin()), ZERO_OFFSET, writeBuf);
-        unmapTask->setRepeatingBlock(seqId);
-        xdi_handle reqId{task->getProtoTask()->getHandle(), seqId};
-        for (auto const& o : fullObjects) {
-            auto queueResp = ctx->queue_update(o, reqId);
-            if (WriteContext::QueueResult::FirstEntry != queueResp) {
-               LOGERROR("handle:{} requires exclusive access to range", requestId.handle);
-               return;
-            }
-            ctx->setOffsetObjectBuffer(o, writeBuf);
-            ctx->triggerWrite(o);
+        // Unmapped full objects become holes, only the partial ends are written
+        if (false == queueRepeatingBlock(requestId, unmapTask, seqId, fullObjects, ranges, empty_buffer, objectsToWrite)) {
+            return;
         }
-        unmapTask->swapFullBlockOffsets(fullObjects);
-        objectsToWrite.emplace(seqId, writeBuf);
     }
     l.unlock();
     enqueueOperations(task, objectsToRead, objectsToWrite);
 }
 
+// The full object of a WRITE SAME pattern, built once for the recently used
+// patterns. Like any object buffer written it must not be modified.
+std::shared_ptr<std::string> BlockOperations::patternObject(std::string const& pattern) {
+    std::lock_guard<std::mutex> lg(patternLock);
+    auto itr = std::find_if(patternObjects.begin(), patternObjects.end(),
+                            [&pattern] (pattern_object const& p) { return p.first == pattern; });
+    if (patternObjects.end() != itr) {
+        ++patternHits;
+        auto object = itr->second;
+        if (patternObjects.begin() != itr) {
+            patternObjects.erase(itr);
+            patternObjects.emplace_front(pattern, object);
+        }
+        return object;
+    }
+    auto object = bufferPool->get((maxObjectSizeInBytes / pattern.size()) * pattern.size());
+    fillPattern(&(*object)[0], object->size(), pattern.data(), pattern.size());
+    patternObjects.emplace_front(pattern, object);
+    if (PATTERN_OBJECTS < patternObjects.size()) {
+        patternObjects.pop_back();
+    }
+    return object;
+}
+
+// Queue the repeating block for the full objects inside the stripe ranges.
+// There is a run per stripe range and contiguous set of full objects, the
+// first run sends the ObjectWrite and every run gets a seqId to update its
+// offsets with. The WriteBlob of a stripe goes out once its last run is in.
+// NOTE: the stripe locks for ranges should be held when calling this
+bool BlockOperations::queueRepeatingBlock
+(
+  RequestHandle const& requestId,
+  WriteTask* task,
+  uint32_t& seqId,
+  std::map<uint64_t, uint64_t> const& fullObjects,
+  stripe_ranges const& ranges,
+  std::shared_ptr<std::string>& buf,
+  write_map& wmap
+)
+{
+    auto const writeSeqId = seqId;
+    xdi_handle reqId{task->getHandle(), writeSeqId};
+    StripeRange run;
+    for (auto const& r : ranges) {
+        auto itr = fullObjects.upper_bound(r.start);
+        if (fullObjects.begin() != itr) --itr;
+        for (; (fullObjects.end() != itr) && (itr->first <= r.end); ++itr) {
+            if ((itr->second < r.start) || (false == stripeRange(r.stripe, std::max(itr->first, r.start), std::min(itr->second, r.end), run))) {
+                continue;
+            }
+            auto const start = run.start;
+            auto const end = run.end;
+            auto& writeCtx = *stripes[r.stripe]->ctx;
+            if (WriteContext::QueueResult::FirstEntry != writeCtx.queue_update(start, end, reqId)) {
+                LOGERROR("handle:{} requires exclusive access to range", requestId.handle);
+                return false;
+            }
+            writeCtx.setOffsetObjectBuffer(start, end, buf);
+            writeCtx.triggerWrite(start, end);
+            task->keepBufferForWrite(seqId, start, ZERO_OFFSET, BufferView(buf));
+            task->addFullBlockRun(start, end, seqId);
+            ++seqId;
+        }
+    }
+    if (writeSeqId != seqId) {
+        task->setRepeatingBlock(writeSeqId);
+        wmap.emplace(writeSeqId, buf);
+    }
+    return true;
+}
+
 void BlockOperations::queuePartialWrite
 (
+  WriteContext& writeCtx,
   RequestHandle const& requestId,
   ReadBlobResponse const& resp,
   WriteTask* task,
   uint32_t& seqId,
   read_map& rmap,
   write_map& wmap,
-  std::shared_ptr<std::string>& buf,
-  uint32_t const& blockOffset,
+  BufferView const& buf,
+  uint64_t const& blockOffset,
   uint32_t const& writeOffset,
   bool const isNewBlob
 )
 {
     task->keepBufferForWrite(seqId, blockOffset, writeOffset, buf);
     auto o_itr = resp.blob.objects.find(blockOffset);
-    xdi_handle reqId{task->getProtoTask()->getHandle(), seqId};
-    auto queueResp = ctx->queue_update(blockOffset, reqId);
+    xdi_handle reqId{task->getHandle(), seqId};
+    auto queueResp = writeCtx.queue_update(blockOffset, reqId);
     if (WriteContext::QueueResult::FirstEntry == queueResp) {
         if ((resp.blob.objects.end() == o_itr) || (true == isNewBlob)) {
             rmap.emplace(seqId, EMPTY_ID);
@@ -632,12 +1145,12 @@ void BlockOperations::queuePartialWrite
     } else if (WriteContext::QueueResult::UpdateStable == queueResp) {
         bool haveNewObject {false};
         std::shared_ptr<std::string> newBuf;
-        std::tie(haveNewObject, newBuf) = drainUpdateChain(requestId, blockOffset);
+        std::tie(haveNewObject, newBuf) = drainUpdateChain(writeCtx, requestId, blockOffset);
 
         if (true == haveNewObject) {
             wmap.emplace(seqId, newBuf);
-            ctx->setOffsetObjectBuffer(blockOffset, newBuf);
-            ctx->triggerWrite(blockOffset);
+            writeCtx.setOffsetObjectBuffer(blockOffset, newBuf);
+            writeCtx.triggerWrite(blockOffset);
         }
     }
     ++seqId;
@@ -649,6 +1162,24 @@ void BlockOperations::writeBlobResp
   WriteBlobResponse const&,
   ApiErrorCode const&            e
 )
+{
+    auto task = findResponse(requestId.handle);
+    if (nullptr == task) return;
+    std::vector<xdi_handle> group;
+    task->getCommitGroup(requestId.seq, group);
+    if (true == group.empty()) {
+        completeWriteBlob(requestId, e);
+    }
+    for (auto const& g : group) {
+        completeWriteBlob(g, e);
+    }
+}
+
+void BlockOperations::completeWriteBlob
+(
+  RequestHandle const&           requestId,
+  ApiErrorCode const&            e
+)
 {
     auto task = findResponse(requestId.handle);
     if (nullptr == task) return;
@@ -656,13 +1187,23 @@ void BlockOperations::writeBlobResp
     auto offset = writeTask->getOffset(requestId.seq);
     std::queue<BlockTask*> responseQueue;
     std::queue<BlockTask*> awaitingQueue;
-    task->getChain(responseQueue);
+    task->getChain(requestId.seq, responseQueue);
     LOGTRACE("handle:{} queuesize:{}", requestId.handle, responseQueue.size());
-    respondToWrites(responseQueue, e);
     {
-        std::lock_guard<std::mutex> lg(drainChainMutex);
-        ctx->completeBlobWrite(offset, awaitingQueue);
+        // The blob metadata has to be current before anyone is responded to
+        WriteContext::ObjectExtents committed;
+        auto& stripe = stripeFor(offset);
+        std::lock_guard<std::mutex> lg(stripe.lock);
+        stripe.ctx->completeBlobWrite(offset, awaitingQueue, committed);
+        for (auto const& c : committed) {
+            if (ApiErrorCode::XDI_OK == e) {
+                blobMetadata->assign(c.start, c.start + c.numObjects - 1, c.id);
+            } else {
+                blobMetadata->invalidate(c.start, c.start + c.numObjects - 1);
+            }
+        }
     }
+    respondToWrites(responseQueue, e);
     if (ApiErrorCode::XDI_OK != e) {
         respondToWrites(awaitingQueue, e);
     } else {
@@ -684,34 +1225,34 @@ void BlockOperations::readObjectResp
 {
     auto task = findResponse(requestId.handle);
     if (nullptr == task) return;
-    TaskVisitor v;
-    if ((TaskType::WRITE == task->match(&v)) ||
-        (TaskType::WRITESAME == task->match(&v)) ||
-        (TaskType::UNMAPTASK == task->match(&v)))  {
+    if ((ApiErrorCode::XDI_OK == e) && (EMPTY_ID != task->getReadObjectId(requestId.seq))) {
+        objectCache->insert(task->getReadObjectId(requestId.seq), resp);
+    }
+    if (TaskType::READ != task->getType()) {
         auto writeTask = static_cast<WriteTask*>(task);
         auto offset = writeTask->getOffset(requestId.seq);
-        auto new_data = writeTask->handleRMWResponse(resp, requestId.seq);
+        auto new_data = writeTask->handleRMWResponse(resp, requestId.seq, *bufferPool);
         bool haveNewObject {false};
         std::shared_ptr<std::string> newBuf;
-        WriteObjectRequest writeReq;
-        writeReq.volId = volumeId;
+        std::shared_ptr<std::string> writeBuf;
         {
-            std::lock_guard<std::mutex> l(drainChainMutex);
-            ctx->setOffsetObjectBuffer(offset, new_data);
-            std::tie(haveNewObject, newBuf) = drainUpdateChain(requestId, offset);
+            auto& stripe = stripeFor(offset);
+            std::lock_guard<std::mutex> l(stripe.lock);
+            auto& writeCtx = *stripe.ctx;
+            writeCtx.setOffsetObjectBuffer(offset, new_data);
+            std::tie(haveNewObject, newBuf) = drainUpdateChain(writeCtx, requestId, offset);
 
             if (true == haveNewObject) {
-                writeReq.buffer = newBuf;
-                ctx->setOffsetObjectBuffer(offset, newBuf);
+                writeBuf = newBuf;
+                writeCtx.setOffsetObjectBuffer(offset, newBuf);
             } else {
-                writeReq.buffer = new_data;
+                writeBuf = new_data;
             }
-            ctx->triggerWrite(offset);
+            writeCtx.triggerWrite(offset);
         }
-        Request r{requestId, RequestType::WRITE_OBJECT_TYPE, this};
-        api->writeObject(r, writeReq);
+        sendWriteObject(requestId, writeBuf, writeTask->isNoHole());
         return;
-    } else if (TaskType::READ == task->match(&v)) {
+    } else {
         std::unique_lock<std::mutex> l(readObjectsLock);
         auto readTask = static_cast<ReadTask*>(task);
         auto itr = readObjects.find(requestId.handle);
@@ -746,57 +1287,78 @@ void BlockOperations::writeObjectResp
     if (nullptr == task) return;
     auto writeTask = static_cast<WriteTask*>(task);
     auto offset = writeTask->getOffset(requestId.seq);
-    std::unique_lock<std::mutex> l(drainChainMutex);
-    TaskVisitor v;
+
+    // The repeating block covers a run of objects in every stripe range
+    WriteTask::full_block_runs runs;
+    if (true == writeTask->checkRepeatingBlock(requestId.seq)) {
+        writeTask->swapFullBlockRuns(runs);
+    }
+
     if (ApiErrorCode::XDI_OK != e) {
         std::queue<BlockTask*> queue;
-        ctx->failWriteBlobRequest(offset, queue);
-        l.unlock();
-        respondToWrites(queue, e);
-    } else {
-        if ((TaskType::WRITESAME == task->match(&v)) && (true == writeTask->checkRepeatingBlock(requestId.seq))) {
-            for (unsigned int i = 0; i < writeTask->getNumBlocks(); ++i) {
-                ctx->updateOffset(offset + i, resp);
+        auto failRange = [this, &queue] (uint64_t const o) {
+            std::queue<BlockTask*> failed;
+            {
+                auto& stripe = stripeFor(o);
+                std::lock_guard<std::mutex> lg(stripe.lock);
+                stripe.ctx->failWriteBlobRequest(o, failed);
             }
-        } else if ((TaskType::UNMAPTASK == task->match(&v)) && (true == writeTask->checkRepeatingBlock(requestId.seq))) {
-            UnmapTask::block_offset_list fullObjects;
-            auto unmapTask = static_cast<UnmapTask*>(task);
-            unmapTask->swapFullBlockOffsets(fullObjects);
-            for (auto const& o : fullObjects) {
-                ctx->updateOffset(o, resp);
+            while (false == failed.empty()) {
+                queue.push(failed.front());
+                failed.pop();
             }
-        } else {
-            ctx->updateOffset(offset, resp);
+        };
+        if (true == runs.empty()) {
+            failRange(offset);
+        }
+        for (auto const& r : runs) {
+            failRange(r.start);
         }
-        LOGDEBUG("handle:{} objectId:{} offset:{}", requestId.handle, resp, offset);
+        respondToWrites(queue, e);
+        return;
+    }
 
-        // Unblock other updates on the same object if they exist
-        bool haveNewObject {false};
-        std::shared_ptr<std::string> newBuf;
-        std::tie(haveNewObject, newBuf) = drainUpdateChain(requestId, offset);
+    // Every run but the first is only updated and committed here, the
+    // first run is at offset and handled below.
+    for (size_t i = 1; i < runs.size(); ++i) {
+        auto& stripe = stripeFor(runs[i].start);
+        std::unique_lock<std::mutex> l(stripe.lock);
+        stripe.ctx->updateOffset(runs[i].start, runs[i].end, resp);
+        sendWriteBlob(task, xdi_handle{requestId.handle, runs[i].seqId}, *stripe.ctx, runs[i].start, l);
+    }
 
-        if (true == haveNewObject) {
-            WriteObjectRequest writeReq;
-            writeReq.volId = volumeId;
-            writeReq.buffer = newBuf;
-            ctx->setOffsetObjectBuffer(offset, newBuf);
-            ctx->triggerWrite(offset);
-            l.unlock();
-            Request r{requestId, RequestType::WRITE_OBJECT_TYPE, this};
-            api->writeObject(r, writeReq);
-            return;
-        } else {
-            WriteBlobRequest req;
-            std::queue<BlockTask*> queue;
-            if (true == ctx->getWriteBlobRequest(offset, req, queue)) {
-                LOGDEBUG("numobjects:{}", req.blob.objects.size());
-                task->setChain(std::move(queue));
-                l.unlock();
-                Request r{requestId, RequestType::WRITE_BLOB_TYPE, this};
-                api->writeBlob(r, req);
-            }
+    auto& stripe = stripeFor(offset);
+    std::unique_lock<std::mutex> l(stripe.lock);
+    auto& writeCtx = *stripe.ctx;
+    // The buffer just written is what a later read of resp returns, holes
+    // are never read. Without a pending write at offset there is nothing
+    // that could be cached.
+    if (EMPTY_ID != resp) {
+        auto buf = writeCtx.getOffsetObjectBuffer(offset);
+        if ((nullptr != buf) && (false == buf->empty())) {
+            objectCache->insert(resp, buf);
         }
     }
+    if (false == runs.empty()) {
+        writeCtx.updateOffset(runs.front().start, runs.front().end, resp);
+    } else {
+        writeCtx.updateOffset(offset, resp);
+    }
+    LOGDEBUG("handle:{} objectId:{} offset:{}", requestId.handle, resp, offset);
+
+    // Unblock other updates on the same object if they exist
+    bool haveNewObject {false};
+    std::shared_ptr<std::string> newBuf;
+    std::tie(haveNewObject, newBuf) = drainUpdateChain(writeCtx, requestId, offset);
+
+    if (true == haveNewObject) {
+        writeCtx.setOffsetObjectBuffer(offset, newBuf);
+        writeCtx.triggerWrite(offset);
+        l.unlock();
+        sendWriteObject(requestId, newBuf, writeTask->isNoHole());
+    } else {
+        sendWriteBlob(task, requestId, writeCtx, offset, l);
+    }
 }
 
 void BlockOperations::respondToWrites
@@ -808,8 +1370,14 @@ void BlockOperations::respondToWrites
     while (false == q.empty()) {
         auto t = q.front();
         q.pop();
-        LOGTRACE("handle:{} responding", t->getProtoTask()->getHandle());
-        t->getProtoTask()->setError(e);
+        if (ApiErrorCode::XDI_OK != e) {
+            t->getProtoTask()->setError(e);
+        }
+        // A task spanning stripes waits for the WriteBlob of each of them
+        if (false == static_cast<WriteTask*>(t)->commitDone()) {
+            continue;
+        }
+        LOGTRACE("handle:{} responding", t->getHandle());
         finishResponse(t);
     }
 }
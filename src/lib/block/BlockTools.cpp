@@ -19,6 +19,11 @@
 
 #include "connector/block/BlockTools.h"
 #include <assert.h>
+#include <algorithm>
+#include <cstring>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
 
 namespace fds {
 namespace block {
@@ -34,24 +39,37 @@ std::ostream& operator<< (std::ostream &os, const OffsetInfo &oi) {
     return os;
 }
 
-void calculateOffsets
-(
-  OffsetInfo&      info,
-  uint64_t const&  offset,
-  uint32_t const&  length,
-  uint32_t const&  maxObjectSizeInBytes
-)
+namespace {
+
+// Object arithmetic for calculateOffsets, one by division and one for
+// power of two sizes by shift and mask
+struct DivideObjects {
+    uint32_t const size;
+    uint64_t object(uint64_t const offset) const    { return offset / size; }
+    uint64_t start(uint64_t const object) const     { return object * size; }
+    uint64_t count(uint64_t const length) const     { return length / size; }
+};
+
+struct ShiftObjects {
+    uint32_t const size;
+    uint32_t const shift;
+    uint64_t object(uint64_t const offset) const    { return offset >> shift; }
+    uint64_t start(uint64_t const object) const     { return object << shift; }
+    uint64_t count(uint64_t const length) const     { return length >> shift; }
+};
+
+template<typename O>
+void offsetsOf(OffsetInfo& info, uint64_t const offset, uint64_t const length, O const& objects)
 {
-    assert(length != 0);
-    if (maxObjectSizeInBytes == 0) return;
+    auto const maxObjectSizeInBytes = objects.size;
     auto absoluteEndOffset = offset + length - 1;
-    info.startBlockOffset = offset / maxObjectSizeInBytes;
-    info.endBlockOffset = absoluteEndOffset / maxObjectSizeInBytes;
+    info.startBlockOffset = objects.object(offset);
+    info.endBlockOffset = objects.object(absoluteEndOffset);
     auto remaining = length;
     // Calculate the absolute offsets of start and end of the entire range of blocks
     // Used to determine block alignment
-    auto absoluteBlockStartOffset = (uint64_t)info.startBlockOffset * maxObjectSizeInBytes;
-    auto absoluteBlockEndOffset = ((uint64_t)(info.endBlockOffset + 1) * maxObjectSizeInBytes) - 1;
+    auto absoluteBlockStartOffset = objects.start(info.startBlockOffset);
+    auto absoluteBlockEndOffset = objects.start((uint64_t)info.endBlockOffset + 1) - 1;
     // Determine if we're starting aligned and if not by how much
     auto startDiff = offset - absoluteBlockStartOffset;
     // Determine if we're ending aligned and if not by how much
@@ -65,12 +83,12 @@ void calculateOffsets
         remaining -= (0 != endDiff) ? (maxObjectSizeInBytes - endDiff) : 0;
 
         // Determine if this range spans any full blocks
-        auto numFullObjects = remaining / maxObjectSizeInBytes;
+        auto numFullObjects = objects.count(remaining);
         if (0 < numFullObjects) {
             info.spansFullBlocks = true;
             info.numFullBlocks = numFullObjects;
             info.startDiffOffset = startDiff;
-            info.fullStartBlockOffset = (offset + ((0 != startDiff) ? (maxObjectSizeInBytes - startDiff) : 0)) / maxObjectSizeInBytes;
+            info.fullStartBlockOffset = objects.object(offset + ((0 != startDiff) ? (maxObjectSizeInBytes - startDiff) : 0));
             info.fullEndBlockOffset = info.fullStartBlockOffset + numFullObjects - 1;
             info.endDiffOffset = endDiff;
         } else {
@@ -80,5 +98,131 @@ void calculateOffsets
     }
 }
 
+}  // namespace
+
+ObjectGeometry::ObjectGeometry(uint32_t const objectSize)
+        : size(objectSize)
+{
+    if ((0 != size) && (0 == (size & (size - 1)))) {
+        pow2 = true;
+        shift = __builtin_ctz(size);
+        mask = size - 1;
+    }
+}
+
+void calculateOffsets
+(
+  OffsetInfo&      info,
+  uint64_t const&  offset,
+  uint64_t const&  length,
+  uint32_t const&  maxObjectSizeInBytes
+)
+{
+    assert(length != 0);
+    if (maxObjectSizeInBytes == 0) return;
+    offsetsOf(info, offset, length, DivideObjects{maxObjectSizeInBytes});
+}
+
+void calculateOffsets
+(
+  OffsetInfo&             info,
+  uint64_t const&         offset,
+  uint64_t const&         length,
+  ObjectGeometry const&   geometry
+)
+{
+    assert(length != 0);
+    if (geometry.size == 0) return;
+    if (true == geometry.pow2) {
+        offsetsOf(info, offset, length, ShiftObjects{geometry.size, geometry.shift});
+    } else {
+        offsetsOf(info, offset, length, DivideObjects{geometry.size});
+    }
+}
+
+void fillPattern
+(
+  char*            dst,
+  size_t const     length,
+  char const*      pattern,
+  size_t const     patternLength
+)
+{
+    if ((0 == length) || (0 == patternLength)) return;
+    // Copy the pattern once, then keep doubling what is filled already
+    auto filled = std::min(length, patternLength);
+    memcpy(dst, pattern, filled);
+    while (filled < length) {
+        auto n = std::min(filled, length - filled);
+        memcpy(dst + filled, dst, n);
+        filled += n;
+    }
+}
+
+namespace {
+
+using zero_fn = bool (*)(char const*, size_t const);
+
+bool isZeroScalar(char const* data, size_t const length) {
+    size_t i = 0;
+    uint64_t acc = 0;
+    for (; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        acc |= word;
+        // Bail out early on data, checking every word costs too much
+        if ((0 == (i & 0xff)) && (0 != acc)) return false;
+    }
+    for (; i < length; ++i) {
+        acc |= static_cast<unsigned char>(data[i]);
+    }
+    return (0 == acc);
+}
+
+#if defined(__x86_64__)
+// SSE2 is part of every x86_64 cpu
+bool isZeroSse2(char const* data, size_t const length) {
+    size_t i = 0;
+    for (; i + 64 <= length; i += 64) {
+        auto p = reinterpret_cast<__m128i const*>(data + i);
+        auto v = _mm_or_si128(_mm_or_si128(_mm_loadu_si128(p), _mm_loadu_si128(p + 1)),
+                              _mm_or_si128(_mm_loadu_si128(p + 2), _mm_loadu_si128(p + 3)));
+        if (0xffff != _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128()))) return false;
+    }
+    return isZeroScalar(data + i, length - i);
+}
+
+__attribute__((target("avx2")))
+bool isZeroAvx2(char const* data, size_t const length) {
+    size_t i = 0;
+    for (; i + 128 <= length; i += 128) {
+        auto p = reinterpret_cast<__m256i const*>(data + i);
+        auto v = _mm256_or_si256(_mm256_or_si256(_mm256_loadu_si256(p), _mm256_loadu_si256(p + 1)),
+                                 _mm256_or_si256(_mm256_loadu_si256(p + 2), _mm256_loadu_si256(p + 3)));
+        if (0 == _mm256_testz_si256(v, v)) return false;
+    }
+    return isZeroSse2(data + i, length - i);
+}
+#endif
+
+zero_fn selectIsZero() {
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return isZeroAvx2;
+    }
+    return isZeroSse2;
+#else
+    return isZeroScalar;
+#endif
+}
+
+}  // namespace
+
+bool isZero(char const* data, size_t const length) {
+    static zero_fn const impl = selectIsZero();
+    return impl(data, length);
+}
+
 }  // namespace block
 }  // namespace fds
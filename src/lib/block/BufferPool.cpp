@@ -0,0 +1,139 @@
+/*
+ * BufferPool.cpp
+ *
+ * Copyright (c) 2016, Andreas Griesshammer <andreas@formationds.com>
+ * Copyright (c) 2016, Formation Data Systems
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "connector/block/BufferPool.h"
+
+namespace fds {
+namespace block {
+
+// The free buffers live apart from the pool so buffers still referenced
+// when the pool goes away have something to return to.
+struct BufferPool::Free {
+    Free(size_t const bufferSize, size_t const maxBuffers)
+        : bufferSize(bufferSize),
+          maxBuffers(maxBuffers)
+    {
+        buffers.reserve(maxBuffers);
+    }
+
+    buffer_type* take() {
+        {
+            std::lock_guard<std::mutex> lg(lock);
+            if (false == buffers.empty()) {
+                auto buf = buffers.back().release();
+                buffers.pop_back();
+                ++reuses;
+                return buf;
+            }
+        }
+        ++allocations;
+        auto buf = new buffer_type();
+        buf->reserve(bufferSize);
+        return buf;
+    }
+
+    void release(buffer_type* buf) {
+        std::unique_ptr<buffer_type> owned(buf);
+        ++releases;
+        // Someone may have grown or swapped the string, only keep the
+        // ones that still fit an object without reallocating
+        if (bufferSize <= buf->capacity()) {
+            std::lock_guard<std::mutex> lg(lock);
+            if ((false == closed) && (buffers.size() < maxBuffers)) {
+                buffers.emplace_back(std::move(owned));
+                return;
+            }
+        }
+        ++discards;
+    }
+
+    size_t const                                bufferSize;
+    size_t const                                maxBuffers;
+
+    std::mutex                                  lock;
+    std::vector<std::unique_ptr<buffer_type>>   buffers;
+    bool                                        closed {false};
+
+    std::atomic<uint64_t>                       allocations {0};
+    std::atomic<uint64_t>                       reuses {0};
+    std::atomic<uint64_t>                       releases {0};
+    std::atomic<uint64_t>                       discards {0};
+};
+
+// Deleter of the buffers handed out
+struct BufferPool::Release {
+    std::shared_ptr<Free> free;
+    void operator()(buffer_type* buf) const { free->release(buf); }
+};
+
+BufferPool::BufferPool(size_t const bufferSize, size_t const maxBuffers)
+        : _free(std::make_shared<Free>(bufferSize, maxBuffers))
+{
+}
+
+BufferPool::~BufferPool() {
+    std::lock_guard<std::mutex> lg(_free->lock);
+    _free->closed = true;
+    _free->buffers.clear();
+}
+
+BufferPool::buffer_ptr_type BufferPool::get(size_t const length) {
+    if ((false == enabled()) || (_free->bufferSize < length)) {
+        ++_free->allocations;
+        return std::make_shared<buffer_type>(length, '\0');
+    }
+    auto buf = _free->take();
+    // Within the capacity reserved up front, never reallocates
+    buf->resize(length);
+    return buffer_ptr_type(buf, Release{_free});
+}
+
+BufferPool::buffer_ptr_type BufferPool::zeroed(size_t const length) {
+    auto buf = get(length);
+    buf->assign(length, '\0');
+    return buf;
+}
+
+BufferPool::buffer_ptr_type BufferPool::copy(char const* data, size_t const length) {
+    auto buf = get(length);
+    buf->replace(0, length, data, length);
+    return buf;
+}
+
+bool BufferPool::enabled() const {
+    return (0 < _free->maxBuffers);
+}
+
+size_t BufferPool::bufferSize() const {
+    return _free->bufferSize;
+}
+
+BufferPool::Stats BufferPool::getStats() const {
+    Stats s;
+    s.allocations = _free->allocations.load();
+    s.reuses = _free->reuses.load();
+    s.releases = _free->releases.load();
+    s.discards = _free->discards.load();
+    std::lock_guard<std::mutex> lg(_free->lock);
+    s.buffers = _free->buffers.size();
+    return s;
+}
+
+} // namespace block
+} // namespace fds
@@ -0,0 +1,126 @@
+/*
+ * CommitGroup.cpp
+ *
+ * Copyright (c) 2016, Andreas Griesshammer <andreas@formationds.com>
+ * Copyright (c) 2016, Formation Data Systems
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "connector/block/CommitGroup.h"
+
+namespace fds {
+namespace block {
+
+CommitGroup::CommitGroup(std::chrono::microseconds const interval, size_t const maxRanges, send_fn send)
+        : _interval(interval),
+          _maxRanges(maxRanges),
+          _send(send)
+{
+    if (true == enabled()) {
+        _sender = std::thread(&CommitGroup::run, this);
+    }
+}
+
+CommitGroup::~CommitGroup() {
+    stop();
+}
+
+void CommitGroup::add(xdi::RequestHandle const& requestId, xdi::WriteBlobRequest const& req) {
+    xdi::WriteBlobRequest ready;
+    std::vector<xdi::RequestHandle> ids;
+    {
+        std::lock_guard<std::mutex> lg(_lock);
+        if (true == _stopping) return;
+        if (true == _ids.empty()) {
+            _req.blob.blobInfo = req.blob.blobInfo;
+            _deadline = clock::now() + _interval;
+            _cv.notify_one();
+        }
+        // Ranges waiting to be committed never overlap
+        _req.blob.objects.insert(req.blob.objects.begin(), req.blob.objects.end());
+        _ids.push_back(requestId);
+        ++_ranges;
+        if (_maxRanges <= _ids.size()) {
+            take(ready, ids);
+        }
+    }
+    if (false == ids.empty()) {
+        auto const first = ids.front();
+        _send(first, ready, ids);
+    }
+}
+
+bool CommitGroup::take(xdi::WriteBlobRequest& req, std::vector<xdi::RequestHandle>& ids) {
+    if (true == _ids.empty()) return false;
+    req = std::move(_req);
+    ids.swap(_ids);
+    _req = xdi::WriteBlobRequest();
+    _ids.clear();
+    ++_commits;
+    return true;
+}
+
+void CommitGroup::flush() {
+    xdi::WriteBlobRequest ready;
+    std::vector<xdi::RequestHandle> ids;
+    {
+        std::lock_guard<std::mutex> lg(_lock);
+        if (false == take(ready, ids)) return;
+    }
+    auto const first = ids.front();
+    _send(first, ready, ids);
+}
+
+void CommitGroup::stop() {
+    {
+        std::lock_guard<std::mutex> lg(_lock);
+        _stopping = true;
+        _req = xdi::WriteBlobRequest();
+        _ids.clear();
+    }
+    _cv.notify_one();
+    if ((true == _sender.joinable()) && (std::this_thread::get_id() != _sender.get_id())) {
+        _sender.join();
+    }
+}
+
+CommitGroup::Stats CommitGroup::getStats() const {
+    Stats s;
+    s.ranges = _ranges.load();
+    s.commits = _commits.load();
+    return s;
+}
+
+// Send the group once its interval has passed
+void CommitGroup::run() {
+    std::unique_lock<std::mutex> l(_lock);
+    while (false == _stopping) {
+        if (true == _ids.empty()) {
+            _cv.wait(l);
+        } else if (clock::now() < _deadline) {
+            _cv.wait_until(l, _deadline);
+        } else {
+            xdi::WriteBlobRequest ready;
+            std::vector<xdi::RequestHandle> ids;
+            take(ready, ids);
+            auto const first = ids.front();
+            l.unlock();
+            _send(first, ready, ids);
+            l.lock();
+        }
+    }
+}
+
+} // namespace block
+} // namespace fds
@@ -0,0 +1,119 @@
+/*
+ * ObjectCache.cpp
+ *
+ * Copyright (c) 2016, Andreas Griesshammer <andreas@formationds.com>
+ * Copyright (c) 2016, Formation Data Systems
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "connector/block/ObjectCache.h"
+
+namespace fds {
+namespace block {
+
+static const size_t CACHE_SHARDS = 16;
+
+ObjectCache::ObjectCache(size_t const maxBytes)
+        : _maxBytes(maxBytes),
+          _shardBytes(maxBytes / CACHE_SHARDS),
+          _shards(CACHE_SHARDS)
+{
+}
+
+ObjectCache::Shard& ObjectCache::shardFor(xdi::ObjectId const& id) {
+    return _shards[std::hash<xdi::ObjectId>()(id) % _shards.size()];
+}
+
+ObjectCache::Shard const& ObjectCache::shardFor(xdi::ObjectId const& id) const {
+    return _shards[std::hash<xdi::ObjectId>()(id) % _shards.size()];
+}
+
+ObjectCache::buffer_ptr ObjectCache::get(xdi::ObjectId const& id) {
+    if (false == enabled()) return nullptr;
+    auto& shard = shardFor(id);
+    {
+        std::lock_guard<std::mutex> lg(shard.lock);
+        auto itr = shard.index.find(id);
+        if (shard.index.end() != itr) {
+            // Move to the front of the LRU
+            shard.lru.splice(shard.lru.begin(), shard.lru, itr->second);
+            ++_hits;
+            return itr->second->buf;
+        }
+    }
+    ++_misses;
+    return nullptr;
+}
+
+bool ObjectCache::contains(xdi::ObjectId const& id) const {
+    if (false == enabled()) return false;
+    auto& shard = shardFor(id);
+    std::lock_guard<std::mutex> lg(shard.lock);
+    return (shard.index.end() != shard.index.find(id));
+}
+
+void ObjectCache::insert(xdi::ObjectId const& id, buffer_ptr const& buf) {
+    if ((nullptr == buf) || (true == buf->empty())) return;
+    // Objects that can never fit are not cached
+    if (_shardBytes < buf->size()) return;
+    auto& shard = shardFor(id);
+    std::lock_guard<std::mutex> lg(shard.lock);
+    auto itr = shard.index.find(id);
+    if (shard.index.end() != itr) {
+        shard.lru.splice(shard.lru.begin(), shard.lru, itr->second);
+        return;
+    }
+    shard.lru.push_front(Entry{id, buf});
+    shard.index.emplace(id, shard.lru.begin());
+    shard.bytes += buf->size();
+    ++_insertions;
+    evict(shard);
+}
+
+// NOTE: the shard lock should be held when calling this
+void ObjectCache::evict(Shard& shard) {
+    while (_shardBytes < shard.bytes) {
+        auto& entry = shard.lru.back();
+        shard.bytes -= entry.buf->size();
+        shard.index.erase(entry.id);
+        shard.lru.pop_back();
+        ++_evictions;
+    }
+}
+
+void ObjectCache::clear() {
+    for (auto& shard : _shards) {
+        std::lock_guard<std::mutex> lg(shard.lock);
+        shard.index.clear();
+        shard.lru.clear();
+        shard.bytes = 0;
+    }
+}
+
+ObjectCache::Stats ObjectCache::getStats() const {
+    Stats stats;
+    stats.hits = _hits.load();
+    stats.misses = _misses.load();
+    stats.insertions = _insertions.load();
+    stats.evictions = _evictions.load();
+    for (auto const& shard : _shards) {
+        std::lock_guard<std::mutex> lg(shard.lock);
+        stats.bytes += shard.bytes;
+        stats.objects += shard.index.size();
+    }
+    return stats;
+}
+
+} // namespace block
+} // namespace fds
@@ -0,0 +1,207 @@
+/*
+ * ReadAhead.cpp
+ *
+ * Copyright (c) 2016, Andreas Griesshammer <andreas@formationds.com>
+ * Copyright (c) 2016, Formation Data Systems
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+// System includes
+#include <algorithm>
+
+// FDS includes
+#include "connector/block/ReadAhead.h"
+#include "connector/block/BlockOperations.h"
+#include "connector/block/BlobMetadataCache.h"
+#include "connector/block/ObjectCache.h"
+#include "log/Logger.h"
+
+namespace fds {
+namespace block {
+
+// Streams followed at once
+static const size_t READ_AHEAD_STREAMS = 8;
+// Reads continuing a stream before it prefetches
+static const uint32_t SEQUENTIAL_READS = 2;
+
+ReadAhead::ReadAhead(std::shared_ptr<xdi::ApiInterface> api,
+                     xdi::VolumeId const volumeId,
+                     std::string const& blobName,
+                     std::shared_ptr<ObjectCache> objectCache,
+                     std::shared_ptr<BlobMetadataCache> blobMetadata,
+                     uint32_t const minWindow,
+                     uint32_t const maxWindow)
+        : api(api),
+          volumeId(volumeId),
+          blobName(blobName),
+          objectCache(objectCache),
+          blobMetadata(blobMetadata),
+          minWindow(std::max(1u, std::min(minWindow, maxWindow))),
+          maxWindow(maxWindow),
+          streams(READ_AHEAD_STREAMS)
+{
+}
+
+bool ReadAhead::enabled() const {
+    // Prefetched objects have nowhere to go without the cache
+    return ((0 < maxWindow) && (true == objectCache->enabled()));
+}
+
+void ReadAhead::read(xdi::ObjectOffsetVal const start, xdi::ObjectOffsetVal const end) {
+    if (false == enabled()) return;
+    xdi::ObjectOffsetVal from {0};
+    xdi::ObjectOffsetVal to {0};
+    {
+        std::lock_guard<std::mutex> lg(lock);
+        ++tick;
+        auto itr = std::find_if(streams.begin(), streams.end(), [start] (Stream const& s) {
+            return (0 < s.used) && ((start == s.last) || (start == s.last + 1));
+        });
+        if (streams.end() == itr) {
+            // Could be the start of a stream
+            auto lru = std::min_element(streams.begin(), streams.end(), [] (Stream const& a, Stream const& b) {
+                return a.used < b.used;
+            });
+            *lru = Stream{end, end, minWindow, 0, tick};
+            ++newStreams;
+            return;
+        }
+        auto& s = *itr;
+        s.last = end;
+        s.used = tick;
+        if (SEQUENTIAL_READS > ++s.reads) return;
+        from = std::max(end, s.prefetched) + 1;
+        to = end + s.window;
+        if (from > to) return;
+        s.prefetched = to;
+        s.window = std::min(s.window * 2, maxWindow);
+    }
+    LOGTRACE("start:{} end:{} prefetch:{}-{}", start, end, from, to);
+    ++prefetches;
+    prefetch(from, to);
+}
+
+void ReadAhead::prefetch(xdi::ObjectOffsetVal const start, xdi::ObjectOffsetVal const end) {
+    BlobMetadataCache::object_map objects;
+    if (true == blobMetadata->lookup(start, end, objects)) {
+        readObjects(objects);
+        return;
+    }
+    uint64_t handle {0};
+    {
+        std::lock_guard<std::mutex> lg(lock);
+        handle = ++nextHandle;
+        blobReads.emplace(handle, BlobRange{start, end, blobMetadata->version()});
+        keepAlive();
+    }
+    xdi::ReadBlobRequest req;
+    req.path.blobName = blobName;
+    req.path.volumeId = volumeId;
+    req.range.startObjectOffset = start;
+    req.range.endObjectOffset = end;
+    xdi::Request r{xdi_handle{handle, 0}, xdi::RequestType::READ_BLOB_TYPE, this};
+    api->readBlob(r, req);
+}
+
+void ReadAhead::readObjects(std::map<xdi::ObjectOffsetVal, xdi::ObjectId> const& objects) {
+    std::vector<std::pair<uint64_t, xdi::ObjectId>> reads;
+    {
+        std::lock_guard<std::mutex> lg(lock);
+        for (auto const& o : objects) {
+            if ((true == o.second.empty()) || (EMPTY_ID == o.second)) continue;
+            if (pendingObjects.end() != pendingObjects.find(o.second)) continue;
+            if (true == objectCache->contains(o.second)) continue;
+            auto handle = ++nextHandle;
+            objectReads.emplace(handle, o.second);
+            pendingObjects.insert(o.second);
+            reads.emplace_back(handle, o.second);
+        }
+        if (false == reads.empty()) keepAlive();
+    }
+    for (auto const& read : reads) {
+        xdi::ReadObjectRequest req;
+        req.id = read.second;
+        req.volId = volumeId;
+        xdi::Request r{xdi_handle{read.first, 0}, xdi::RequestType::READ_OBJECT_TYPE, this};
+        api->readObject(r, req);
+    }
+}
+
+void ReadAhead::readBlobResp(xdi_handle const& requestId, xdi::ReadBlobResponse const& resp, xdi_error const& e) {
+    BlobRange range;
+    {
+        std::lock_guard<std::mutex> lg(lock);
+        auto itr = blobReads.find(requestId.handle);
+        if (blobReads.end() == itr) return;
+        range = itr->second;
+    }
+    if (xdi_error::XDI_OK == e) {
+        blobMetadata->populate(range.start, range.end, resp.blob.objects, range.version);
+        readObjects(resp.blob.objects);
+    } else if (xdi_error::XDI_MISSING_BLOB == e) {
+        blobMetadata->populate(range.start, range.end, BlobMetadataCache::object_map(), range.version);
+    }
+    std::shared_ptr<ReadAhead> last;
+    {
+        std::lock_guard<std::mutex> lg(lock);
+        blobReads.erase(requestId.handle);
+        last = release();
+    }
+}
+
+void ReadAhead::readObjectResp(xdi_handle const& requestId, xdi::BufferPtr const& resp, xdi_error const& e) {
+    xdi::ObjectId id;
+    {
+        std::lock_guard<std::mutex> lg(lock);
+        auto itr = objectReads.find(requestId.handle);
+        if (objectReads.end() == itr) return;
+        id = itr->second;
+    }
+    if (xdi_error::XDI_OK == e) {
+        objectCache->insert(id, resp);
+        ++objectsRead;
+    }
+    std::shared_ptr<ReadAhead> last;
+    {
+        std::lock_guard<std::mutex> lg(lock);
+        objectReads.erase(requestId.handle);
+        pendingObjects.erase(id);
+        last = release();
+    }
+}
+
+void ReadAhead::keepAlive() {
+    if (nullptr == self) self = shared_from_this();
+}
+
+// Drop the reference held for requests in flight once there are none, it
+// has to outlive the lock.
+std::shared_ptr<ReadAhead> ReadAhead::release() {
+    std::shared_ptr<ReadAhead> last;
+    if ((true == blobReads.empty()) && (true == objectReads.empty())) {
+        last.swap(self);
+    }
+    return last;
+}
+
+ReadAhead::Stats ReadAhead::getStats() const {
+    Stats s;
+    s.streams = newStreams.load();
+    s.prefetches = prefetches.load();
+    s.objects = objectsRead.load();
+    return s;
+}
+
+} // namespace block
+} // namespace fds
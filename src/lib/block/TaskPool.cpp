@@ -0,0 +1,117 @@
+/*
+ * TaskPool.cpp
+ *
+ * Copyright (c) 2016, Andreas Griesshammer <andreas@formationds.com>
+ * Copyright (c) 2016, Formation Data Systems
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "connector/block/TaskPool.h"
+#include "connector/block/Tasks.h"
+
+namespace fds {
+namespace block {
+
+TaskPool::TaskPool(size_t const maxTasks)
+        : _maxTasks(maxTasks)
+{
+    // Releasing never allocates
+    _reads.reserve(_maxTasks);
+    _writes.reserve(_maxTasks);
+    _writeSames.reserve(_maxTasks);
+}
+
+TaskPool::~TaskPool() {
+    for (auto t : _reads) delete t;
+    for (auto t : _writes) delete t;
+    for (auto t : _writeSames) delete t;
+}
+
+template<typename T>
+T* TaskPool::get(std::vector<T*>& free, ProtoTask* p_task) {
+    T* task {nullptr};
+    {
+        std::lock_guard<std::mutex> lg(_lock);
+        if (false == free.empty()) {
+            task = free.back();
+            free.pop_back();
+        }
+    }
+    if (nullptr == task) {
+        ++_allocations;
+        return new T(p_task);
+    }
+    ++_reuses;
+    task->reset(p_task);
+    return task;
+}
+
+template<typename T>
+void TaskPool::put(std::vector<T*>& free, T* task) {
+    task->reset(nullptr);
+    {
+        std::lock_guard<std::mutex> lg(_lock);
+        if (free.size() < _maxTasks) {
+            free.push_back(task);
+            return;
+        }
+    }
+    ++_discards;
+    delete task;
+}
+
+ReadTask* TaskPool::getRead(ProtoTask* p_task) {
+    return get(_reads, p_task);
+}
+
+WriteTask* TaskPool::getWrite(ProtoTask* p_task) {
+    return get(_writes, p_task);
+}
+
+WriteSameTask* TaskPool::getWriteSame(ProtoTask* p_task) {
+    return get(_writeSames, p_task);
+}
+
+void TaskPool::release(BlockTask* task) {
+    ++_releases;
+    switch (task->getType()) {
+        case TaskType::READ:
+            put(_reads, static_cast<ReadTask*>(task));
+            break;
+        case TaskType::WRITE:
+            put(_writes, static_cast<WriteTask*>(task));
+            break;
+        case TaskType::WRITESAME:
+            put(_writeSames, static_cast<WriteSameTask*>(task));
+            break;
+        default:
+            ++_discards;
+            delete task;
+            break;
+    }
+}
+
+TaskPool::Stats TaskPool::getStats() const {
+    Stats s;
+    s.allocations = _allocations.load();
+    s.reuses = _reuses.load();
+    s.releases = _releases.load();
+    s.discards = _discards.load();
+    std::lock_guard<std::mutex> lg(_lock);
+    s.tasks = _reads.size() + _writes.size() + _writeSames.size();
+    return s;
+}
+
+} // namespace block
+} // namespace fds
@@ -27,74 +27,114 @@ void
 ReadTask::handleReadResponse(std::vector<std::shared_ptr<std::string>>& buffers,
                               std::shared_ptr<std::string>& empty_buffer) {
     // acquire the buffers
-    bufVec.swap(buffers);
+    readVec.clear();
+    readVec.reserve(buffers.size() + 1);
 
-    uint32_t len {0};
+    uint64_t len {0};
 
     // Fill in any missing wholes with zero data, this is a special *block*
     // semantic for NULL objects.
-    for (auto& buf: bufVec) {
+    for (auto& buf: buffers) {
         if (!buf || 0 == buf->size()) {
-            buf = empty_buffer;
+            readVec.emplace_back(empty_buffer);
             len += maxObjectSizeInBytes;
         } else {
+            readVec.emplace_back(buf);
             len += buf->size();
         }
     }
+    buffers.clear();
 
     // return zeros for uninitialized objects, again a special *block*
     // semantic to PAD the read to the required length.
-    uint32_t iOff = getOffset() % maxObjectSizeInBytes;
+    uint32_t iOff = geometry.offsetInObject(getOffset());
     if (len < (getLength() + iOff)) {
         for (ssize_t zero_data = (getLength() + iOff) - len; 0 < zero_data; zero_data -= maxObjectSizeInBytes) {
-            bufVec.push_back(empty_buffer);
+            readVec.emplace_back(empty_buffer);
         }
     }
 
     // Trim the data as needed from the front...
-    auto firstObjLen = std::min(getLength(), maxObjectSizeInBytes - iOff);
+    auto firstObjLen = std::min<uint64_t>(getLength(), maxObjectSizeInBytes - iOff);
     if (maxObjectSizeInBytes != firstObjLen) {
-        bufVec.front() = std::make_shared<std::string>(bufVec.front()->data() + iOff, firstObjLen);
+        readVec.front().trim(iOff, firstObjLen);
     }
 
-    // ...and the back
+    // ...and the back, only the views change, the objects aren't copied
     if (getLength() > firstObjLen) {
-        auto padding = (2 < bufVec.size()) ? (bufVec.size() - 2) * maxObjectSizeInBytes : 0;
+        auto padding = (2 < readVec.size()) ? (readVec.size() - 2) * maxObjectSizeInBytes : 0;
         auto lastObjLen = getLength() - firstObjLen - padding;
         if (0 < lastObjLen && maxObjectSizeInBytes != lastObjLen) {
-            bufVec.back() = std::make_shared<std::string>(bufVec.back()->data(), lastObjLen);
+            readVec.back().trim(0, lastObjLen);
         }
     }
 }
 
+void
+WriteTask::getWriteBuffer(std::shared_ptr<std::string>& buf) {
+    if (1 < writeBuffers.size()) {
+        auto joined = std::make_shared<std::string>();
+        joined->reserve(getLength());
+        for (auto const& b : writeBuffers) {
+            *joined += *b;
+        }
+        writeBuffers.assign(1, joined);
+    }
+    buf = writeBuffers.empty() ? nullptr : writeBuffers.front();
+}
+
+BufferView
+WriteTask::getWriteSlice(size_t const off, size_t const len, BufferPool& pool) const {
+    size_t start {0};
+    auto itr = writeBuffers.begin();
+    while ((writeBuffers.end() != itr) && (start + (*itr)->size() <= off)) {
+        start += (*itr)->size();
+        ++itr;
+    }
+    if ((writeBuffers.end() != itr) && (off + len <= start + (*itr)->size())) {
+        return BufferView(*itr, off - start, len);
+    }
+    // Spans buffers, put the pieces together
+    auto buf = pool.get(len);
+    size_t copied {0};
+    for (auto pos = off - start; (writeBuffers.end() != itr) && (copied < len); ++itr, pos = 0) {
+        auto n = std::min(len - copied, (*itr)->size() - pos);
+        buf->replace(copied, n, (*itr)->data() + pos, n);
+        copied += n;
+    }
+    return BufferView(buf);
+}
+
 std::shared_ptr<std::string>
 WriteTask::handleRMWResponse(std::shared_ptr<std::string> const& retBuf,
                              sequence_type seqId,
+                             BufferPool& pool,
                              bool const mutable_buffer) {
 
-    auto w_itr = writeOffsetInBlockMap.find(seqId);
-    uint32_t iOff = (w_itr != writeOffsetInBlockMap.end()) ? w_itr->second % maxObjectSizeInBytes : 0;
+    auto w_itr = std::find_if(writeOffsetsInBlock.begin(), writeOffsetsInBlock.end(),
+                              [seqId] (std::pair<sequence_type, uint32_t> const& o) { return seqId == o.first; });
+    uint32_t iOff = (w_itr != writeOffsetsInBlock.end()) ? geometry.offsetInObject(w_itr->second) : 0;
     auto& writeBytes = bufVec[seqId];
     std::shared_ptr<std::string> fauxBytes;
     if (!retBuf || (0 == retBuf->size())) {
         // we tried to read unwritten block, so create
         // an empty block buffer to place the data
-        fauxBytes = std::make_shared<std::string>(maxObjectSizeInBytes, '\0');
-        fauxBytes->replace(iOff, writeBytes->length(),
-                           writeBytes->c_str(), writeBytes->length());
+        fauxBytes = pool.zeroed(maxObjectSizeInBytes);
+        fauxBytes->replace(iOff, writeBytes.size(),
+                           writeBytes.data(), writeBytes.size());
     } else {
         if (!mutable_buffer) {
             // Need to copy retBut into a modifiable buffer since retBuf is owned
             // by the connector and should not be modified here.
-            fauxBytes = std::make_shared<std::string>(retBuf->c_str(), retBuf->length());
+            fauxBytes = pool.copy(retBuf->data(), retBuf->length());
         } else {
             fauxBytes = retBuf;
         }
-        fauxBytes->replace(iOff, writeBytes->length(),
-                           writeBytes->c_str(), writeBytes->length());
+        fauxBytes->replace(iOff, writeBytes.size(),
+                           writeBytes.data(), writeBytes.size());
     }
     // Update the resp so the next in the chain can grab the buffer
-    writeBytes = fauxBytes;
+    writeBytes = BufferView(fauxBytes);
     return fauxBytes;
 }
 
@@ -0,0 +1,65 @@
+/*
+ * WriteBarrier.cpp
+ *
+ * Copyright (c) 2016, Andreas Griesshammer <andreas@formationds.com>
+ * Copyright (c) 2016, Formation Data Systems
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "connector/block/WriteBarrier.h"
+
+namespace fds {
+namespace block {
+
+uint64_t WriteBarrier::start() {
+    std::lock_guard<std::mutex> lg(_lock);
+    ++_writes[_epoch];
+    return _epoch;
+}
+
+void WriteBarrier::done(uint64_t const epoch, std::vector<BlockTask*>& passed) {
+    std::lock_guard<std::mutex> lg(_lock);
+    auto itr = _writes.find(epoch);
+    if (_writes.end() == itr) return;
+    if (0 < --itr->second) return;
+    _writes.erase(itr);
+    // Everything before the oldest epoch with writes left is done
+    auto oldest = (true == _writes.empty()) ? _epoch : _writes.begin()->first;
+    while ((false == _waiting.empty()) && (_waiting.front().first < oldest)) {
+        passed.push_back(_waiting.front().second);
+        _waiting.pop_front();
+    }
+    _waitingCount = _waiting.size();
+}
+
+bool WriteBarrier::wait(BlockTask* task) {
+    std::lock_guard<std::mutex> lg(_lock);
+    ++_barriers;
+    if (true == _writes.empty()) return false;
+    ++_waited;
+    // Writes started from now on don't hold the task back
+    _waiting.emplace_back(_epoch++, task);
+    _waitingCount = _waiting.size();
+    return true;
+}
+
+WriteBarrier::Stats WriteBarrier::getStats() const {
+    Stats s;
+    s.barriers = _barriers.load();
+    s.waited = _waited.load();
+    return s;
+}
+
+} // namespace block
+} // namespace fds
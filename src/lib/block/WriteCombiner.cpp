@@ -0,0 +1,217 @@
+/*
+ * WriteCombiner.cpp
+ *
+ * Copyright (c) 2016, Andreas Griesshammer <andreas@formationds.com>
+ * Copyright (c) 2016, Formation Data Systems
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+// System includes
+#include <algorithm>
+
+// FDS includes
+#include "connector/block/WriteCombiner.h"
+#include "connector/block/BufferPool.h"
+#include "connector/block/Tasks.h"
+
+namespace fds {
+namespace block {
+
+// Objects that can be buffered at once, writes to any other object are
+// not combined until some are flushed
+static const size_t MAX_PENDING_OBJECTS = 256;
+
+WriteCombiner::WriteCombiner
+(
+  uint32_t const                    objectSize,
+  std::chrono::microseconds const   window,
+  std::shared_ptr<BufferPool>       pool,
+  flush_fn                          flush
+)
+        : _objectSize(objectSize),
+          _geometry(objectSize),
+          _window(window),
+          _pool(pool),
+          _flush(flush)
+{
+    if (true == enabled()) {
+        _flusher = std::thread(&WriteCombiner::run, this);
+    }
+}
+
+WriteCombiner::~WriteCombiner() {
+    stop();
+}
+
+bool WriteCombiner::add(WriteTask* task) {
+    if (false == enabled()) return false;
+    auto length = task->getLength();
+    auto object = _geometry.object(task->getOffset());
+    uint32_t lo = _geometry.offsetInObject(task->getOffset());
+    uint32_t hi = lo + length;
+    // Full objects need no read and writes spanning objects are split up
+    // anyway, neither gains anything from waiting
+    if ((0 == length) || (_objectSize <= length) || (_objectSize < hi)) return false;
+
+    std::vector<WriteTask*> ready;
+    bool buffered {true};
+    {
+        std::lock_guard<std::mutex> lg(_lock);
+        if (true == _stopping) return false;
+        auto itr = _pending.find(object);
+        if ((_pending.end() != itr) && ((itr->second.hi < lo) || (hi < itr->second.lo))) {
+            ready.push_back(take(itr));
+            itr = _pending.end();
+        }
+        if (_pending.end() != itr) {
+            merge(itr->second, task, lo, hi);
+            ++_combined;
+            if ((0 == itr->second.lo) && (_objectSize == itr->second.hi)) {
+                ready.push_back(take(itr));
+            }
+        } else if (MAX_PENDING_OBJECTS <= _pending.size()) {
+            buffered = false;
+        } else {
+            Pending p {lo, hi, nullptr, {task}, clock::now() + _window};
+            _pending.emplace(object, std::move(p));
+            _cv.notify_one();
+        }
+    }
+    for (auto t : ready) {
+        _flush(t);
+    }
+    return buffered;
+}
+
+// NOTE: the lock should be held when calling this
+void WriteCombiner::merge(Pending& p, WriteTask* task, uint32_t const lo, uint32_t const hi) {
+    std::shared_ptr<std::string> buf;
+    if (nullptr == p.data) {
+        // Only take an object from the pool once a second write shows up
+        p.data = _pool->zeroed(_objectSize);
+        p.tasks.front()->getWriteBuffer(buf);
+        p.data->replace(p.lo, p.hi - p.lo, *buf, 0, p.hi - p.lo);
+    }
+    // Later writes win where they overlap
+    task->getWriteBuffer(buf);
+    p.data->replace(lo, hi - lo, *buf, 0, hi - lo);
+    p.lo = std::min(p.lo, lo);
+    p.hi = std::max(p.hi, hi);
+    p.tasks.push_back(task);
+}
+
+// Turn the buffered writes into a single task and forget about them.
+// NOTE: the lock should be held when calling this
+WriteTask* WriteCombiner::take(pending_map::iterator itr) {
+    auto& p = itr->second;
+    auto task = p.tasks.front();
+    if (1 < p.tasks.size()) {
+        // A full object is written from the buffer it was combined in,
+        // otherwise that buffer goes back to the pool once copied from
+        auto buf = p.data;
+        if ((0 == p.lo) && (_objectSize == p.hi)) {
+            ++_fullObjects;
+        } else {
+            buf = _pool->copy(&(*p.data)[p.lo], p.hi - p.lo);
+        }
+        task->set(_geometry.objectStart(itr->first) + p.lo, p.hi - p.lo);
+        task->setWriteBuffer(buf);
+        for (size_t i = 1; i < p.tasks.size(); ++i) {
+            task->addCombined(p.tasks[i]);
+        }
+    }
+    ++_flushes;
+    _pending.erase(itr);
+    return task;
+}
+
+void WriteCombiner::flush(uint64_t const start, uint64_t const end) {
+    if (false == enabled()) return;
+    std::vector<WriteTask*> ready;
+    {
+        std::lock_guard<std::mutex> lg(_lock);
+        auto itr = _pending.lower_bound(start);
+        while ((_pending.end() != itr) && (itr->first <= end)) {
+            auto next = std::next(itr);
+            ready.push_back(take(itr));
+            itr = next;
+        }
+    }
+    for (auto t : ready) {
+        _flush(t);
+    }
+}
+
+// Whatever is still buffered is handed out one last time, the owner of
+// the flush function decides whether to execute or fail it
+void WriteCombiner::stop() {
+    std::vector<WriteTask*> ready;
+    {
+        std::lock_guard<std::mutex> lg(_lock);
+        _stopping = true;
+        while (false == _pending.empty()) {
+            ready.push_back(take(_pending.begin()));
+        }
+    }
+    _cv.notify_one();
+    if ((true == _flusher.joinable()) && (std::this_thread::get_id() != _flusher.get_id())) {
+        _flusher.join();
+    }
+    for (auto t : ready) {
+        _flush(t);
+    }
+}
+
+WriteCombiner::Stats WriteCombiner::getStats() const {
+    Stats s;
+    s.combined = _combined.load();
+    s.flushes = _flushes.load();
+    s.fullObjects = _fullObjects.load();
+    std::lock_guard<std::mutex> lg(_lock);
+    s.objects = _pending.size();
+    return s;
+}
+
+// Flush every object whose window has passed
+void WriteCombiner::run() {
+    std::unique_lock<std::mutex> l(_lock);
+    while (false == _stopping) {
+        auto now = clock::now();
+        auto next = clock::time_point::max();
+        std::vector<WriteTask*> ready;
+        auto itr = _pending.begin();
+        while (_pending.end() != itr) {
+            auto current = itr++;
+            if (current->second.deadline <= now) {
+                ready.push_back(take(current));
+            } else {
+                next = std::min(next, current->second.deadline);
+            }
+        }
+        if (false == ready.empty()) {
+            l.unlock();
+            for (auto t : ready) {
+                _flush(t);
+            }
+            l.lock();
+        } else if (clock::time_point::max() == next) {
+            _cv.wait(l);
+        } else {
+            _cv.wait_until(l, next);
+        }
+    }
+}
+
+} // namespace block
+} // namespace fds
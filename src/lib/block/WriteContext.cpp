@@ -22,7 +22,21 @@
 namespace fds {
 namespace block {
 
-WriteContext::WriteContext(VolumeId volId, std::string& name, uint32_t size) : _path(volId, name), _objectSize(size) {
+WriteContext::WriteContext
+(
+  VolumeId            volId,
+  std::string&        name,
+  uint32_t            size,
+  ObjectOffsetVal     regionObjects,
+  ObjectOffsetVal     numStripes,
+  ObjectOffsetVal     stripe
+)
+    : _path(volId, name),
+      _objectSize(size),
+      _regionObjects(regionObjects),
+      _numStripes(numStripes),
+      _stripe(stripe)
+{
 }
 
 WriteContext::~WriteContext() {
@@ -37,57 +51,9 @@ bool WriteContext::checkOverlappingAwaitingBlobWrite
 )
 {
     // Check if we awaiting a response on a BlobWrite for this range
-    auto awaitingItr = _awaitingBlobWrites.begin();
-    while (_awaitingBlobWrites.end() != awaitingItr) {
-        auto awaitingStartOffset = awaitingItr->first;
-        auto awaitingEndOffset = awaitingItr->first + awaitingItr->second.numObjects - 1;
-        if (true == checkForOverlap(startOffset, endOffset, awaitingStartOffset, awaitingEndOffset)) {
-            awaitingItr->second.pendingTasks.push(task);
-            return true;
-        }
-        ++awaitingItr;
-    }
-    return false;
-}
-
-/**********************************************************
-* Determine if existing range overlaps with new range.
-* Returns - true if overlap
-*           false if no overlap
-*
-* X = newStart
-* Y = newEnd
-* S = origStart
-* E = origEnd
-* case 1:   newStart is between origStart and origEnd
-*           SoooooooooooooE
-*                     XooooooooooooooY
-*
-*                   or
-*
-*           SoooooooooooooE
-*                  XoooY
-*
-* case 2:    newEnd is between origStart and origEnd
-*                     SooooooooooooooE
-*            XoooooooooooooY
-*
-* case 3:    origStart and origEnd are between newStart and newEnd
-*                   SooooooooE
-*             XooooooooooooooooooooY
-**********************************************************/
-bool WriteContext::checkForOverlap
-(
-  ObjectOffsetVal const&         newStart,
-  ObjectOffsetVal const&         newEnd,
-  ObjectOffsetVal const&         origStart,
-  ObjectOffsetVal const&         origEnd
-)
-{
-    if (((newStart >= origStart) && (newStart <= origEnd)) || // case 1
-        ((newEnd >= origStart) && (newEnd <= origEnd))     || // case 2
-        ((newStart < origStart) && (newEnd > origEnd)))       // case 3
-    {
+    auto awaitingItr = _awaitingBlobWrites.findOverlapping(toLocal(startOffset), toLocal(endOffset));
+    if (_awaitingBlobWrites.end() != awaitingItr) {
+        awaitingItr->second.pendingTasks.push(task);
         return true;
     }
     return false;
@@ -95,45 +61,46 @@ bool WriteContext::checkForOverlap
 
 void WriteContext::mergeRanges
 (
-  ObjectOffsetVal const&                 newStart,
-  ObjectOffsetVal const&                 newEnd,
+  ObjectOffsetVal const&                 startOffset,
+  ObjectOffsetVal const&                 endOffset,
   BlockTask*                             task
 )
 {
+    auto const newStart = toLocal(startOffset);
+    auto const newEnd = toLocal(endOffset);
     auto lowestStart = newStart;
     PendingBlobWrite newPendingBlobWrite;
 
     // Any existing overlapping entry gets merged into this new one
-    auto itr = _pendingBlobWrites.begin();
+    auto itr = _pendingBlobWrites.findOverlapping(newStart, newEnd);
     while ((_pendingBlobWrites.end() != itr) && (itr->first <= newEnd)) {
-        auto origStart = itr->first;
-        auto origEnd = itr->first + itr->second.numObjects - 1;
-        if (true == checkForOverlap(newStart, newEnd, origStart, origEnd))
-        {
-            if (origStart < lowestStart) {
-                lowestStart = origStart;
-            }
-            auto erase_itr = itr;
-            ++itr;
-            newPendingBlobWrite += std::move(erase_itr->second);
-            _pendingBlobWrites.erase(erase_itr);
-        } else {
-            ++itr;
+        if (itr->first < lowestStart) {
+            lowestStart = itr->first;
         }
+        newPendingBlobWrite += std::move(itr->second);
+        itr = _pendingBlobWrites.erase(itr);
     }
 
-    // TODO andreas: this takes an extremely long time for a large range(say 75million)
-    // Fill in any remaining gaps for the full range
-    for (auto i = newStart; i <= newEnd; ++i) {
-        auto offsetItr = newPendingBlobWrite.offsetStatus.find(i);
-        if (offsetItr == newPendingBlobWrite.offsetStatus.end()) {
-            PendingOffsetWrite pow;
-            pow.isStable = false;
-            auto addedOffset = newPendingBlobWrite.offsetStatus.emplace(i, std::move(pow));
-            if (true == std::get<1>(addedOffset)) {
-                ++(newPendingBlobWrite.numObjects);
+    // Fill in any remaining gaps for the full range, each gap is a single extent
+    auto& status = newPendingBlobWrite.offsetStatus;
+    auto o_itr = status.findOverlapping(newStart, newEnd);
+    auto next = newStart;
+    while (next <= newEnd) {
+        auto gapEnd = newEnd;
+        if ((status.end() != o_itr) && (o_itr->first <= newEnd)) {
+            if (o_itr->first <= next) {
+                next = OffsetStatus::lastOffset(o_itr) + 1;
+                ++o_itr;
+                continue;
             }
+            gapEnd = o_itr->first - 1;
         }
+        PendingOffsetWrite pow;
+        pow.numObjects = gapEnd - next + 1;
+        pow.isStable = false;
+        newPendingBlobWrite.numObjects += pow.numObjects;
+        status.emplace(next, std::move(pow));
+        next = gapEnd + 1;
     }
 
     // Insert this new entry into the map
@@ -146,22 +113,50 @@ void WriteContext::mergeRanges
     }
 }
 
+WriteContext::OffsetStatus* WriteContext::findOffsetStatus(ObjectOffsetVal const& offset) {
+    auto itr = _pendingBlobWrites.find(offset);
+    if (_pendingBlobWrites.end() == itr) {
+        return nullptr;
+    }
+    return &(itr->second.offsetStatus);
+}
+
+// Make sure offset is the first offset of an extent by
+// splitting the extent containing it.
+void WriteContext::splitExtent
+(
+  OffsetStatus&               status,
+  ObjectOffsetVal const&      offset
+)
+{
+    auto itr = status.find(offset);
+    if ((status.end() == itr) || (offset == itr->first)) return;
+    auto tail = itr->second.clone(OffsetStatus::lastOffset(itr) - offset + 1);
+    itr->second.numObjects = offset - itr->first;
+    status.emplace(offset, std::move(tail));
+}
+
+// Split extents so that [startOffset, endOffset] is covered by whole
+// extents only, returns the first of them.
+WriteContext::OffsetStatus::iterator WriteContext::isolateRange
+(
+  OffsetStatus&               status,
+  ObjectOffsetVal const&      startOffset,
+  ObjectOffsetVal const&      endOffset
+)
+{
+    splitExtent(status, endOffset + 1);
+    splitExtent(status, startOffset);
+    return status.findOverlapping(startOffset, endOffset);
+}
+
 bool WriteContext::isRangeAvailable
 (
   ObjectOffsetVal const&                 newStart,
   ObjectOffsetVal const&                 newEnd
 )
 {
-    auto itr = _pendingBlobWrites.begin();
-    while ((_pendingBlobWrites.end() != itr) && (itr->first <= newEnd)) {
-        auto origStart = itr->first;
-        auto origEnd = itr->first + itr->second.numObjects - 1;
-        if (true == checkForOverlap(newStart, newEnd, origStart, origEnd)) {
-            return false;
-        }
-        ++itr;
-    }
-    return true;
+    return (_pendingBlobWrites.end() == _pendingBlobWrites.findOverlapping(toLocal(newStart), toLocal(newEnd)));
 }
 
 WriteContext::ReadBlobResult WriteContext::addReadBlob
@@ -179,88 +174,106 @@ WriteContext::ReadBlobResult WriteContext::addReadBlob
     return ReadBlobResult::OK;
 }
 
+bool WriteContext::isPendingBlobRead(ObjectOffsetVal const& offset, BlockTask* task) {
+    auto itr = _pendingBlobWrites.find(toLocal(offset));
+    if (_pendingBlobWrites.end() == itr) {
+        return false;
+    }
+    return (0 < itr->second.pendingBlobReads.count(task));
+}
+
 // Check to see if this write overlaps with an already pending
 // range of writes.  If so, merge those writes together.
 // Returns false if the pending write should not continue and has been queued
 // up to continue later.
-bool WriteContext::addPendingWrite(ObjectOffsetVal const& newStart, ObjectOffsetVal const& newEnd, BlockTask* task) {
-    auto b_itr = _pendingBlobWrites.begin();
-    while (_pendingBlobWrites.end() != b_itr) {
-        auto origStart = b_itr->first;
-        auto origEnd = b_itr->first + b_itr->second.numObjects - 1;
-        if (true == checkForOverlap(newStart, newEnd, origStart, origEnd)) {
-            for (auto i = newStart; i <= newEnd; ++i) {
-                auto o_itr = b_itr->second.offsetStatus.find(i);
-                if (b_itr->second.offsetStatus.end() == o_itr) {
-                    LOGERROR("offset:{} missing", i);
-                } else {
-                    o_itr->second.isStable = false;
-                }
-            }
-            b_itr->second.pendingBlobReads.erase(task);
-            b_itr->second.pendingTasks.push(task);
-            return true;
+bool WriteContext::addPendingWrite(ObjectOffsetVal const& startOffset, ObjectOffsetVal const& endOffset, BlockTask* task) {
+    auto const newStart = toLocal(startOffset);
+    auto const newEnd = toLocal(endOffset);
+    auto b_itr = _pendingBlobWrites.findOverlapping(newStart, newEnd);
+    if (_pendingBlobWrites.end() == b_itr) {
+        return false;
+    }
+    auto& status = b_itr->second.offsetStatus;
+    auto next = newStart;
+    for (auto o_itr = isolateRange(status, newStart, newEnd); (status.end() != o_itr) && (o_itr->first <= newEnd); ++o_itr) {
+        if (next != o_itr->first) {
+            LOGERROR("offset:{} missing", toGlobal(next));
         }
-        ++b_itr;
+        o_itr->second.isStable = false;
+        next = OffsetStatus::lastOffset(o_itr) + 1;
     }
-    return false;
+    if (next <= newEnd) {
+        LOGERROR("offset:{} missing", toGlobal(next));
+    }
+    b_itr->second.pendingBlobReads.erase(task);
+    b_itr->second.pendingTasks.push(task);
+    return true;
 }
 
 void WriteContext::triggerWrite(ObjectOffsetVal const& offset) {
-    auto itr = _pendingBlobWrites.begin();
-    while (_pendingBlobWrites.end() != itr) {
-        if ((itr->first <= offset) && (itr->first + itr->second.numObjects > offset)) {
-            itr->second.offsetStatus[offset].id = "";
-            itr->second.offsetStatus[offset].isStable = false;
-            itr->second.offsetStatus[offset].hasPendingWrite = true;
-            return;
-        }
-        ++itr;
+    triggerWrite(offset, offset);
+}
+
+void WriteContext::triggerWrite(ObjectOffsetVal const& start, ObjectOffsetVal const& end) {
+    auto const startOffset = toLocal(start);
+    auto const endOffset = toLocal(end);
+    auto status = findOffsetStatus(startOffset);
+    if (nullptr == status) {
+        LOGERROR("offset:{} missing", start);
+        return;
+    }
+    for (auto o_itr = isolateRange(*status, startOffset, endOffset); (status->end() != o_itr) && (o_itr->first <= endOffset); ++o_itr) {
+        auto& pow = o_itr->second;
+        pow.id = "";
+        pow.isStable = false;
+        pow.hasPendingWrite = true;
     }
-    LOGERROR("offset:{} missing", offset);
 }
 
 void WriteContext::updateOffset(ObjectOffsetVal const& offset, ObjectId const& id) {
-    auto itr = _pendingBlobWrites.begin();
-    while (_pendingBlobWrites.end() != itr) {
-        if ((itr->first <= offset) && (itr->first + itr->second.numObjects > offset)) {
-            itr->second.offsetStatus[offset].id = id;
-            if ((nullptr == itr->second.offsetStatus[offset].updateChain) ||
-                ((nullptr != itr->second.offsetStatus[offset].updateChain) && (true == itr->second.offsetStatus[offset].updateChain->empty()))) {
-                itr->second.offsetStatus[offset].isStable = true;
-            }
-            itr->second.offsetStatus[offset].hasPendingWrite = false;
-            return;
+    updateOffset(offset, offset, id);
+}
+
+void WriteContext::updateOffset(ObjectOffsetVal const& start, ObjectOffsetVal const& end, ObjectId const& id) {
+    auto const startOffset = toLocal(start);
+    auto const endOffset = toLocal(end);
+    auto status = findOffsetStatus(startOffset);
+    if (nullptr == status) {
+        LOGERROR("offset:{} missing", start);
+        return;
+    }
+    for (auto o_itr = isolateRange(*status, startOffset, endOffset); (status->end() != o_itr) && (o_itr->first <= endOffset); ++o_itr) {
+        auto& pow = o_itr->second;
+        pow.id = id;
+        if ((nullptr == pow.updateChain) || (true == pow.updateChain->empty())) {
+            pow.isStable = true;
         }
-        ++itr;
+        pow.hasPendingWrite = false;
     }
-    LOGERROR("offset:{} missing", offset);
 }
 
 void WriteContext::setOffsetObjectBuffer(ObjectOffsetVal const& offset, std::shared_ptr<std::string> buf) {
-    auto itr = _pendingBlobWrites.begin();
-    while (_pendingBlobWrites.end() != itr) {
-        if ((itr->first <= offset) && (itr->first + itr->second.numObjects > offset)) {
-            auto o_itr = itr->second.offsetStatus.find(offset);
-            if (itr->second.offsetStatus.end() != o_itr) {
-                o_itr->second.buf = buf;
-            }
-            return;
-        }
-        ++itr;
+    setOffsetObjectBuffer(offset, offset, buf);
+}
+
+void WriteContext::setOffsetObjectBuffer(ObjectOffsetVal const& start, ObjectOffsetVal const& end, std::shared_ptr<std::string> buf) {
+    auto const startOffset = toLocal(start);
+    auto const endOffset = toLocal(end);
+    auto status = findOffsetStatus(startOffset);
+    if (nullptr == status) return;
+    for (auto o_itr = isolateRange(*status, startOffset, endOffset); (status->end() != o_itr) && (o_itr->first <= endOffset); ++o_itr) {
+        o_itr->second.buf = buf;
     }
 }
 
-std::shared_ptr<std::string> WriteContext::getOffsetObjectBuffer(ObjectOffsetVal const& offset) {
-    auto itr = _pendingBlobWrites.begin();
-    while (_pendingBlobWrites.end() != itr) {
-        if ((itr->first <= offset) && (itr->first + itr->second.numObjects > offset)) {
-            auto o_itr = itr->second.offsetStatus.find(offset);
-            if (itr->second.offsetStatus.end() != o_itr) {
-                return o_itr->second.buf;
-            }
+std::shared_ptr<std::string> WriteContext::getOffsetObjectBuffer(ObjectOffsetVal const& globalOffset) {
+    auto const offset = toLocal(globalOffset);
+    auto status = findOffsetStatus(offset);
+    if (nullptr != status) {
+        auto o_itr = status->find(offset);
+        if (status->end() != o_itr) {
+            return o_itr->second.buf;
         }
-        ++itr;
     }
     return std::make_shared<std::string>();
 }
@@ -272,114 +285,153 @@ std::shared_ptr<std::string> WriteContext::getOffsetObjectBuffer(ObjectOffsetVal
 // If the function returns true then the WriteBlobRequest should be sent out and the range
 // it covers will be removed from the WriteContext.
 bool WriteContext::getWriteBlobRequest(ObjectOffsetVal const& offset, WriteBlobRequest& req, std::queue<BlockTask*>& queue) {
-    auto itr = _pendingBlobWrites.begin();
-    while (_pendingBlobWrites.end() != itr) {
-        if ((offset >= itr->first) && (offset < itr->first + itr->second.numObjects)) {
-            if (false ==  itr->second.pendingBlobReads.empty()) {
-                return false;
-            }
-            req.blob.blobInfo.path = _path;
-            req.blob.objects.clear();
-            for (auto const& o : itr->second.offsetStatus) {
-                if (false == o.second.isStable) {
-                    return false;
-                } else if ((nullptr != o.second.updateChain) && (!o.second.updateChain->empty())) {
-                    return false;
-                }
-                ObjectDescriptor od;
-                od.objectId = o.second.id;
-                od.length = _objectSize;
-                req.blob.objects.emplace(o.first, od);
+    auto itr = _pendingBlobWrites.find(toLocal(offset));
+    if (_pendingBlobWrites.end() == itr) {
+        return false;
+    }
+    if (false ==  itr->second.pendingBlobReads.empty()) {
+        return false;
+    }
+    req.blob.blobInfo.path = _path;
+    req.blob.objects.clear();
+    AwaitingBlobWrite awaiting;
+    awaiting.numObjects = itr->second.numObjects;
+    for (auto const& o : itr->second.offsetStatus) {
+        if (false == o.second.isStable) {
+            return false;
+        } else if ((nullptr != o.second.updateChain) && (!o.second.updateChain->empty())) {
+            return false;
+        }
+        ObjectDescriptor od;
+        od.objectId = o.second.id;
+        od.length = _objectSize;
+        for (ObjectOffsetVal i = 0; i < o.second.numObjects; ++i) {
+            req.blob.objects.emplace_hint(req.blob.objects.end(), toGlobal(o.first + i), od);
+        }
+        // Committed extents are in volume offsets, so one per region
+        auto next = o.first;
+        auto const last = o.first + o.second.numObjects - 1;
+        while (next <= last) {
+            auto extentEnd = last;
+            if (0 != _regionObjects) {
+                extentEnd = std::min(last, ((next / _regionObjects) + 1) * _regionObjects - 1);
             }
-            AwaitingBlobWrite awaiting;
-            awaiting.numObjects = itr->second.numObjects;
-            _awaitingBlobWrites.emplace(itr->first, std::move(awaiting));
-            queue = std::move(itr->second.pendingTasks);
-            _pendingBlobWrites.erase(itr);
-            return true;
+            awaiting.committed.push_back(ObjectExtent{toGlobal(next), extentEnd - next + 1, o.second.id});
+            next = extentEnd + 1;
         }
-        ++itr;
     }
-    return false;
+    _awaitingBlobWrites.emplace(itr->first, std::move(awaiting));
+    queue = std::move(itr->second.pendingTasks);
+    _pendingBlobWrites.erase(itr);
+    return true;
 }
 
 bool WriteContext::failWriteBlobRequest(ObjectOffsetVal const& offset, PendingTasks& queue) {
-    auto itr = _pendingBlobWrites.begin();
-    while (_pendingBlobWrites.end() != itr) {
-        if ((offset >= itr->first) && (offset < itr->first + itr->second.numObjects)) {
-            queue = std::move(itr->second.pendingTasks);
-            // Any pendingBlobRead tasks will need to be failed as well
-            for (auto& t : itr->second.pendingBlobReads) {
-                queue.push(t);
-            }
-            _pendingBlobWrites.erase(itr);
-            return true;
-        }
-        ++itr;
+    auto itr = _pendingBlobWrites.find(toLocal(offset));
+    if (_pendingBlobWrites.end() == itr) {
+        return false;
     }
-    return false;
+    queue = std::move(itr->second.pendingTasks);
+    // Any pendingBlobRead tasks will need to be failed as well
+    for (auto& t : itr->second.pendingBlobReads) {
+        queue.push(t);
+    }
+    _pendingBlobWrites.erase(itr);
+    return true;
 }
 
-WriteContext::QueueResult WriteContext::queue_update(ObjectOffsetVal const& offset, RequestHandle handle) {
-   auto b_itr = _pendingBlobWrites.begin();
-   while (_pendingBlobWrites.end() != b_itr) {
-       if ((offset >= b_itr->first) && (offset < b_itr->first + b_itr->second.numObjects)) {
-           auto off_itr = b_itr->second.offsetStatus.find(offset);
-           if (b_itr->second.offsetStatus.end() != off_itr) {
-               if (nullptr == off_itr->second.updateChain) {
-                   off_itr->second.updateChain.reset(new std::queue<RequestHandle>());
-                   off_itr->second.hasPendingWrite = true;
-                   return QueueResult::FirstEntry;
-               } else if ((false == off_itr->second.hasPendingWrite) && (true == off_itr->second.updateChain->empty())) {
-                   off_itr->second.updateChain->push(handle);
-                   off_itr->second.hasPendingWrite = true;
-                   return QueueResult::UpdateStable;
-               } else {
-                   off_itr->second.updateChain->push(handle);
-                   return QueueResult::AddedEntry;
-               }
-           } else {
-               LOGERROR("offset:{} missing", offset);
-               return QueueResult::Failure;
-           }
+WriteContext::QueueResult WriteContext::queue_update(ObjectOffsetVal const& globalOffset, RequestHandle handle) {
+   auto const offset = toLocal(globalOffset);
+   auto status = findOffsetStatus(offset);
+   if (nullptr == status) {
+       LOGERROR("offset:{} missing", globalOffset);
+       return QueueResult::Failure;
+   }
+   auto off_itr = isolateRange(*status, offset, offset);
+   if (status->end() == off_itr) {
+       LOGERROR("offset:{} missing", globalOffset);
+       return QueueResult::Failure;
+   }
+   if (nullptr == off_itr->second.updateChain) {
+       off_itr->second.updateChain.reset(new std::queue<RequestHandle>());
+       off_itr->second.hasPendingWrite = true;
+       return QueueResult::FirstEntry;
+   } else if ((false == off_itr->second.hasPendingWrite) && (true == off_itr->second.updateChain->empty())) {
+       off_itr->second.updateChain->push(handle);
+       off_itr->second.hasPendingWrite = true;
+       return QueueResult::UpdateStable;
+   } else {
+       off_itr->second.updateChain->push(handle);
+       return QueueResult::AddedEntry;
+   }
+}
+
+WriteContext::QueueResult WriteContext::queue_update
+(
+  ObjectOffsetVal const&      start,
+  ObjectOffsetVal const&      end,
+  RequestHandle               handle
+)
+{
+   auto const startOffset = toLocal(start);
+   auto const endOffset = toLocal(end);
+   auto status = findOffsetStatus(startOffset);
+   if (nullptr == status) {
+       LOGERROR("offset:{} missing", start);
+       return QueueResult::Failure;
+   }
+   auto first = isolateRange(*status, startOffset, endOffset);
+   auto next = startOffset;
+   for (auto off_itr = first; (status->end() != off_itr) && (off_itr->first <= endOffset); ++off_itr) {
+       if ((next != off_itr->first) || (nullptr != off_itr->second.updateChain)) {
+           LOGERROR("handle:{} offset:{} already has an update", handle.handle, toGlobal(next));
+           return QueueResult::Failure;
        }
-       ++b_itr;
+       next = OffsetStatus::lastOffset(off_itr) + 1;
+   }
+   if (next <= endOffset) {
+       LOGERROR("offset:{} missing", toGlobal(next));
+       return QueueResult::Failure;
+   }
+   for (auto off_itr = first; (status->end() != off_itr) && (off_itr->first <= endOffset); ++off_itr) {
+       off_itr->second.updateChain.reset(new std::queue<RequestHandle>());
+       off_itr->second.hasPendingWrite = true;
    }
-   LOGERROR("offset:{} missing", offset);
-   return QueueResult::Failure;
+   return QueueResult::FirstEntry;
 }
 
-std::pair<bool, RequestHandle> WriteContext::pop(ObjectOffsetVal const& offset) {
+std::pair<bool, RequestHandle> WriteContext::pop(ObjectOffsetVal const& globalOffset) {
    static std::pair<bool, RequestHandle> const no = {false, RequestHandle()};
-   auto itr = _pendingBlobWrites.begin();
-   while (_pendingBlobWrites.end() != itr) {
-      if ((offset >= itr->first) && (offset < itr->first + itr->second.numObjects)) {
-          auto off_itr = itr->second.offsetStatus.find(offset);
-          if ((itr->second.offsetStatus.end() != off_itr) && (nullptr != off_itr->second.updateChain)) {
-              if (!off_itr->second.updateChain->empty()) {
-                  auto val = off_itr->second.updateChain->front();
-                  off_itr->second.updateChain->pop();
-                  return std::make_pair(true, val);
-              }
-          } else {
-              LOGERROR("offset:{} missing", offset);
-              return no;
-          }
-       }
-      ++itr;
-    }
-    return no;
+   auto const offset = toLocal(globalOffset);
+   auto status = findOffsetStatus(offset);
+   if (nullptr == status) {
+       return no;
+   }
+   auto off_itr = status->find(offset);
+   if ((status->end() == off_itr) || (nullptr == off_itr->second.updateChain)) {
+       LOGERROR("offset:{} missing", globalOffset);
+       return no;
+   }
+   if (off_itr->second.updateChain->empty()) {
+       return no;
+   }
+   off_itr = isolateRange(*status, offset, offset);
+   auto val = off_itr->second.updateChain->front();
+   off_itr->second.updateChain->pop();
+   return std::make_pair(true, val);
 }
 
 void WriteContext::completeBlobWrite(ObjectOffsetVal const& offset, PendingTasks& queue) {
-   auto awaitingItr = _awaitingBlobWrites.begin();
-   while (_awaitingBlobWrites.end() != awaitingItr) {
-      if ((awaitingItr->first <= offset) && (awaitingItr->first + awaitingItr->second.numObjects > offset)) {
-          queue.swap(awaitingItr->second.pendingTasks);
-          _awaitingBlobWrites.erase(awaitingItr);
-          return;
-      }
-      ++awaitingItr;
+   ObjectExtents committed;
+   completeBlobWrite(offset, queue, committed);
+}
+
+void WriteContext::completeBlobWrite(ObjectOffsetVal const& offset, PendingTasks& queue, ObjectExtents& committed) {
+   auto awaitingItr = _awaitingBlobWrites.find(toLocal(offset));
+   if (_awaitingBlobWrites.end() != awaitingItr) {
+       queue.swap(awaitingItr->second.pendingTasks);
+       committed.swap(awaitingItr->second.committed);
+       _awaitingBlobWrites.erase(awaitingItr);
    }
 }
 
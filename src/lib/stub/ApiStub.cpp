@@ -141,78 +141,122 @@ void ApiStub::listAllVolumes(Request const& requestId, ListAllVolumesRequest con
     }
 }
 
-AsyncApiStub::AsyncApiStub(std::shared_ptr<FdsStub> stub, uint32_t delay) : ApiStub(stub, delay)
+AsyncApiStub::AsyncApiStub(std::shared_ptr<FdsStub> stub, uint32_t delay, uint32_t threads) : ApiStub(stub, delay)
 {
+    for (uint32_t i = 0; i < threads; ++i) {
+        _workers.emplace_back(&AsyncApiStub::run, this);
+    }
+}
+
+AsyncApiStub::~AsyncApiStub() {
+    {
+        std::lock_guard<std::mutex> lg(_callsLock);
+        _stopping = true;
+    }
+    _callsCv.notify_all();
+    for (auto& w : _workers) {
+        w.join();
+    }
+}
+
+void AsyncApiStub::dispatch(std::function<void()>&& call) {
+    if (true == _workers.empty()) {
+        std::thread t(std::move(call));
+        t.detach();
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lg(_callsLock);
+        _calls.push(std::move(call));
+    }
+    _callsCv.notify_one();
+}
+
+void AsyncApiStub::waitIdle() {
+    std::unique_lock<std::mutex> l(_callsLock);
+    _idleCv.wait(l, [this] { return (0 == _running) && (true == _calls.empty()); });
+}
+
+// Completion thread, runs queued calls until stopped and drained
+void AsyncApiStub::run() {
+    while (true) {
+        std::function<void()> call;
+        {
+            std::unique_lock<std::mutex> l(_callsLock);
+            _callsCv.wait(l, [this] { return (true == _stopping) || (false == _calls.empty()); });
+            if (true == _calls.empty()) return;
+            call = std::move(_calls.front());
+            _calls.pop();
+            ++_running;
+        }
+        call();
+        {
+            std::lock_guard<std::mutex> lg(_callsLock);
+            if ((0 == --_running) && (true == _calls.empty())) {
+                _idleCv.notify_all();
+            }
+        }
+    }
 }
 
 void AsyncApiStub::list(Request const& requestId, ListBlobsRequest const& request) {
-    std::thread t([this, requestId, request]() {
+    dispatch([this, requestId, request]() {
         ApiStub::list(requestId, request);
     });
-    t.detach();
 }
 
 void AsyncApiStub::readBlob(Request const& requestId, ReadBlobRequest const& request) {
-    std::thread t([this, requestId, request]() {
+    dispatch([this, requestId, request]() {
         ApiStub::readBlob(requestId, request);
     });
-    t.detach();
 }
 
 void AsyncApiStub::writeBlob(Request const& requestId, WriteBlobRequest const& request) {
-    std::thread t([this, requestId, request]() {
+    dispatch([this, requestId, request]() {
         ApiStub::writeBlob(requestId, request);
     });
-    t.detach();
 }
 
 void AsyncApiStub::upsertBlobMetadataCas(Request const& requestId, UpsertBlobMetadataCasRequest const& request) {
-    std::thread t([this, requestId, request]() {
+    dispatch([this, requestId, request]() {
         ApiStub::upsertBlobMetadataCas(requestId, request);
     });
-    t.detach();
 }
 
 void AsyncApiStub::upsertBlobObjectCas(Request const& requestId, UpsertBlobObjectCasRequest const& request) {
-    std::thread t([this, requestId, request]() {
+    dispatch([this, requestId, request]() {
         ApiStub::upsertBlobObjectCas(requestId, request);
     });
-    t.detach();
 }
 
 void AsyncApiStub::readObject(Request const& requestId, ReadObjectRequest const& request) {
-    std::thread t([this, requestId, request]() {
+    dispatch([this, requestId, request]() {
         ApiStub::readObject(requestId, request);
     });
-    t.detach();
 }
 
 void AsyncApiStub::writeObject(Request const& requestId, WriteObjectRequest const& request) {
-    std::thread t([this, requestId, request]() {
+    dispatch([this, requestId, request]() {
         ApiStub::writeObject(requestId, request);
     });
-    t.detach();
 }
 
 void AsyncApiStub::deleteBlob(Request const& requestId, BlobPath const& target) {
-    std::thread t([this, requestId, target]() {
+    dispatch([this, requestId, target]() {
         ApiStub::deleteBlob(requestId, target);
     });
-    t.detach();
 }
 
 void AsyncApiStub::statVolume(Request const& requestId, VolumeId const volumeId) {
-    std::thread t([this, requestId, volumeId]() {
+    dispatch([this, requestId, volumeId]() {
         ApiStub::statVolume(requestId, volumeId);
     });
-    t.detach();
 }
 
 void AsyncApiStub::listAllVolumes(Request const& requestId, ListAllVolumesRequest const& request) {
-    std::thread t([this, requestId, request]() {
+    dispatch([this, requestId, request]() {
         ApiStub::listAllVolumes(requestId, request);
     });
-    t.detach();
 }
 
 } // namespace xdi
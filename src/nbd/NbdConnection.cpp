@@ -35,6 +35,7 @@ extern "C" {
 
 #include <ev++.h>
 
+#include "connector/block/TaskPool.h"
 #include "connector/block/Tasks.h"
 #include "connector/nbd/NbdConnector.h"
 #include "xdi/ApiResponseInterface.h"
@@ -46,19 +47,38 @@ static constexpr uint8_t NBD_MAGIC[]    = { 0x49, 0x48, 0x41, 0x56, 0x45, 0x4F,
 static constexpr char    NBD_MAGIC_PWD[]  {'N', 'B', 'D', 'M', 'A', 'G', 'I', 'C'};  // NOLINT
 static constexpr uint8_t NBD_REQUEST_MAGIC[]    = { 0x25, 0x60, 0x95, 0x13 };
 static constexpr uint8_t NBD_RESPONSE_MAGIC[]   = { 0x67, 0x44, 0x66, 0x98 };
-static constexpr uint8_t NBD_PROTO_VERSION[]    = { 0x00, 0x01 };
+// Handshake flags: NBD_FLAG_FIXED_NEWSTYLE | NBD_FLAG_NO_ZEROES
+static constexpr uint8_t NBD_PROTO_VERSION[]    = { 0x00, 0x03 };
+static constexpr uint32_t NBD_FLAG_C_FIXED_NEWSTYLE = 0b01;
+static constexpr uint32_t NBD_FLAG_C_NO_ZEROES  = 0b10;
+static constexpr uint64_t NBD_OPT_REPLY_MAGIC   = 0x3e889045565a9ull;
 static constexpr int32_t NBD_OPT_EXPORT         = 1;
+static constexpr int32_t NBD_OPT_ABORT          = 2;
+static constexpr int32_t NBD_OPT_INFO           = 6;
+static constexpr int32_t NBD_OPT_GO             = 7;
+static constexpr uint32_t NBD_REP_ACK           = 1;
+static constexpr uint32_t NBD_REP_INFO          = 3;
+static constexpr uint32_t NBD_REP_ERR_UNSUP     = (1u << 31) + 1;
+static constexpr uint32_t NBD_REP_ERR_INVALID   = (1u << 31) + 3;
+static constexpr uint32_t NBD_REP_ERR_UNKNOWN   = (1u << 31) + 6;
+static constexpr uint16_t NBD_INFO_EXPORT       = 0;
+static constexpr uint16_t NBD_INFO_BLOCK_SIZE   = 3;
 static constexpr int16_t NBD_FLAG_HAS_FLAGS     = 0b000001;
 static constexpr int16_t NBD_FLAG_READ_ONLY     = 0b000010;
 static constexpr int16_t NBD_FLAG_SEND_FLUSH    = 0b000100;
 static constexpr int16_t NBD_FLAG_SEND_FUA      = 0b001000;
 static constexpr int16_t NBD_FLAG_ROTATIONAL    = 0b010000;
 static constexpr int16_t NBD_FLAG_SEND_TRIM     = 0b100000;
-static constexpr int32_t NBD_CMD_READ           = 0;
-static constexpr int32_t NBD_CMD_WRITE          = 1;
-static constexpr int32_t NBD_CMD_DISC           = 2;
-static constexpr int32_t NBD_CMD_FLUSH          = 3;
-static constexpr int32_t NBD_CMD_TRIM           = 4;
+static constexpr int16_t NBD_FLAG_SEND_WRITE_ZEROES = 0b1000000;
+static constexpr int16_t NBD_FLAG_CAN_MULTI_CONN = 0b100000000;
+static constexpr uint16_t NBD_CMD_READ          = 0;
+static constexpr uint16_t NBD_CMD_WRITE         = 1;
+static constexpr uint16_t NBD_CMD_DISC          = 2;
+static constexpr uint16_t NBD_CMD_FLUSH         = 3;
+static constexpr uint16_t NBD_CMD_TRIM          = 4;
+static constexpr uint16_t NBD_CMD_WRITE_ZEROES  = 6;
+static constexpr uint16_t NBD_CMD_FLAG_FUA      = 0b01;
+static constexpr uint16_t NBD_CMD_FLAG_NO_HOLE  = 0b10;
 /// ******************************************
 
 
@@ -68,6 +88,10 @@ static constexpr size_t Ki = 1024;
 static constexpr size_t Mi = Ki * Ki;
 static constexpr size_t Gi = Ki * Mi;
 static constexpr ssize_t max_block_size = 8 * Mi;
+// Responded tasks kept for new requests
+static constexpr size_t nbd_pooled_tasks = 256;
+// Smallest request we ask clients to send, a sector
+static constexpr uint32_t min_block_size = 512;
 /// ******************************************
 
 template<typename T>
@@ -77,8 +101,33 @@ constexpr auto to_iovec(T* t) -> typename std::remove_cv<T>::type*
 static constexpr bool ensure(bool b)
 { return (!b ? throw fds::block::BlockError::connection_closed : true); }
 
-static std::array<std::string, 5> const io_to_string = {
-    { "READ", "WRITE", "DISCONNECT", "FLUSH", "TRIM" }
+// Connections to a volume share its BlockOperations engine, a client
+// may stripe its requests across several of them. Trims and zeroes turn
+// into unmaps, zeroes that may not leave holes into write sames of a zero
+// byte, no zeros are sent over the wire. Writes are only acknowledged once
+// committed, a flush waits for all of them.
+static constexpr int16_t transmission_flags =
+    NBD_FLAG_HAS_FLAGS | NBD_FLAG_SEND_FLUSH | NBD_FLAG_SEND_FUA |
+    NBD_FLAG_SEND_TRIM | NBD_FLAG_SEND_WRITE_ZEROES | NBD_FLAG_CAN_MULTI_CONN;
+
+// Append v to the message in network byte order
+static void put_be16(std::string& s, uint16_t const v)
+{ auto n = htons(v); s.append(reinterpret_cast<char const*>(&n), sizeof(n)); }
+
+static void put_be32(std::string& s, uint32_t const v)
+{ auto n = htonl(v); s.append(reinterpret_cast<char const*>(&n), sizeof(n)); }
+
+static void put_be64(std::string& s, uint64_t const v)
+{ auto n = __builtin_bswap64(v); s.append(reinterpret_cast<char const*>(&n), sizeof(n)); }
+
+static uint16_t get_be16(char const* p)
+{ uint16_t n; memcpy(&n, p, sizeof(n)); return ntohs(n); }
+
+static uint32_t get_be32(char const* p)
+{ uint32_t n; memcpy(&n, p, sizeof(n)); return ntohl(n); }
+
+static std::array<std::string, 7> const io_to_string = {
+    { "READ", "WRITE", "DISCONNECT", "FLUSH", "TRIM", "CACHE", "WRITE_ZEROES" }
 };
 
 static std::array<std::string, 6> const state_to_string = {
@@ -229,7 +278,9 @@ bool NbdConnection::handshake_start(ev::io&) {
 bool NbdConnection::handshake_complete(ev::io &watcher) {
     if (!get_message_header(watcher.fd, handshake))
         return false;
-    ensure(0 == handshake.header.ack);
+    auto flags = ntohl(handshake.header.flags);
+    ensure(0 == (flags & ~(NBD_FLAG_C_FIXED_NEWSTYLE | NBD_FLAG_C_NO_ZEROES)));
+    no_zeroes = (0 != (flags & NBD_FLAG_C_NO_ZEROES));
     return true;
 }
 
@@ -239,54 +290,136 @@ void NbdConnection::option_request(ev::io &watcher) {
             return;
         ensure(0 == memcmp(NBD_MAGIC, attach.header.magic, sizeof(NBD_MAGIC)));
         attach.header.optSpec = ntohl(attach.header.optSpec);
-        ensure(NBD_OPT_EXPORT == attach.header.optSpec);
         attach.header.length = ntohl(attach.header.length);
 
         // Just for sanities sake and protect against bad data
+        ensure(0 <= attach.header.length);
         ensure(attach.data.size() >= static_cast<size_t>(attach.header.length));
     }
-    if (!get_message_payload(watcher.fd, attach))
+    if ((0 < attach.header.length) && !get_message_payload(watcher.fd, attach))
         return;
+    attach.header_off = 0;
+    attach.data_off = -1;
+
+    LOGDEBUG("option:{} length:{}", attach.header.optSpec, attach.header.length);
+    option_buffer.clear();
+    option_next = NbdProtoState::AWAITOPTS;
+    switch (attach.header.optSpec) {
+        case NBD_OPT_EXPORT:
+            option_export_name();
+            break;
+        case NBD_OPT_ABORT:
+            queue_option_reply(NBD_REP_ACK);
+            option_next = NbdProtoState::INVALID;
+            break;
+        case NBD_OPT_INFO:
+        case NBD_OPT_GO:
+            option_info(NBD_OPT_GO == attach.header.optSpec);
+            break;
+        default:
+            queue_option_reply(NBD_REP_ERR_UNSUP);
+            break;
+    }
+    nbd_state = NbdProtoState::SENDOPTS;
+    asyncWatcher->send();
+}
 
+// The old way to pick the export, answered with the export's size and flags
+// and no way to report an error other than closing the connection
+void NbdConnection::option_export_name() {
     // In case volume name is not NULL terminated.
     auto volumeName = std::string(attach.data.begin(),
                                   attach.data.begin() + attach.header.length);
     try {
         auto vol_desc = nbd_server->lookupVolume(volumeName);
         object_size = vol_desc->maxObjectSize;
-        volume_size = __builtin_bswap64(vol_desc->capacity * Mi);
+        volume_size = vol_desc->capacity * Mi;
         LOGINFO("vol:{} capacity:{} objsize:{} attached to volume", volumeName, volume_size, object_size);
-        nbd_state = NbdProtoState::SENDOPTS;
         init(volumeName, vol_desc->volumeId, object_size);
     } catch (std::runtime_error& e) {
         LOGWARN("vol:{} error:{} could not attach", volumeName, e.what());
         throw fds::block::BlockError::connection_closed;
     }
-    asyncWatcher->send();
+
+    put_be64(option_buffer, volume_size);
+    put_be16(option_buffer, transmission_flags);
+    if (false == no_zeroes) {
+        option_buffer.append(124, '\0');
+    }
+    option_next = NbdProtoState::DOREQS;
 }
 
-bool
-NbdConnection::option_reply(ev::io&) {
-    static char const zeros[124]{0};  // NOLINT
-    static int16_t const optFlags =
-        ntohs(NBD_FLAG_HAS_FLAGS);
-    static iovec const vectors[] = {
-        { nullptr,             sizeof(volume_size) },
-        { to_iovec(&optFlags), sizeof(optFlags)    },
-        { to_iovec(zeros),     sizeof(zeros)       },
-    };
+// Describe the export, and for NBD_OPT_GO attach to it. The block sizes are
+// always sent so clients line their requests up with our objects.
+void NbdConnection::option_info(bool const go) {
+    auto const data = attach.data.data();
+    size_t const length = attach.header.length;
+    uint32_t const nameLength = (sizeof(uint32_t) <= length) ? get_be32(data) : 0;
+    size_t const requests = sizeof(uint32_t) + nameLength;
+    if ((length < requests + sizeof(uint16_t)) ||
+        (length != requests + sizeof(uint16_t) + (get_be16(data + requests) * sizeof(uint16_t)))) {
+        queue_option_reply(NBD_REP_ERR_INVALID);
+        return;
+    }
 
-    // Verify we got a valid volume size from attach
-    if (0 == volume_size) {
-        throw fds::block::BlockError::connection_closed;
+    auto volumeName = std::string(data + sizeof(uint32_t), nameLength);
+    NbdConnector::volume_ptr vol_desc;
+    try {
+        vol_desc = nbd_server->lookupVolume(volumeName);
+    } catch (std::runtime_error& e) {
+        LOGWARN("vol:{} error:{} unknown export", volumeName, e.what());
+        queue_option_reply(NBD_REP_ERR_UNKNOWN);
+        return;
+    }
+    uint64_t const size = vol_desc->capacity * Mi;
+    uint32_t const objectSize = vol_desc->maxObjectSize;
+
+    // Preferred size has to be a power of two no larger than the maximum
+    uint32_t preferred = min_block_size;
+    while ((preferred * 2 <= objectSize) && (preferred * 2 <= max_block_size)) {
+        preferred *= 2;
     }
 
+    std::string info;
+    put_be16(info, NBD_INFO_EXPORT);
+    put_be64(info, size);
+    put_be16(info, transmission_flags);
+    queue_option_reply(NBD_REP_INFO, info);
+    info.clear();
+    put_be16(info, NBD_INFO_BLOCK_SIZE);
+    put_be32(info, min_block_size);
+    put_be32(info, preferred);
+    put_be32(info, max_block_size);
+    queue_option_reply(NBD_REP_INFO, info);
+
+    if (go) {
+        object_size = objectSize;
+        volume_size = size;
+        LOGINFO("vol:{} capacity:{} objsize:{} attached to volume", volumeName, volume_size, object_size);
+        init(volumeName, vol_desc->volumeId, object_size);
+    }
+    queue_option_reply(NBD_REP_ACK);
+    option_next = go ? NbdProtoState::DOREQS : NbdProtoState::AWAITOPTS;
+}
+
+// Append a reply to the current option, they are all sent once the option
+// has been handled
+void NbdConnection::queue_option_reply(uint32_t const type, std::string const& data) {
+    put_be64(option_buffer, NBD_OPT_REPLY_MAGIC);
+    put_be32(option_buffer, attach.header.optSpec);
+    put_be32(option_buffer, type);
+    put_be32(option_buffer, data.size());
+    option_buffer.append(data);
+}
+
+bool
+NbdConnection::option_reply(ev::io&) {
     if (!response) {
         write_offset = 0;
-        total_blocks = std::extent<decltype(vectors)>::value;
+        total_blocks = 1;
         response = resp_vector_type(new iovec[total_blocks]);
-        memcpy(response.get(), vectors, sizeof(vectors));
-        response[0].iov_base = &volume_size;
+        response[0].iov_base = &option_buffer[0];
+        response[0].iov_len = option_buffer.size();
     }
 
     // Try and write the response, if it fails to write ALL
@@ -304,18 +437,23 @@ bool NbdConnection::io_request(ev::io &watcher) {
         if (!get_message_header(watcher.fd, request))
             return false;
         ensure(0 == memcmp(NBD_REQUEST_MAGIC, request.header.magic, sizeof(NBD_REQUEST_MAGIC)));
-        request.header.opType = ntohl(request.header.opType);
+        request.header.flags = ntohs(request.header.flags);
+        request.header.opType = ntohs(request.header.opType);
         request.header.offset = __builtin_bswap64(request.header.offset);
         request.header.length = ntohl(request.header.length);
+        ensure(io_to_string.size() > request.header.opType);
 
-        if (max_block_size < request.header.length) {
+        // Trims and zeroes carry no payload, they may cover any range
+        bool const payload = (NBD_CMD_READ == request.header.opType) ||
+                             (NBD_CMD_WRITE == request.header.opType);
+        if ((true == payload) && (max_block_size < request.header.length)) {
             LOGWARN("blocksize:{} maxblocksize:{} client used larger blocksize than supported", request.header.length, max_block_size);
             throw fds::block::BlockError::shutdown_requested;
         }
 
         // Construct Buffer for Write Payload
         if (NBD_CMD_WRITE == request.header.opType) {
-            request.data = std::make_shared<std::string>(request.header.length, '\0');
+            allocateWriteBuffers(request.header.offset, request.header.length, request.data);
         }
     }
 
@@ -326,14 +464,15 @@ bool NbdConnection::io_request(ev::io &watcher) {
     request.header_off = 0;
     request.data_off = -1;
 
-    LOGTRACE("op:{} handle:{} offset:{} length:{}",
+    LOGTRACE("op:{} flags:{} handle:{} offset:{} length:{}",
             io_to_string[request.header.opType],
+            request.header.flags,
             request.header.handle,
             request.header.offset,
             request.header.length);
 
     dispatchOp();
-    request.data.reset();
+    request.data.clear();
     return true;
 }
 
@@ -375,10 +514,11 @@ NbdConnection::io_reply(ev::io&) {
             while (buf != NULL) {
                 LOGDEBUG("handle:{} size:{} buffer:{}",
                         current_response->handle,
-                        buf->length(),
+                        buf->size(),
                         context);
-                response[total_blocks].iov_base = to_iovec(buf->c_str());
-                response[total_blocks].iov_len = buf->length();
+                // Straight from the object buffers, trimmed reads included
+                response[total_blocks].iov_base = to_iovec(buf->data());
+                response[total_blocks].iov_len = buf->size();
                 ++total_blocks;
                 // get next buffer
                 buf = current_response->getNextReadBuffer(context);
@@ -393,37 +533,84 @@ NbdConnection::io_reply(ev::io&) {
         return false;
     }
     response[2].iov_base = nullptr;
-    current_response.reset();
+    if (free_tasks.size() < nbd_pooled_tasks) {
+        current_response->reset(0);
+        free_tasks.push_back(std::move(current_response));
+    } else {
+        current_response.reset();
+    }
 
     return true;
 }
 
+NbdTask*
+NbdConnection::newTask(uint64_t const handle) {
+    if (free_tasks.empty()) {
+        return new NbdTask(handle);
+    }
+    auto task = free_tasks.back().release();
+    free_tasks.pop_back();
+    task->reset(handle);
+    return task;
+}
+
 void
 NbdConnection::dispatchOp() {
     auto& handle = request.header.handle;
     auto& offset = request.header.offset;
     auto& length = request.header.length;
+    bool const fua = (0 != (request.header.flags & NBD_CMD_FLAG_FUA));
 
     switch (request.header.opType) {
         case NBD_CMD_READ:
             {
-                auto ptask = new NbdTask(handle);
-                auto task = new fds::block::ReadTask(ptask);
+                auto ptask = newTask(handle);
+                auto task = getTaskPool()->getRead(ptask);
                 task->set(offset, length);
                 executeTask(task);
             }
             break;
         case NBD_CMD_WRITE:
             {
-                assert(request.data);
-                auto ptask = new NbdTask(handle);
-                auto task = new fds::block::WriteTask(ptask);
+                assert(false == request.data.empty());
+                auto ptask = newTask(handle);
+                auto task = getTaskPool()->getWrite(ptask);
                 task->set(offset, length);
-                task->setWriteBuffer(request.data);
+                task->setWriteBuffers(std::move(request.data));
+                task->setFua(fua);
                 executeTask(task);
             }
             break;
+        case NBD_CMD_TRIM:
+        case NBD_CMD_WRITE_ZEROES:
+            {
+                auto ptask = newTask(handle);
+                if (0 == length) {
+                    readyResponses.push(ptask);
+                    break;
+                }
+                if ((NBD_CMD_WRITE_ZEROES == request.header.opType) &&
+                    (0 != (request.header.flags & NBD_CMD_FLAG_NO_HOLE))) {
+                    // The range has to stay provisioned, the zero objects
+                    // are written rather than committed as holes
+                    auto task = getTaskPool()->getWriteSame(ptask);
+                    auto zeros = getBufferPool()->zeroed(1);
+                    task->set(offset, length);
+                    task->setWriteBuffer(zeros);
+                    task->setFua(fua);
+                    task->setNoHole(true);
+                    executeTask(task);
+                } else {
+                    fds::block::UnmapTask::unmap_vec_ptr ranges(new fds::block::UnmapTask::unmap_vec);
+                    ranges->push_back(fds::block::UnmapTask::UnmapRange{static_cast<uint64_t>(offset), length});
+                    auto task = new fds::block::UnmapTask(ptask, std::move(ranges));
+                    task->setFua(fua);
+                    executeTask(task);
+                }
+            }
+            break;
         case NBD_CMD_FLUSH:
+            executeTask(new fds::block::FlushTask(newTask(handle)));
             break;
         case NBD_CMD_DISC:
             LOGINFO("got disconnect");
@@ -496,8 +683,13 @@ NbdConnection::ioEvent(ev::io &watcher, int revents) {
                 break;
             case NbdProtoState::SENDOPTS:
                 if (option_reply(watcher)) {
-                    nbd_state = NbdProtoState::DOREQS;
-                    LOGDEBUG("done with NBD handshake");
+                    nbd_state = option_next;
+                    if (NbdProtoState::DOREQS == nbd_state) {
+                        LOGDEBUG("done with NBD handshake");
+                    } else if (NbdProtoState::INVALID == nbd_state) {
+                        LOGINFO("client aborted option negotiation");
+                        throw fds::block::BlockError::shutdown_requested;
+                    }
                 }
                 break;
             case NbdProtoState::DOREQS:
@@ -518,8 +710,7 @@ NbdConnection::ioEvent(ev::io &watcher, int revents) {
 void
 NbdConnection::respondTask(fds::block::BlockTask* response) {
     auto task = static_cast<NbdTask*>(response->getProtoTask());
-    fds::block::TaskVisitor v;
-    if (fds::block::TaskType::READ == response->match(&v)) {
+    if (fds::block::TaskType::READ == response->getType()) {
         auto btask = static_cast<fds::block::ReadTask*>(response);
         task->setRead();
         btask->swapReadBuffers(task->getBufVec());
@@ -551,8 +742,27 @@ ssize_t read_from_socket(int fd, std::array<char, 1024>& buffer, ssize_t off, ss
 { return retry_read(fd, buffer.data() + off, len); }
 
 template<>
-ssize_t read_from_socket(int fd, std::shared_ptr<std::string>& buffer, ssize_t off, ssize_t len)
-{ return retry_read(fd, &(*buffer)[0] + off, len); }
+ssize_t read_from_socket(int fd, std::vector<std::shared_ptr<std::string>>& buffers, ssize_t off, ssize_t)
+{
+    // Scatter the rest of the payload over the buffers, off is the amount
+    // already read
+    std::vector<iovec> iov;
+    iov.reserve(buffers.size());
+    for (auto& b : buffers) {
+        ssize_t size = b->size();
+        if (off >= size) {
+            off -= size;
+            continue;
+        }
+        iov.push_back(iovec{&(*b)[0] + off, static_cast<size_t>(size - off)});
+        off = 0;
+    }
+    ssize_t e = 0;
+    do {
+        e = readv(fd, iov.data(), std::min(iov.size(), static_cast<size_t>(IOV_MAX)));
+    } while ((0 > e) && (EINTR == errno));
+    return e;
+}
 
 template<typename D>
 bool nbd_read(int fd, D& data, ssize_t& off, ssize_t const len)
@@ -19,12 +19,15 @@
 
 #include "connector/nbd/NbdConnector.h"
 
+#include <algorithm>
+#include <cstring>
 #include <set>
 #include <string>
 #include <thread>
 
 extern "C" {
 #include <fcntl.h>
+#include <sched.h>
 #include <arpa/inet.h>
 #include <netinet/tcp.h>
 #include <sys/socket.h>
@@ -33,7 +36,7 @@ extern "C" {
 
 #include <ev++.h>
 
-#include "connector/nbd/NbdConnection.h"
+#include "connector/nbd/NbdReactor.h"
 #include "connector/nbd/nbd_log.h"
 
 namespace xdi {
@@ -78,8 +81,8 @@ NbdConnector::NbdConnector(std::shared_ptr<xdi::ApiInterface> api)
 void NbdConnector::startShutdown() {
     std::lock_guard<std::mutex> g(connection_lock);
     stopping = true;
-    for (auto& connection_pair : connection_map) {
-        connection_pair.second->terminate();
+    for (auto& reactor : reactors) {
+        reactor->terminate();
     }
     asyncWatcher->send();
 }
@@ -92,6 +95,9 @@ void NbdConnector::initialize() {
     if (0 <= nbdSocket)
         { reset(); }
 
+    if (true == reactors.empty())
+        { startReactors(); }
+
     // Bind to NBD listen port
     nbdSocket = createNbdSocket();
     if (nbdSocket < 0) {
@@ -131,13 +137,49 @@ void NbdConnector::initialize() {
     }
 }
 
+// Start the event loops, pinned to the CPUs we may run on in turn
+void NbdConnector::startReactors() {
+    std::vector<int> cpus;
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (0 == sched_getaffinity(0, sizeof(allowed), &allowed)) {
+        for (int cpu = 0; CPU_SETSIZE > cpu; ++cpu) {
+            if (CPU_ISSET(cpu, &allowed)) cpus.push_back(cpu);
+        }
+    }
+    auto loops = cfg_loops;
+    if (0 == loops) {
+        loops = std::max(1lu, (cpus.empty() ? std::thread::hardware_concurrency() : cpus.size()));
+    }
+    for (uint32_t i = 0; loops > i; ++i) {
+        auto cpu = ((true == cfg_pin_loops) && (false == cpus.empty())) ? cpus[i % cpus.size()] : -1;
+        reactors.emplace_back(std::make_shared<NbdReactor>(this, api_, cpu));
+        reactors.back()->start();
+    }
+    LOGINFO("loops:{} pinned:{} started NBD event loops", loops, cfg_pin_loops);
+}
+
+// The loop to run a new connection on, ties in load go round-robin
+NbdReactor& NbdConnector::pickReactor() {
+    auto const count = reactors.size();
+    auto const first = next_reactor++ % count;
+    auto picked = first;
+    if (LoopPolicy::LEAST_LOADED == cfg_loop_policy) {
+        for (size_t i = 1; count > i; ++i) {
+            auto candidate = (first + i) % count;
+            if (reactors[candidate]->load() < reactors[picked]->load()) {
+                picked = candidate;
+            }
+        }
+    }
+    return *reactors[picked];
+}
+
 void
 NbdConnector::deviceDone(int const socket) {
-    std::lock_guard<std::mutex> g(connection_lock);
-    auto it = connection_map.find(socket);
-    if (connection_map.end() == it) return;
-
-    connection_map.erase(it);
+    for (auto& reactor : reactors) {
+        if (true == reactor->remove(socket)) return;
+    }
 }
 
 NbdConnector::volume_ptr
@@ -220,14 +262,11 @@ NbdConnector::nbdAcceptCb(ev::io &watcher, int revents) {
         } while ((0 > clientsd) && (EINTR == errno));
 
         if (0 <= clientsd) {
-            std::lock_guard<std::mutex> g(connection_lock);
             // Setup some TCP options on the socket
             configureSocket(clientsd);
 
-            // Create a handler for this NBD connection
-            // Will delete itself when connection dies
-            connection_map[clientsd] = std::make_shared<NbdConnection>(this, evLoop, clientsd, api_);
-            LOGINFO("created client connection");
+            // The connection is created on the loop it will run on
+            pickReactor().add(clientsd);
         } else {
             switch (errno) {
             case ENOTSOCK:
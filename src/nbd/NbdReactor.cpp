@@ -0,0 +1,131 @@
+/*
+ * NbdReactor.cpp
+ *
+ * Copyright (c) 2016, Andreas Griesshammer <andreas@formationds.com>
+ * Copyright (c) 2016, Formation Data Systems
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "connector/nbd/NbdReactor.h"
+
+#include <thread>
+
+extern "C" {
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+}
+
+#include <ev++.h>
+
+#include "connector/nbd/NbdConnection.h"
+#include "connector/nbd/nbd_log.h"
+
+namespace fds {
+namespace connector {
+namespace nbd {
+
+NbdReactor::NbdReactor(NbdConnector* server, std::shared_ptr<xdi::ApiInterface> api, int const cpu)
+        : nbd_server(server),
+          api_(api),
+          cpu(cpu),
+          evLoop(new ev::dynamic_loop()),
+          asyncWatcher(new ev::async())
+{
+    asyncWatcher->set(*evLoop);
+    asyncWatcher->set<NbdReactor, &NbdReactor::acceptedCb>(this);
+    asyncWatcher->start();
+}
+
+void NbdReactor::start() {
+    auto t = std::thread(&NbdReactor::run, this);
+    t.detach();
+}
+
+void NbdReactor::add(int const clientsd) {
+    {
+        std::lock_guard<std::mutex> g(connection_lock);
+        if (stopping) {
+            ::shutdown(clientsd, SHUT_RDWR);
+            close(clientsd);
+            return;
+        }
+        accepted.push_back(clientsd);
+        ++connectionCount;
+    }
+    asyncWatcher->send();
+}
+
+bool NbdReactor::remove(int const clientsd) {
+    connection_ptr connection;
+    {
+        std::lock_guard<std::mutex> g(connection_lock);
+        auto it = connection_map.find(clientsd);
+        if (connection_map.end() == it) return false;
+        connection = std::move(it->second);
+        connection_map.erase(it);
+        --connectionCount;
+    }
+    // The connection goes away outside of the lock
+    return true;
+}
+
+void NbdReactor::terminate() {
+    std::lock_guard<std::mutex> g(connection_lock);
+    stopping = true;
+    for (auto clientsd : accepted) {
+        ::shutdown(clientsd, SHUT_RDWR);
+        close(clientsd);
+    }
+    connectionCount -= accepted.size();
+    accepted.clear();
+    for (auto& connection_pair : connection_map) {
+        connection_pair.second->terminate();
+    }
+}
+
+// Create the connections for the sockets handed to us on our own thread
+void NbdReactor::acceptedCb(ev::async&, int) {
+    std::lock_guard<std::mutex> g(connection_lock);
+    for (auto clientsd : accepted) {
+        // Will delete itself when connection dies
+        connection_map[clientsd] = std::make_shared<NbdConnection>(nbd_server, evLoop, clientsd, api_);
+        LOGINFO("socket:{} cpu:{} created client connection", clientsd, cpu);
+    }
+    accepted.clear();
+}
+
+void NbdReactor::run() {
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGPIPE);
+    if (0 != pthread_sigmask(SIG_BLOCK, &set, nullptr)) {
+        LOGWARN("failed to enable SIGPIPE mask on NBD loop");
+    }
+    if (0 <= cpu) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        if (0 != pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus)) {
+            LOGWARN("cpu:{} failed to pin NBD loop", cpu);
+        }
+    }
+    evLoop->run(0);
+}
+
+}  // namespace nbd
+}  // namespace connector
+}  // namespace fds
@@ -35,6 +35,7 @@ extern "C" {
 #include "connector/scst-standalone/ScstInquiry.h"
 #include "connector/scst-standalone/ScstMode.h"
 
+#include "connector/block/TaskPool.h"
 #include "connector/block/Tasks.h"
 
 /// Some useful constants for us
@@ -43,6 +44,8 @@ static constexpr size_t Ki = 1024;
 static constexpr size_t Mi = Ki * Ki;
 static constexpr size_t Gi = Ki * Mi;
 static constexpr ssize_t max_block_size = 8 * Mi;
+// Objects read ahead of a sequential reader at most
+static constexpr size_t read_ahead_objects = 16;
 /// ******************************************
 
 namespace fds {
@@ -82,7 +85,12 @@ void ScstDisk::setupModePages()
     caching_page &= CachingModePage::SegmentSize;
     caching_page &= CachingModePage::SegmentSizeInBlocks;
     uint32_t blocks_per_object = physical_block_size / logical_block_size;
-    caching_page.setPrefetches(blocks_per_object, blocks_per_object, blocks_per_object, UINT64_MAX);
+    // Sequential reads are prefetched by BlockOperations, tell the initiator
+    // about the same window
+    size_t minimum_prefetch = blocks_per_object;
+    size_t maximum_prefetch = read_ahead_objects * blocks_per_object;
+    caching_page.setPrefetches(minimum_prefetch, maximum_prefetch, maximum_prefetch, UINT64_MAX);
+    setReadAheadWindow(minimum_prefetch / blocks_per_object, maximum_prefetch / blocks_per_object);
     mode_handler->addModePage(caching_page);
 
     ReadWriteRecoveryPage recovery_page;
@@ -183,7 +191,7 @@ void ScstDisk::execDeviceCmd(ScstTask* task) {
                 continue;
             }
 
-            auto readTask = new fds::block::ReadTask(task);
+            auto readTask = getTaskPool()->getRead(task);
 
             uint64_t offset = scsi_cmd.lba * logical_block_size;
             readTask->set(offset, scsi_cmd.bufflen);
@@ -238,13 +246,20 @@ void ScstDisk::execDeviceCmd(ScstTask* task) {
                 continue;
             }
 
-            auto writeTask = new fds::block::WriteTask(task);
+            auto writeTask = getTaskPool()->getWrite(task);
 
             uint64_t offset = scsi_cmd.lba * logical_block_size;
             writeTask->set(offset, scsi_cmd.bufflen);
             // Right now our API expects the data in a shared_ptr :(
-            auto write_buffer = std::make_shared<std::string>((char*) buffer, buflen);
-            writeTask->setWriteBuffer(write_buffer);
+            // copy it into a buffer per object so it isn't copied again
+            std::vector<std::shared_ptr<std::string>> write_buffers;
+            allocateWriteBuffers(offset, buflen, write_buffers);
+            size_t copied = 0;
+            for (auto& b : write_buffers) {
+                memcpy(&(*b)[0], buffer + copied, b->size());
+                copied += b->size();
+            }
+            writeTask->setWriteBuffers(std::move(write_buffers));
             try {
                 executeTask(writeTask);
             } catch (fds::block::BlockError const e) {
@@ -271,13 +286,13 @@ void ScstDisk::execDeviceCmd(ScstTask* task) {
                 continue;
            }
             uint64_t offset = scsi_cmd.lba * logical_block_size;
-            auto writeSameTask = new fds::block::WriteSameTask(task);
-            uint32_t length = 0;
+            auto writeSameTask = getTaskPool()->getWriteSame(task);
+            uint64_t length = 0;
             if (0 == lbas) {
                 // If number of lbas is 0 then write to end of volume
                 length = volume_size - (scsi_cmd.lba * logical_block_size);
             } else {
-                length = scsi_cmd.bufflen * lbas;
+                length = static_cast<uint64_t>(scsi_cmd.bufflen) * lbas;
             }
             writeSameTask->set(offset, length);
             std::shared_ptr<std::string> write_buffer;
@@ -286,10 +301,10 @@ void ScstDisk::execDeviceCmd(ScstTask* task) {
                     task->checkCondition(SCST_LOAD_SENSE(scst_sense_invalid_field_in_cdb));
                     continue;
                 } else {
-                    write_buffer = std::make_shared<std::string>(buflen, '\0');
+                    write_buffer = getBufferPool()->zeroed(buflen);
                 }
             } else {
-                write_buffer = std::make_shared<std::string>((char*) buffer, buflen);
+                write_buffer = getBufferPool()->copy((char*) buffer, buflen);
             }
             writeSameTask->setWriteBuffer(write_buffer);
             try {
@@ -310,7 +325,7 @@ void ScstDisk::execDeviceCmd(ScstTask* task) {
                 auto num_lba = be32toh(*(uint32_t*)(buffer + i + 8));
                 fds::block::UnmapTask::UnmapRange range;
                 range.offset = unmap_lba * logical_block_size;
-                range.length = num_lba * logical_block_size;
+                range.length = static_cast<uint64_t>(num_lba) * logical_block_size;
                 write_vec->push_back(range);
             }
             if (true == write_vec->empty()) return;
@@ -375,14 +390,13 @@ void ScstDisk::execDeviceRemap() {
 void ScstDisk::respondTask(fds::block::BlockTask* response) {
     auto task = static_cast<ScstTask*>(response->getProtoTask());
     auto const& err = response->getProtoTask()->getError();
-    fds::block::TaskVisitor v;
+    auto const isRead = (fds::block::TaskType::READ == response->getType());
     if (xdi::ApiErrorCode::XDI_OK != err) {
         if (xdi::ApiErrorCode::XDI_MISSING_VOLUME == err) {
             // Volume may have been removed, shutdown and destroy target
             LOGINFO("lun destroyed");
             task->checkCondition(SCST_LOAD_SENSE(scst_sense_lun_not_supported));
-        } else if ((fds::block::TaskType::READ == response->match(&v)) &&
-                   (false == isRetryable(err))) {
+        } else if ((true == isRead) && (false == isRetryable(err))) {
             auto btask = static_cast<fds::block::ReadTask*>(response);
             LOGCRITICAL("iotype:read handle:{} offset:{} length:{} had critical failure",
                     task->getHandle(),
@@ -399,18 +413,18 @@ void ScstDisk::respondTask(fds::block::BlockTask* response) {
         } else {
             // Non-catastrophic (retriable) error
             LOGDEBUG("iotype:{} handle:{} had retriable failure",
-                    (fds::block::TaskType::READ == response->match(&v) ? "read" : "write"),
+                    (true == isRead ? "read" : "write"),
                     task->getHandle());
             task->checkCondition(SCST_LOAD_SENSE(scst_sense_internal_failure));
         }
-    } else if (fds::block::TaskType::READ == response->match(&v)) {
+    } else if (true == isRead) {
         auto btask = static_cast<fds::block::ReadTask*>(response);
         auto buffer = task->getResponseBuffer();
         uint32_t i = 0, context = 0;
-        std::shared_ptr<std::string> buf = btask->getNextReadBuffer(context);
+        auto buf = btask->getNextReadBuffer(context);
         while (buf != NULL) {
-            memcpy(buffer + i, buf->c_str(), buf->length());
-            i += buf->length();
+            memcpy(buffer + i, buf->data(), buf->size());
+            i += buf->size();
             buf = btask->getNextReadBuffer(context);
         }
         task->setResponseLength(i);
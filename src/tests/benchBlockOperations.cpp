@@ -0,0 +1,255 @@
+/*
+ * benchBlockOperations.cpp
+ *
+ * Copyright (c) 2016, Andreas Griesshammer <andreas@formationds.com>
+ * Copyright (c) 2016, Formation Data Systems
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <sstream>
+
+#include "connector/block/BlockOperations.h"
+#include "connector/block/Tasks.h"
+#include "stub/FdsStub.h"
+#include "stub/ApiStub.h"
+#include "log/test_log.h"
+
+static const uint32_t OBJECTSIZE = 131072;
+static const uint32_t WRITESIZE = 4096;
+// Writes in flight for every iteration
+static const uint32_t QUEUEDEPTH = 256;
+// Writes are spread randomly over this many objects
+static const uint64_t VOLUMEOBJECTS = 1 << 16;
+
+// Counts the object I/O that reaches the backend
+class CountingApiStub : public xdi::AsyncApiStub {
+public:
+    CountingApiStub(std::shared_ptr<xdi::FdsStub> stub, uint32_t threads) : xdi::AsyncApiStub(stub, 0, threads) {}
+
+    void readObject(xdi::Request const& requestId, xdi::ReadObjectRequest const& request) override {
+        ++reads;
+        xdi::AsyncApiStub::readObject(requestId, request);
+    }
+    void writeObject(xdi::Request const& requestId, xdi::WriteObjectRequest const& request) override {
+        ++writes;
+        xdi::AsyncApiStub::writeObject(requestId, request);
+    }
+    void writeBlob(xdi::Request const& requestId, xdi::WriteBlobRequest const& request) override {
+        ++commits;
+        xdi::AsyncApiStub::writeBlob(requestId, request);
+    }
+
+    std::atomic<uint64_t> reads {0};
+    std::atomic<uint64_t> writes {0};
+    std::atomic<uint64_t> commits {0};
+};
+
+class BenchTask : public fds::block::ProtoTask {
+public:
+    BenchTask(uint64_t const hdl) : fds::block::ProtoTask(hdl) {}
+};
+
+class BenchConnector : public fds::block::BlockOperations {
+public:
+    BenchConnector(std::shared_ptr<xdi::ApiInterface> interface) : fds::block::BlockOperations(interface) {}
+
+    void respondTask(fds::block::BlockTask* response) override {
+        delete response->getProtoTask();
+        std::lock_guard<std::mutex> lg(lock);
+        if (0 == --outstanding) {
+            done.notify_one();
+        }
+    }
+
+    void start(uint32_t const count) {
+        std::lock_guard<std::mutex> lg(lock);
+        outstanding = count;
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> l(lock);
+        done.wait(l, [this] { return 0 == outstanding; });
+    }
+
+private:
+    std::mutex                  lock;
+    std::condition_variable     done;
+    uint32_t                    outstanding {0};
+};
+
+// Random 4k writes completed by the given number of AsyncApiStub threads
+static void BM_AsyncWriteCompletionThreads(benchmark::State& state) {
+    auto stub = std::make_shared<xdi::FdsStub>();
+    auto api = std::make_shared<xdi::AsyncApiStub>(stub, 0, state.range(0));
+    auto connector = std::make_shared<BenchConnector>(api);
+    connector->init("benchVol", 0, OBJECTSIZE);
+    auto buffer = std::make_shared<std::string>(WRITESIZE, 'x');
+
+    uint64_t handle = 0;
+    while (state.KeepRunning()) {
+        connector->start(QUEUEDEPTH);
+        for (uint32_t i = 0; i < QUEUEDEPTH; ++i) {
+            auto writeTask = new fds::block::WriteTask(new BenchTask(handle++));
+            uint64_t offset = (std::rand() % VOLUMEOBJECTS) * OBJECTSIZE + (std::rand() % (OBJECTSIZE / WRITESIZE)) * WRITESIZE;
+            writeTask->setWriteBuffer(buffer);
+            writeTask->set(offset, WRITESIZE);
+            connector->executeTask(writeTask);
+        }
+        connector->wait();
+    }
+    state.SetItemsProcessed(state.iterations() * QUEUEDEPTH);
+    // Completions keep running after the task was responded to, let them
+    // finish before the connector goes away
+    api->waitIdle();
+    connector->shutdown();
+}
+BENCHMARK(BM_AsyncWriteCompletionThreads)->Arg(1)->Arg(4)->Arg(16)->Arg(64)->UseRealTime();
+
+// Sequential 4k writes with the given write combining window in us, the
+// label shows the object reads and writes sent per write
+static void BM_SequentialWriteCombining(benchmark::State& state) {
+    fds::block::BlockOperations::setWriteCombineWindow(std::chrono::microseconds(state.range(0)));
+    // Cached objects would hide the reads of the read-modify-writes
+    fds::block::BlockOperations::setObjectCacheSize(0);
+    auto stub = std::make_shared<xdi::FdsStub>();
+    auto api = std::make_shared<CountingApiStub>(stub, 4);
+    auto connector = std::make_shared<BenchConnector>(api);
+    connector->init("benchCombineVol", 0, OBJECTSIZE);
+    fds::block::BlockOperations::setWriteCombineWindow(std::chrono::microseconds(0));
+    fds::block::BlockOperations::setObjectCacheSize(64 * 1024 * 1024);
+    auto buffer = std::make_shared<std::string>(WRITESIZE, 'x');
+
+    uint64_t handle = 0;
+    uint64_t offset = 0;
+    while (state.KeepRunning()) {
+        connector->start(QUEUEDEPTH);
+        for (uint32_t i = 0; i < QUEUEDEPTH; ++i) {
+            auto writeTask = new fds::block::WriteTask(new BenchTask(handle++));
+            writeTask->setWriteBuffer(buffer);
+            writeTask->set(offset, WRITESIZE);
+            offset = (offset + WRITESIZE) % (VOLUMEOBJECTS * OBJECTSIZE);
+            connector->executeTask(writeTask);
+        }
+        connector->wait();
+    }
+    state.SetItemsProcessed(state.iterations() * QUEUEDEPTH);
+    api->waitIdle();
+    std::ostringstream label;
+    auto writes = static_cast<double>(state.iterations() * QUEUEDEPTH);
+    label << "reads/write:" << api->reads / writes << " writes/write:" << api->writes / writes;
+    state.SetLabel(label.str());
+    connector->shutdown();
+}
+BENCHMARK(BM_SequentialWriteCombining)->Arg(0)->Arg(100)->Arg(1000)->UseRealTime();
+
+// Random 4k writes with the given WriteBlob grouping interval in us, the
+// label shows the WriteBlobs sent per write
+static void BM_RandomWriteCommitGroup(benchmark::State& state) {
+    fds::block::BlockOperations::setCommitGroup(std::chrono::microseconds(state.range(0)), QUEUEDEPTH);
+    auto stub = std::make_shared<xdi::FdsStub>();
+    auto api = std::make_shared<CountingApiStub>(stub, 4);
+    auto connector = std::make_shared<BenchConnector>(api);
+    connector->init("benchGroupVol", 0, OBJECTSIZE);
+    fds::block::BlockOperations::setCommitGroup(std::chrono::microseconds(0), 64);
+    auto buffer = std::make_shared<std::string>(WRITESIZE, 'x');
+
+    uint64_t handle = 0;
+    while (state.KeepRunning()) {
+        connector->start(QUEUEDEPTH);
+        for (uint32_t i = 0; i < QUEUEDEPTH; ++i) {
+            auto writeTask = new fds::block::WriteTask(new BenchTask(handle++));
+            uint64_t offset = (std::rand() % VOLUMEOBJECTS) * OBJECTSIZE + (std::rand() % (OBJECTSIZE / WRITESIZE)) * WRITESIZE;
+            writeTask->setWriteBuffer(buffer);
+            writeTask->set(offset, WRITESIZE);
+            connector->executeTask(writeTask);
+        }
+        connector->wait();
+    }
+    state.SetItemsProcessed(state.iterations() * QUEUEDEPTH);
+    api->waitIdle();
+    std::ostringstream label;
+    label << "writeblobs/write:" << api->commits / static_cast<double>(state.iterations() * QUEUEDEPTH);
+    state.SetLabel(label.str());
+    connector->shutdown();
+}
+BENCHMARK(BM_RandomWriteCommitGroup)->Arg(0)->Arg(100)->Arg(1000)->UseRealTime();
+
+// Only what gets written matters here, not the data, so don't keep it
+class DiscardingApiStub : public xdi::AsyncApiStub {
+public:
+    DiscardingApiStub(std::shared_ptr<xdi::FdsStub> stub, uint32_t threads) : xdi::AsyncApiStub(stub, 0, threads) {}
+
+    void writeObject(xdi::Request const& requestId, xdi::WriteObjectRequest const& request) override {
+        auto discarded = request;
+        discarded.buffer = std::make_shared<std::string>();
+        xdi::AsyncApiStub::writeObject(requestId, discarded);
+    }
+};
+
+// Aligned writes of the given number of objects. The connector copies the
+// payload in either as a single buffer (0) or as a buffer per object (1),
+// a single buffer is copied again into the objects.
+static void BM_AlignedLargeWrite(benchmark::State& state) {
+    static const uint32_t queueDepth = 8;
+    auto stub = std::make_shared<xdi::FdsStub>();
+    auto api = std::make_shared<DiscardingApiStub>(stub, 4);
+    auto connector = std::make_shared<BenchConnector>(api);
+    connector->init("benchLargeWriteVol", 0, OBJECTSIZE);
+    size_t const length = state.range(0) * OBJECTSIZE;
+    std::string payload(length, 'x');
+
+    uint64_t handle = 0;
+    uint64_t offset = 0;
+    while (state.KeepRunning()) {
+        connector->start(queueDepth);
+        for (uint32_t i = 0; i < queueDepth; ++i) {
+            auto writeTask = new fds::block::WriteTask(new BenchTask(handle++));
+            writeTask->set(offset, length);
+            if (0 == state.range(1)) {
+                auto buffer = std::make_shared<std::string>(payload);
+                writeTask->setWriteBuffer(buffer);
+            } else {
+                std::vector<std::shared_ptr<std::string>> buffers;
+                connector->allocateWriteBuffers(offset, length, buffers);
+                size_t copied = 0;
+                for (auto& b : buffers) {
+                    b->replace(0, b->size(), payload, copied, b->size());
+                    copied += b->size();
+                }
+                writeTask->setWriteBuffers(std::move(buffers));
+            }
+            offset = (offset + length) % (VOLUMEOBJECTS * OBJECTSIZE);
+            connector->executeTask(writeTask);
+        }
+        connector->wait();
+    }
+    state.SetBytesProcessed(state.iterations() * queueDepth * length);
+    api->waitIdle();
+    connector->shutdown();
+}
+BENCHMARK(BM_AlignedLargeWrite)->Args({8, 0})->Args({8, 1})->Args({64, 0})->Args({64, 1})->UseRealTime();
+
+int main(int argc, char* argv[]) {
+    ::benchmark::Initialize(&argc, argv);
+    xdi::SetTestLogger(xdi::createLogger("benchBlockOperations"));
+    ::benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
@@ -0,0 +1,125 @@
+/*
+ * benchBlockTools.cpp
+ *
+ * Copyright (c) 2016, Andreas Griesshammer <andreas@formationds.com>
+ * Copyright (c) 2016, Formation Data Systems
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "connector/block/BlockTools.h"
+#include "log/test_log.h"
+
+static const uint32_t PATTERNSIZE = 512;
+
+// Build an object of the given size from a pattern the way WRITE SAME used
+// to, appending the pattern over and over
+static void BM_PatternAppend(benchmark::State& state) {
+    std::string pattern(PATTERNSIZE, 'x');
+    while (state.KeepRunning()) {
+        auto buf = std::make_shared<std::string>();
+        for (int i = 0; i < state.range(0) / PATTERNSIZE; ++i) {
+            *buf += pattern;
+        }
+        benchmark::DoNotOptimize(buf->data());
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_PatternAppend)->Arg(131072)->Arg(1 << 20);
+
+static void BM_PatternFill(benchmark::State& state) {
+    std::string pattern(PATTERNSIZE, 'x');
+    while (state.KeepRunning()) {
+        auto buf = std::make_shared<std::string>(state.range(0), '\0');
+        fds::block::fillPattern(&(*buf)[0], buf->size(), pattern.data(), pattern.size());
+        benchmark::DoNotOptimize(buf->data());
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_PatternFill)->Arg(131072)->Arg(1 << 20);
+
+// Scan an object of zeros a byte at a time
+static void BM_ZeroScanBytes(benchmark::State& state) {
+    std::string buf(state.range(0), '\0');
+    while (state.KeepRunning()) {
+        auto zero = std::all_of(buf.begin(), buf.end(), [] (char const c) { return '\0' == c; });
+        benchmark::DoNotOptimize(zero);
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ZeroScanBytes)->Arg(131072)->Arg(1 << 20);
+
+static void BM_ZeroScan(benchmark::State& state) {
+    std::string buf(state.range(0), '\0');
+    while (state.KeepRunning()) {
+        auto zero = fds::block::isZero(buf.data(), buf.size());
+        benchmark::DoNotOptimize(zero);
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ZeroScan)->Arg(131072)->Arg(1 << 20);
+
+// Offsets of 4k writes spread over the volume, by division and through
+// the precomputed geometry of a 128k object
+static const uint32_t OBJECTSIZE = 131072;
+
+static std::vector<uint64_t> randomOffsets() {
+    std::mt19937_64 gen(1);
+    std::uniform_int_distribution<uint64_t> lbas(0, 1ul << 28);
+    std::vector<uint64_t> offsets(4096);
+    for (auto& o : offsets) {
+        o = lbas(gen) * PATTERNSIZE;
+    }
+    return offsets;
+}
+
+static void BM_CalculateOffsetsDivide(benchmark::State& state) {
+    auto offsets = randomOffsets();
+    size_t i = 0;
+    uint32_t objectSize = OBJECTSIZE;
+    benchmark::DoNotOptimize(objectSize);
+    while (state.KeepRunning()) {
+        fds::block::OffsetInfo oi;
+        fds::block::calculateOffsets(oi, offsets[i++ & 4095], state.range(0), objectSize);
+        benchmark::DoNotOptimize(oi);
+    }
+}
+BENCHMARK(BM_CalculateOffsetsDivide)->Arg(4096)->Arg(1 << 20);
+
+static void BM_CalculateOffsetsGeometry(benchmark::State& state) {
+    auto offsets = randomOffsets();
+    size_t i = 0;
+    fds::block::ObjectGeometry geometry(OBJECTSIZE);
+    benchmark::DoNotOptimize(geometry);
+    while (state.KeepRunning()) {
+        fds::block::OffsetInfo oi;
+        fds::block::calculateOffsets(oi, offsets[i++ & 4095], state.range(0), geometry);
+        benchmark::DoNotOptimize(oi);
+    }
+}
+BENCHMARK(BM_CalculateOffsetsGeometry)->Arg(4096)->Arg(1 << 20);
+
+int main(int argc, char* argv[]) {
+    ::benchmark::Initialize(&argc, argv);
+    xdi::SetTestLogger(xdi::createLogger("benchBlockTools"));
+    ::benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
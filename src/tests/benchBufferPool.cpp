@@ -0,0 +1,176 @@
+/*
+ * benchBufferPool.cpp
+ *
+ * Copyright (c) 2016, Andreas Griesshammer <andreas@formationds.com>
+ * Copyright (c) 2016, Formation Data Systems
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <sstream>
+
+#include "connector/block/BlockOperations.h"
+#include "connector/block/BufferPool.h"
+#include "connector/block/Tasks.h"
+#include "stub/FdsStub.h"
+#include "stub/ApiStub.h"
+#include "log/test_log.h"
+
+// Count all the heap traffic of the process, the default operator delete
+// frees what this allocates
+static std::atomic<uint64_t> allocations {0};
+static std::atomic<uint64_t> allocated_bytes {0};
+
+void* operator new(size_t size) {
+    ++allocations;
+    allocated_bytes += size;
+    if (auto p = std::malloc(size)) return p;
+    throw std::bad_alloc();
+}
+
+static const uint32_t OBJECTSIZE = 131072;
+static const uint32_t WRITESIZE = 4096;
+// Writes in flight for every iteration
+static const uint32_t QUEUEDEPTH = 256;
+// Writes are spread randomly over this many objects
+static const uint64_t VOLUMEOBJECTS = 1 << 16;
+
+// Show the heap traffic since the given counts per item
+static void setAllocLabel(benchmark::State& state, uint64_t const allocs, uint64_t const bytes, uint64_t const items) {
+    std::ostringstream label;
+    label << "allocs/op:" << (allocations - allocs) / static_cast<double>(items)
+          << " bytes/op:" << (allocated_bytes - bytes) / static_cast<double>(items);
+    state.SetLabel(label.str());
+}
+
+// Object buffers straight from the heap, the way the data path used to
+// get them
+static void BM_ObjectBufferMakeShared(benchmark::State& state) {
+    std::string src(OBJECTSIZE, 'x');
+    uint64_t allocs = allocations, bytes = allocated_bytes;
+    while (state.KeepRunning()) {
+        auto buf = std::make_shared<std::string>(src.data(), state.range(0));
+        benchmark::DoNotOptimize(buf->data());
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+    setAllocLabel(state, allocs, bytes, state.iterations());
+}
+BENCHMARK(BM_ObjectBufferMakeShared)->Arg(WRITESIZE)->Arg(OBJECTSIZE);
+
+static void BM_ObjectBufferPool(benchmark::State& state) {
+    fds::block::BufferPool pool(OBJECTSIZE, 64);
+    std::string src(OBJECTSIZE, 'x');
+    uint64_t allocs = allocations, bytes = allocated_bytes;
+    while (state.KeepRunning()) {
+        auto buf = pool.copy(src.data(), state.range(0));
+        benchmark::DoNotOptimize(buf->data());
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+    setAllocLabel(state, allocs, bytes, state.iterations());
+}
+BENCHMARK(BM_ObjectBufferPool)->Arg(WRITESIZE)->Arg(OBJECTSIZE);
+
+// The FdsStub keeps the buffers written to it, a real backend is done with
+// them once they went out on the wire. Hand it a copy instead.
+class CopyingApiStub : public xdi::AsyncApiStub {
+public:
+    CopyingApiStub(std::shared_ptr<xdi::FdsStub> stub, uint32_t threads) : xdi::AsyncApiStub(stub, 0, threads) {}
+
+    void writeObject(xdi::Request const& requestId, xdi::WriteObjectRequest const& request) override {
+        auto copy = request;
+        copy.buffer = std::make_shared<std::string>(*request.buffer);
+        xdi::AsyncApiStub::writeObject(requestId, copy);
+    }
+};
+
+class BenchTask : public fds::block::ProtoTask {
+public:
+    BenchTask(uint64_t const hdl) : fds::block::ProtoTask(hdl) {}
+};
+
+class BenchConnector : public fds::block::BlockOperations {
+public:
+    BenchConnector(std::shared_ptr<xdi::ApiInterface> interface) : fds::block::BlockOperations(interface) {}
+
+    void respondTask(fds::block::BlockTask* response) override {
+        delete response->getProtoTask();
+        std::lock_guard<std::mutex> lg(lock);
+        if (0 == --outstanding) {
+            done.notify_one();
+        }
+    }
+
+    void start(uint32_t const count) {
+        std::lock_guard<std::mutex> lg(lock);
+        outstanding = count;
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> l(lock);
+        done.wait(l, [this] { return 0 == outstanding; });
+    }
+
+private:
+    std::mutex                  lock;
+    std::condition_variable     done;
+    uint32_t                    outstanding {0};
+};
+
+// Random 4k read-modify-writes with the given pool size in MB, 0 allocates
+// every buffer. The label shows the heap traffic per write, one object of
+// it is the copy CopyingApiStub makes.
+static void BM_RandomWriteBufferPool(benchmark::State& state) {
+    fds::block::BlockOperations::setBufferPoolSize(state.range(0) * 1024 * 1024);
+    // Every read-modify-write copies the object it read
+    fds::block::BlockOperations::setObjectCacheSize(0);
+    auto stub = std::make_shared<xdi::FdsStub>();
+    auto api = std::make_shared<CopyingApiStub>(stub, 4);
+    auto connector = std::make_shared<BenchConnector>(api);
+    connector->init("benchPoolVol", 0, OBJECTSIZE);
+    fds::block::BlockOperations::setBufferPoolSize(32 * 1024 * 1024);
+    fds::block::BlockOperations::setObjectCacheSize(64 * 1024 * 1024);
+    auto buffer = std::make_shared<std::string>(WRITESIZE, 'x');
+
+    uint64_t handle = 0;
+    uint64_t allocs = allocations, bytes = allocated_bytes;
+    while (state.KeepRunning()) {
+        connector->start(QUEUEDEPTH);
+        for (uint32_t i = 0; i < QUEUEDEPTH; ++i) {
+            auto writeTask = new fds::block::WriteTask(new BenchTask(handle++));
+            uint64_t offset = (std::rand() % VOLUMEOBJECTS) * OBJECTSIZE + (std::rand() % (OBJECTSIZE / WRITESIZE)) * WRITESIZE;
+            writeTask->setWriteBuffer(buffer);
+            writeTask->set(offset, WRITESIZE);
+            connector->executeTask(writeTask);
+        }
+        connector->wait();
+    }
+    state.SetItemsProcessed(state.iterations() * QUEUEDEPTH);
+    api->waitIdle();
+    setAllocLabel(state, allocs, bytes, state.iterations() * QUEUEDEPTH);
+    connector->shutdown();
+}
+BENCHMARK(BM_RandomWriteBufferPool)->Arg(0)->Arg(32)->UseRealTime();
+
+int main(int argc, char* argv[]) {
+    ::benchmark::Initialize(&argc, argv);
+    xdi::SetTestLogger(xdi::createLogger("benchBufferPool"));
+    ::benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
@@ -0,0 +1,71 @@
+/*
+ * benchTaskTable.cpp
+ *
+ * Copyright (c) 2016, Andreas Griesshammer <andreas@formationds.com>
+ * Copyright (c) 2016, Formation Data Systems
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "log/test_log.h"
+#include "connector/block/TaskTable.h"
+
+// Tasks in flight while completions look them up
+static const uint64_t QUEUEDEPTH = 256;
+
+struct BenchTask {
+    uint64_t handle;
+};
+
+static std::vector<BenchTask> tasks(QUEUEDEPTH);
+
+// What BlockOperations used before, a map behind a single mutex
+static std::mutex mapLock;
+static std::unordered_map<int64_t, BenchTask*> map;
+
+static fds::block::TaskTable<BenchTask> table;
+
+static void BM_ResponseLookupLockedMap(benchmark::State& state) {
+    uint64_t i = 0;
+    while (state.KeepRunning()) {
+        std::lock_guard<std::mutex> lg(mapLock);
+        benchmark::DoNotOptimize(map.find(i++ % QUEUEDEPTH)->second);
+    }
+}
+BENCHMARK(BM_ResponseLookupLockedMap)->Threads(1)->Threads(4)->Threads(16);
+
+static void BM_ResponseLookupTaskTable(benchmark::State& state) {
+    uint64_t i = 0;
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(table.find(i++ % QUEUEDEPTH));
+    }
+}
+BENCHMARK(BM_ResponseLookupTaskTable)->Threads(1)->Threads(4)->Threads(16);
+
+int main(int argc, char* argv[]) {
+    ::benchmark::Initialize(&argc, argv);
+    xdi::SetTestLogger(xdi::createLogger("benchTaskTable"));
+    for (uint64_t i = 0; i < QUEUEDEPTH; ++i) {
+        tasks[i].handle = i;
+        map.emplace(i, &tasks[i]);
+        table.insert(i, &tasks[i]);
+    }
+    ::benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
@@ -0,0 +1,89 @@
+/*
+ * benchWriteContext.cpp
+ *
+ * Copyright (c) 2016, Andreas Griesshammer <andreas@formationds.com>
+ * Copyright (c) 2016, Formation Data Systems
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <vector>
+
+#include "log/test_log.h"
+#include "connector/block/WriteContext.h"
+
+static std::string path("TestBlob");
+
+static const uint32_t OBJECTSIZE = 131072;
+// Each in-flight range covers 2 objects followed by a 1 object gap
+static const uint32_t RANGE_OBJECTS = 2;
+static const uint32_t RANGE_STRIDE = 3;
+
+// Build a WriteContext with numRanges disjoint ranges that all
+// have a pending write, as if numRanges writes were in flight.
+static std::unique_ptr<fds::block::WriteContext> makeContext(int64_t numRanges) {
+    std::unique_ptr<fds::block::WriteContext> ctx(new fds::block::WriteContext(1, path, OBJECTSIZE));
+    for (int64_t i = 0; i < numRanges; ++i) {
+        xdi::ObjectOffsetVal start = i * RANGE_STRIDE;
+        xdi::ObjectOffsetVal end = start + RANGE_OBJECTS - 1;
+        ctx->addReadBlob(start, end, nullptr, false);
+        ctx->addPendingWrite(start, end, nullptr);
+    }
+    return ctx;
+}
+
+static std::vector<xdi::ObjectOffsetVal> makeOffsets(int64_t numRanges) {
+    std::vector<xdi::ObjectOffsetVal> offsets(1024);
+    for (auto& o : offsets) {
+        o = (std::rand() % numRanges) * RANGE_STRIDE;
+    }
+    return offsets;
+}
+
+// Point lookups, these are done for every object a write touches
+static void BM_WriteContextPointLookup(benchmark::State& state) {
+    auto ctx = makeContext(state.range(0));
+    auto offsets = makeOffsets(state.range(0));
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        auto offset = offsets[i++ % offsets.size()];
+        ctx->triggerWrite(offset);
+        ctx->updateOffset(offset, "1");
+    }
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_WriteContextPointLookup)->RangeMultiplier(8)->Range(8, 8<<12)->Complexity(benchmark::oLogN);
+
+// Range lookups, these are done when a task reserves its object range
+static void BM_WriteContextRangeLookup(benchmark::State& state) {
+    auto ctx = makeContext(state.range(0));
+    auto offsets = makeOffsets(state.range(0));
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        auto offset = offsets[i++ % offsets.size()];
+        // Overlaps an existing range, so nothing gets modified
+        benchmark::DoNotOptimize(ctx->addReadBlob(offset, offset + RANGE_STRIDE, nullptr, true));
+    }
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_WriteContextRangeLookup)->RangeMultiplier(8)->Range(8, 8<<12)->Complexity(benchmark::oLogN);
+
+int main(int argc, char* argv[]) {
+    ::benchmark::Initialize(&argc, argv);
+    xdi::SetTestLogger(xdi::createLogger("benchWriteContext"));
+    ::benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
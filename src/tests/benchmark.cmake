@@ -0,0 +1,27 @@
+# Enable ExternalProject CMake module
+include(ExternalProject)
+
+# Download and install Google Benchmark
+ExternalProject_Add(
+    benchmark
+    URL https://github.com/google/benchmark/archive/v1.1.0.zip
+    PREFIX ${CMAKE_CURRENT_BINARY_DIR}/benchmark
+    CMAKE_ARGS -DCMAKE_BUILD_TYPE=Release -DBENCHMARK_ENABLE_TESTING=OFF
+    # Disable install step
+    INSTALL_COMMAND ""
+)
+
+# Get Benchmark source and binary directories from CMake project
+ExternalProject_Get_Property(benchmark source_dir binary_dir)
+
+# Create a libbenchmark target to be used as a dependency by benchmark programs
+add_library(libbenchmark IMPORTED STATIC GLOBAL)
+add_dependencies(libbenchmark benchmark)
+
+# Set libbenchmark properties
+set_target_properties(libbenchmark PROPERTIES
+    "IMPORTED_LOCATION" "${binary_dir}/src/libbenchmark.a"
+    "IMPORTED_LINK_INTERFACE_LIBRARIES" "${CMAKE_THREAD_LIBS_INIT}"
+)
+
+include_directories("${source_dir}/include")
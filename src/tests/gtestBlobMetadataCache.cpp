@@ -0,0 +1,124 @@
+/*
+ * gtestBlobMetadataCache.cpp
+ *
+ * Copyright (c) 2016, Andreas Griesshammer <andreas@formationds.com>
+ * Copyright (c) 2016, Formation Data Systems
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include "log/test_log.h"
+#include "connector/block/BlobMetadataCache.h"
+
+using fds::block::BlobMetadataCache;
+
+static const std::chrono::milliseconds LIFETIME {60000};
+
+TEST(BlobMetadataCache, PopulateLookup) {
+    BlobMetadataCache cache(1024, LIFETIME);
+    BlobMetadataCache::object_map objects;
+    EXPECT_FALSE(cache.lookup(0, 9, objects));
+
+    // Offsets 2 and 5 have objects, the rest are holes
+    BlobMetadataCache::object_map resp {{2, "a"}, {5, "b"}, {20, "outside"}};
+    cache.populate(0, 9, resp, cache.version());
+    ASSERT_TRUE(cache.lookup(0, 9, objects));
+    EXPECT_EQ((BlobMetadataCache::object_map {{2, "a"}, {5, "b"}}), objects);
+    objects.clear();
+    ASSERT_TRUE(cache.lookup(3, 4, objects));
+    EXPECT_TRUE(objects.empty());
+    // Partially known ranges miss
+    EXPECT_FALSE(cache.lookup(8, 10, objects));
+    EXPECT_TRUE(objects.empty());
+
+    auto stats = cache.getStats();
+    EXPECT_EQ(2, stats.hits);
+    EXPECT_EQ(2, stats.misses);
+    // holes 0-1, a, holes 3-4, b, holes 6-9
+    EXPECT_EQ(5, stats.extents);
+}
+
+TEST(BlobMetadataCache, AssignInvalidate) {
+    BlobMetadataCache cache(1024, LIFETIME);
+    BlobMetadataCache::object_map objects;
+    cache.populate(0, 99, objects, cache.version());
+    cache.assign(10, 19, "a");
+    cache.assign(15, 15, "b");
+    ASSERT_TRUE(cache.lookup(9, 20, objects));
+    ASSERT_EQ(10, objects.size());
+    EXPECT_EQ("a", objects[14]);
+    EXPECT_EQ("b", objects[15]);
+    EXPECT_EQ("a", objects[16]);
+
+    cache.invalidate(12, 12);
+    objects.clear();
+    EXPECT_FALSE(cache.lookup(0, 99, objects));
+    EXPECT_TRUE(cache.lookup(13, 99, objects));
+    EXPECT_EQ(1, cache.getStats().invalidations);
+}
+
+// A ReadBlob response never overwrites what is known and is dropped if
+// anything was invalidated since it was sent
+TEST(BlobMetadataCache, StaleReadBlob) {
+    BlobMetadataCache cache(1024, LIFETIME);
+    BlobMetadataCache::object_map objects;
+    auto version = cache.version();
+    cache.assign(5, 5, "new");
+    cache.populate(0, 9, BlobMetadataCache::object_map {{5, "old"}}, version);
+    ASSERT_TRUE(cache.lookup(0, 9, objects));
+    EXPECT_EQ("new", objects[5]);
+
+    version = cache.version();
+    cache.invalidate(5, 5);
+    cache.populate(0, 9, BlobMetadataCache::object_map {{5, "old"}}, version);
+    EXPECT_FALSE(cache.lookup(5, 5, objects));
+}
+
+TEST(BlobMetadataCache, Lifetime) {
+    BlobMetadataCache cache(1024, std::chrono::milliseconds(10));
+    BlobMetadataCache::object_map objects;
+    cache.populate(0, 9, BlobMetadataCache::object_map {{5, "a"}}, cache.version());
+    EXPECT_TRUE(cache.lookup(0, 9, objects));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_FALSE(cache.lookup(0, 9, objects));
+    // Expired extents get refreshed
+    cache.populate(0, 9, BlobMetadataCache::object_map {{5, "b"}}, cache.version());
+    ASSERT_TRUE(cache.lookup(0, 9, objects));
+    EXPECT_EQ("b", objects[5]);
+
+    BlobMetadataCache disabled(1024, std::chrono::milliseconds(0));
+    disabled.populate(0, 9, objects, disabled.version());
+    EXPECT_FALSE(disabled.lookup(0, 9, objects));
+}
+
+TEST(BlobMetadataCache, Limit) {
+    BlobMetadataCache cache(8, LIFETIME);
+    BlobMetadataCache::object_map objects;
+    for (xdi::ObjectOffsetVal i = 0; i < 8; ++i) {
+        cache.assign(i, i, std::to_string(i));
+    }
+    EXPECT_EQ(8, cache.getStats().extents);
+    cache.assign(8, 8, "8");
+    EXPECT_EQ(0, cache.getStats().extents);
+    EXPECT_FALSE(cache.lookup(0, 0, objects));
+}
+
+int main(int argc, char* argv[]) {
+    ::testing::InitGoogleTest(&argc, argv);
+    xdi::SetTestLogger(xdi::createLogger("gtestBlobMetadataCache"));
+    return RUN_ALL_TESTS();
+}
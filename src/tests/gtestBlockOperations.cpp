@@ -18,9 +18,19 @@
  */
 
 #include <gtest/gtest.h>
+#include <atomic>
 #include <condition_variable>
+#include <thread>
 
 #include "connector/block/BlockOperations.h"
+#include "connector/block/BlobMetadataCache.h"
+#include "connector/block/BufferPool.h"
+#include "connector/block/CommitGroup.h"
+#include "connector/block/ObjectCache.h"
+#include "connector/block/ReadAhead.h"
+#include "connector/block/TaskPool.h"
+#include "connector/block/WriteBarrier.h"
+#include "connector/block/WriteCombiner.h"
 #include "stub/FdsStub.h"
 #include "stub/ApiStub.h"
 #include "connector/block/Tasks.h"
@@ -35,6 +45,14 @@ public:
     TestTask(uint64_t const hdl) : fds::block::ProtoTask(hdl) {}
 };
 
+// Counts the ProtoTasks destroyed, whoever frees them
+std::atomic<int> destroyed {0};
+class CountedTestTask : public TestTask {
+public:
+    CountedTestTask(uint64_t const hdl) : TestTask(hdl) {}
+    ~CountedTestTask() { ++destroyed; }
+};
+
 std::mutex mutex;
 std::condition_variable cond_var;
 int count {0};
@@ -63,10 +81,10 @@ public:
             auto btask = static_cast<fds::block::ReadTask *>(response);
             readBuffer.reset(new std::string());
             uint32_t i = 0, context = 0;
-            std::shared_ptr<std::string> buf = btask->getNextReadBuffer(context);
+            auto buf = btask->getNextReadBuffer(context);
             while (buf != NULL) {
-                *readBuffer += *buf;
-                i += buf->length();
+                readBuffer->append(buf->data(), buf->size());
+                i += buf->size();
                 buf = btask->getNextReadBuffer(context);
             }
         }
@@ -126,6 +144,31 @@ protected:
     };
 };
 
+// The type tag and the TaskVisitor agree for every kind of task
+TEST(BlockTaskTest, TypeTag) {
+    TestTask testTask(0);
+    fds::block::TaskVisitor v;
+    fds::block::UnmapTask::unmap_vec_ptr write_vec(new fds::block::UnmapTask::unmap_vec);
+    std::unique_ptr<fds::block::BlockTask> tasks[] = {
+        std::unique_ptr<fds::block::BlockTask>(new fds::block::ReadTask(&testTask)),
+        std::unique_ptr<fds::block::BlockTask>(new fds::block::WriteTask(&testTask)),
+        std::unique_ptr<fds::block::BlockTask>(new fds::block::WriteSameTask(&testTask)),
+        std::unique_ptr<fds::block::BlockTask>(new fds::block::UnmapTask(&testTask, std::move(write_vec))),
+        std::unique_ptr<fds::block::BlockTask>(new fds::block::FlushTask(&testTask))
+    };
+    fds::block::TaskType const types[] = {
+        fds::block::TaskType::READ,
+        fds::block::TaskType::WRITE,
+        fds::block::TaskType::WRITESAME,
+        fds::block::TaskType::UNMAPTASK,
+        fds::block::TaskType::FLUSH
+    };
+    for (size_t i = 0; i < 5; ++i) {
+        EXPECT_EQ(types[i], tasks[i]->getType());
+        EXPECT_EQ(types[i], tasks[i]->match(&v));
+    }
+}
+
 /******************************
 ** Basic Read/Write tests
 ******************************/
@@ -409,6 +452,31 @@ TEST_F(TestConnectorFixture, WriteSameTestAligned) {
     EXPECT_TRUE(connectorPtr->verifyBuffer(expectBuffer));
 }
 
+// The full object of a pattern is only built for its first WRITE SAME
+TEST_F(TestConnectorFixture, WriteSamePatternObject) {
+    uint64_t seqId = 0;
+    uint32_t length = 2 * OBJECTSIZE;
+    auto writeSameBuffer = randomStrGen(LBASIZE);
+    auto expectBuffer = std::make_shared<std::string>();
+    for (unsigned int i = 0; i < 2 * LBA_PER_OBJECT; ++i) {
+        *expectBuffer += *writeSameBuffer;
+    }
+    for (uint64_t offset : {0ul, 4 * static_cast<uint64_t>(OBJECTSIZE)}) {
+        TestTask testTask(seqId++);
+        auto writeSameTask = new fds::block::WriteSameTask(&testTask);
+        writeSameTask->set(offset, length);
+        writeSameTask->setWriteBuffer(writeSameBuffer);
+        connectorPtr->executeTask(writeSameTask);
+
+        TestTask testTask2(seqId++);
+        auto readTask = new fds::block::ReadTask(&testTask2);
+        readTask->set(offset, length);
+        connectorPtr->executeTask(readTask);
+        EXPECT_TRUE(connectorPtr->verifyBuffer(expectBuffer));
+    }
+    EXPECT_EQ(1, connectorPtr->getPatternHits());
+}
+
 // Write 2 objects worth of random data
 // Then use writeSame to overwrite end aligned
 TEST_F(TestConnectorFixture, WriteSameTestEndAligned) {
@@ -508,6 +576,35 @@ TEST_F(TestConnectorFixture, WriteSameTestUnaligned) {
     EXPECT_TRUE(connectorPtr->verifyBuffer(writeBuffer));
 }
 
+// Zero a byte granular range spanning objects with a single byte pattern
+TEST_F(TestConnectorFixture, WriteSameTestSingleByte) {
+    uint64_t seqId = 0;
+    uint64_t offset = 0;
+    uint32_t length = 3 * OBJECTSIZE;
+    uint64_t writeSameOffset = OBJECTSIZE / 2 + 3;
+    uint32_t writeSameLength = OBJECTSIZE + 1001;
+    TestTask testTask(seqId++);
+    auto writeTask = new fds::block::WriteTask(&testTask);
+    auto writeBuffer = randomStrGen(length);
+    writeTask->setWriteBuffer(writeBuffer);
+    writeTask->set(offset, writeBuffer->size());
+    connectorPtr->executeTask(writeTask);
+
+    TestTask testTask2(seqId++);
+    auto writeSameTask = new fds::block::WriteSameTask(&testTask2);
+    auto writeSameBuffer = std::make_shared<std::string>(1, '\0');
+    writeBuffer->replace(writeSameOffset, writeSameLength, writeSameLength, '\0');
+    writeSameTask->set(writeSameOffset, writeSameLength);
+    writeSameTask->setWriteBuffer(writeSameBuffer);
+    connectorPtr->executeTask(writeSameTask);
+
+    TestTask testTask3(seqId++);
+    auto readTask = new fds::block::ReadTask(&testTask3);
+    readTask->set(offset, length);
+    connectorPtr->executeTask(readTask);
+    EXPECT_TRUE(connectorPtr->verifyBuffer(writeBuffer));
+}
+
 // Use writeSame to write a few LBAs in the middle of an object
 TEST_F(TestConnectorFixture, WriteSameTestMiddle) {
     uint64_t seqId = 0;
@@ -905,6 +1002,847 @@ TEST_F(TestConnectorFixture, UnmapTestBothEnds) {
     EXPECT_TRUE(connectorPtr->verifyBuffer(writeBuffer));
 }
 
+// Offset of the first object in the second stripe region
+static const uint64_t STRIPE_BOUNDARY = 1024 * static_cast<uint64_t>(OBJECTSIZE);
+
+// Write across the object boundary of two stripe regions
+// Read back 3 full objects
+TEST_F(TestConnectorFixture, WriteTestStripeSpanning) {
+    uint64_t readOffset = STRIPE_BOUNDARY - OBJECTSIZE;
+    uint64_t offset = readOffset + 1024;
+    uint32_t length = 2 * OBJECTSIZE;
+    uint32_t readLength = 3 * OBJECTSIZE;
+    uint64_t seqId = 0;
+    TestTask testTask(seqId++);
+    auto writeTask = new fds::block::WriteTask(&testTask);
+    auto write_buffer = randomStrGen(length);
+    writeTask->setWriteBuffer(write_buffer);
+    writeTask->set(offset, write_buffer->size());
+    connectorPtr->executeTask(writeTask);
+    EXPECT_EQ(xdi::ApiErrorCode::XDI_OK, testTask.getError());
+
+    TestTask testTask2(seqId++);
+    auto fullBuf = std::make_shared<std::string>(readLength, '\0');
+    fullBuf->replace(offset - readOffset, length, *write_buffer);
+    auto readTask = new fds::block::ReadTask(&testTask2);
+    readTask->set(readOffset, readLength);
+    connectorPtr->executeTask(readTask);
+    EXPECT_TRUE(connectorPtr->verifyBuffer(fullBuf));
+}
+
+// Write 8 objects worth of random data around a stripe boundary
+// Then overwrite unaligned using writeSame and unmap a range
+// spanning the boundary
+TEST_F(TestConnectorFixture, WriteSameUnmapTestStripeSpanning) {
+    uint64_t seqId = 0;
+    uint64_t offset = STRIPE_BOUNDARY - (4 * OBJECTSIZE);
+    uint32_t length = 8 * OBJECTSIZE;
+    uint32_t num_lbas = 5 * LBA_PER_OBJECT;
+    uint64_t writeSameOffset = offset + (20 * LBASIZE);
+    uint32_t writeSameLength = num_lbas * LBASIZE;
+    uint64_t unmapOffset = STRIPE_BOUNDARY - (10 * LBASIZE);
+    uint32_t unmapLength = OBJECTSIZE + (20 * LBASIZE);
+
+    TestTask testTask(seqId++);
+    auto writeTask = new fds::block::WriteTask(&testTask);
+    auto writeBuffer = randomStrGen(length);
+    writeTask->setWriteBuffer(writeBuffer);
+    writeTask->set(offset, writeBuffer->size());
+    connectorPtr->executeTask(writeTask);
+
+    TestTask testTask2(seqId++);
+    auto writeSameTask = new fds::block::WriteSameTask(&testTask2);
+    auto writeSameBuffer = std::make_shared<std::string>(LBASIZE, 'x');
+    for (unsigned int i = 0; i < num_lbas; ++i) {
+        writeBuffer->replace(writeSameOffset - offset + (i * LBASIZE), LBASIZE, *writeSameBuffer);
+    }
+    writeSameTask->set(writeSameOffset, writeSameLength);
+    writeSameTask->setWriteBuffer(writeSameBuffer);
+    connectorPtr->executeTask(writeSameTask);
+    EXPECT_EQ(xdi::ApiErrorCode::XDI_OK, testTask2.getError());
+
+    fds::block::UnmapTask::unmap_vec_ptr write_vec(new fds::block::UnmapTask::unmap_vec);
+    fds::block::UnmapTask::UnmapRange range;
+    range.offset = unmapOffset;
+    range.length = unmapLength;
+    write_vec->push_back(range);
+    TestTask testTask3(seqId++);
+    auto unmapTask = new fds::block::UnmapTask(&testTask3, std::move(write_vec));
+    connectorPtr->executeTask(unmapTask);
+    EXPECT_EQ(xdi::ApiErrorCode::XDI_OK, testTask3.getError());
+    writeBuffer->replace(unmapOffset - offset, unmapLength, std::string(unmapLength, '\0'));
+
+    TestTask testTask4(seqId++);
+    auto readTask = new fds::block::ReadTask(&testTask4);
+    readTask->set(offset, length);
+    connectorPtr->executeTask(readTask);
+    EXPECT_TRUE(connectorPtr->verifyBuffer(writeBuffer));
+}
+
+/******************************
+** Object cache tests
+******************************/
+// Write 2 objects, the read and a RMW of them are served from the cache
+TEST_F(TestConnectorFixture, ObjectCacheReadHit) {
+    uint64_t seqId = 0;
+    uint32_t length = 2 * OBJECTSIZE;
+    TestTask testTask(seqId++);
+    auto writeTask = new fds::block::WriteTask(&testTask);
+    auto writeBuffer = randomStrGen(length);
+    writeTask->setWriteBuffer(writeBuffer);
+    writeTask->set(0, writeBuffer->size());
+    connectorPtr->executeTask(writeTask);
+
+    TestTask testTask2(seqId++);
+    auto readTask = new fds::block::ReadTask(&testTask2);
+    readTask->set(0, length);
+    connectorPtr->executeTask(readTask);
+    EXPECT_TRUE(connectorPtr->verifyBuffer(writeBuffer));
+    auto stats = connectorPtr->getObjectCache()->getStats();
+    EXPECT_EQ(2, stats.hits);
+    EXPECT_EQ(0, stats.misses);
+
+    TestTask testTask3(seqId++);
+    auto rmwTask = new fds::block::WriteTask(&testTask3);
+    auto rmwBuffer = randomStrGen(LBASIZE);
+    writeBuffer->replace(OBJECTSIZE + LBASIZE, LBASIZE, *rmwBuffer);
+    rmwTask->setWriteBuffer(rmwBuffer);
+    rmwTask->set(OBJECTSIZE + LBASIZE, rmwBuffer->size());
+    connectorPtr->executeTask(rmwTask);
+    EXPECT_EQ(3, connectorPtr->getObjectCache()->getStats().hits);
+
+    TestTask testTask4(seqId++);
+    readTask = new fds::block::ReadTask(&testTask4);
+    readTask->set(0, length);
+    connectorPtr->executeTask(readTask);
+    EXPECT_TRUE(connectorPtr->verifyBuffer(writeBuffer));
+    stats = connectorPtr->getObjectCache()->getStats();
+    EXPECT_EQ(5, stats.hits);
+    EXPECT_EQ(0, stats.misses);
+}
+
+// Holes are read as zeros without going to the backend
+TEST_F(TestConnectorFixture, HoleReadsAvoided) {
+    uint64_t seqId = 0;
+    uint32_t length = 3 * OBJECTSIZE;
+    TestTask testTask(seqId++);
+    auto writeTask = new fds::block::WriteTask(&testTask);
+    auto writeBuffer = randomStrGen(OBJECTSIZE);
+    writeTask->setWriteBuffer(writeBuffer);
+    writeTask->set(OBJECTSIZE, writeBuffer->size());
+    connectorPtr->executeTask(writeTask);
+    EXPECT_EQ(0, connectorPtr->getHoleReadsAvoided());
+
+    TestTask testTask2(seqId++);
+    auto readTask = new fds::block::ReadTask(&testTask2);
+    readTask->set(0, length);
+    connectorPtr->executeTask(readTask);
+    auto expected = std::make_shared<std::string>(length, '\0');
+    expected->replace(OBJECTSIZE, OBJECTSIZE, *writeBuffer);
+    EXPECT_TRUE(connectorPtr->verifyBuffer(expected));
+    EXPECT_EQ(2, connectorPtr->getHoleReadsAvoided());
+
+    // Partial write into a hole does not read it either
+    TestTask testTask3(seqId++);
+    auto rmwTask = new fds::block::WriteTask(&testTask3);
+    auto rmwBuffer = randomStrGen(LBASIZE);
+    expected->replace(2 * OBJECTSIZE + LBASIZE, LBASIZE, *rmwBuffer);
+    rmwTask->setWriteBuffer(rmwBuffer);
+    rmwTask->set(2 * OBJECTSIZE + LBASIZE, rmwBuffer->size());
+    connectorPtr->executeTask(rmwTask);
+    EXPECT_EQ(3, connectorPtr->getHoleReadsAvoided());
+
+    TestTask testTask4(seqId++);
+    readTask = new fds::block::ReadTask(&testTask4);
+    readTask->set(0, length);
+    connectorPtr->executeTask(readTask);
+    EXPECT_TRUE(connectorPtr->verifyBuffer(expected));
+    EXPECT_EQ(4, connectorPtr->getHoleReadsAvoided());
+    // Holes never make it into the object cache
+    EXPECT_EQ(0, connectorPtr->getObjectCache()->getStats().misses);
+    EXPECT_EQ(2, connectorPtr->getObjectCache()->getStats().objects);
+}
+
+// Objects written with all zeros are committed as holes and never written
+TEST_F(TestConnectorFixture, ZeroObjectsSkipped) {
+    uint64_t seqId = 0;
+    uint32_t length = 2 * OBJECTSIZE;
+    TestTask testTask(seqId++);
+    auto writeTask = new fds::block::WriteTask(&testTask);
+    auto writeBuffer = randomStrGen(length);
+    writeTask->setWriteBuffer(writeBuffer);
+    writeTask->set(0, writeBuffer->size());
+    connectorPtr->executeTask(writeTask);
+    EXPECT_EQ(0, connectorPtr->getZeroObjectsSkipped());
+    auto numObjects = stubPtr->getNumObjects();
+
+    // Zero the first object completely and the second one in two RMWs
+    TestTask testTask2(seqId++);
+    auto zeroTask = new fds::block::WriteTask(&testTask2);
+    auto zeroBuffer = std::make_shared<std::string>(OBJECTSIZE, '\0');
+    zeroTask->setWriteBuffer(zeroBuffer);
+    zeroTask->set(0, zeroBuffer->size());
+    connectorPtr->executeTask(zeroTask);
+    EXPECT_EQ(1, connectorPtr->getZeroObjectsSkipped());
+
+    TestTask testTask3(seqId++);
+    auto rmwTask = new fds::block::WriteTask(&testTask3);
+    auto rmwBuffer = std::make_shared<std::string>(OBJECTSIZE - LBASIZE, '\0');
+    rmwTask->setWriteBuffer(rmwBuffer);
+    rmwTask->set(OBJECTSIZE + LBASIZE, rmwBuffer->size());
+    connectorPtr->executeTask(rmwTask);
+    EXPECT_EQ(1, connectorPtr->getZeroObjectsSkipped());
+
+    TestTask testTask4(seqId++);
+    auto lastTask = new fds::block::WriteTask(&testTask4);
+    auto lastBuffer = std::make_shared<std::string>(LBASIZE, '\0');
+    lastTask->setWriteBuffer(lastBuffer);
+    lastTask->set(OBJECTSIZE, lastBuffer->size());
+    connectorPtr->executeTask(lastTask);
+    EXPECT_EQ(2, connectorPtr->getZeroObjectsSkipped());
+
+    TestTask testTask5(seqId++);
+    auto readTask = new fds::block::ReadTask(&testTask5);
+    readTask->set(0, length);
+    connectorPtr->executeTask(readTask);
+    auto expected = std::make_shared<std::string>(length, '\0');
+    EXPECT_TRUE(connectorPtr->verifyBuffer(expected));
+    EXPECT_EQ(2, connectorPtr->getHoleReadsAvoided());
+    // The RMW in between wrote the only new object
+    EXPECT_EQ(numObjects + 1, stubPtr->getNumObjects());
+}
+
+// Full objects unmapped or written with a zero pattern become holes without
+// building or writing any object
+TEST_F(TestConnectorFixture, FullObjectZeroNoData) {
+    uint64_t seqId = 0;
+    uint32_t length = 4 * OBJECTSIZE;
+    TestTask testTask(seqId++);
+    auto writeTask = new fds::block::WriteTask(&testTask);
+    auto writeBuffer = randomStrGen(length);
+    writeTask->setWriteBuffer(writeBuffer);
+    writeTask->set(0, writeBuffer->size());
+    connectorPtr->executeTask(writeTask);
+    auto numObjects = stubPtr->getNumObjects();
+    auto poolStats = connectorPtr->getBufferPool()->getStats();
+
+    fds::block::UnmapTask::unmap_vec_ptr write_vec(new fds::block::UnmapTask::unmap_vec);
+    fds::block::UnmapTask::UnmapRange range;
+    range.offset = 0;
+    range.length = 2 * OBJECTSIZE;
+    write_vec->push_back(range);
+    TestTask testTask2(seqId++);
+    auto unmapTask = new fds::block::UnmapTask(&testTask2, std::move(write_vec));
+    connectorPtr->executeTask(unmapTask);
+    EXPECT_EQ(1, connectorPtr->getZeroObjectsSkipped());
+
+    TestTask testTask3(seqId++);
+    auto writeSameTask = new fds::block::WriteSameTask(&testTask3);
+    auto zeroBuffer = std::make_shared<std::string>(LBASIZE, '\0');
+    writeSameTask->set(2 * OBJECTSIZE, 2 * OBJECTSIZE);
+    writeSameTask->setWriteBuffer(zeroBuffer);
+    connectorPtr->executeTask(writeSameTask);
+    EXPECT_EQ(2, connectorPtr->getZeroObjectsSkipped());
+    EXPECT_EQ(0, connectorPtr->getPatternHits());
+
+    auto stats = connectorPtr->getBufferPool()->getStats();
+    EXPECT_EQ(poolStats.allocations, stats.allocations);
+    EXPECT_EQ(poolStats.reuses, stats.reuses);
+    EXPECT_EQ(numObjects, stubPtr->getNumObjects());
+
+    TestTask testTask4(seqId++);
+    auto readTask = new fds::block::ReadTask(&testTask4);
+    readTask->set(0, length);
+    connectorPtr->executeTask(readTask);
+    auto expected = std::make_shared<std::string>(length, '\0');
+    EXPECT_TRUE(connectorPtr->verifyBuffer(expected));
+    EXPECT_EQ(4, connectorPtr->getHoleReadsAvoided());
+}
+
+// A zero WRITE SAME that may not leave holes, like an NBD WRITE_ZEROES with
+// NO_HOLE, writes its full and partial objects of zeros
+TEST_F(TestConnectorFixture, WriteSameZeroNoHole) {
+    uint64_t seqId = 0;
+    uint32_t length = 4 * OBJECTSIZE;
+    TestTask testTask(seqId++);
+    auto writeTask = new fds::block::WriteTask(&testTask);
+    auto writeBuffer = randomStrGen(length);
+    writeTask->setWriteBuffer(writeBuffer);
+    writeTask->set(0, writeBuffer->size());
+    connectorPtr->executeTask(writeTask);
+    auto numObjects = stubPtr->getNumObjects();
+
+    // The middle two objects in full and the whole of the ends but a block
+    TestTask testTask2(seqId++);
+    auto writeSameTask = new fds::block::WriteSameTask(&testTask2);
+    auto zeroBuffer = std::make_shared<std::string>(1, '\0');
+    writeSameTask->set(LBASIZE, length - (2 * LBASIZE));
+    writeSameTask->setWriteBuffer(zeroBuffer);
+    writeSameTask->setNoHole(true);
+    connectorPtr->executeTask(writeSameTask);
+    EXPECT_EQ(xdi::ApiErrorCode::XDI_OK, testTask2.getError());
+    EXPECT_EQ(0, connectorPtr->getZeroObjectsSkipped());
+    // The zero object and the two ends
+    EXPECT_EQ(numObjects + 3, stubPtr->getNumObjects());
+
+    TestTask testTask3(seqId++);
+    auto readTask = new fds::block::ReadTask(&testTask3);
+    readTask->set(0, length);
+    connectorPtr->executeTask(readTask);
+    writeBuffer->replace(LBASIZE, length - (2 * LBASIZE), length - (2 * LBASIZE), '\0');
+    EXPECT_TRUE(connectorPtr->verifyBuffer(writeBuffer));
+    EXPECT_EQ(0, connectorPtr->getHoleReadsAvoided());
+}
+
+// WRITE SAME and UNMAP past 2^32 objects and longer than 4GiB go out as
+// a single task
+TEST_F(TestConnectorFixture, LargeWriteSameUnmap) {
+    uint64_t seqId = 0;
+    uint64_t const offset = ((1ull << 32) + 1) * OBJECTSIZE;
+    uint64_t const length = (5ull << 30) + LBASIZE;
+    TestTask testTask(seqId++);
+    auto writeTask = new fds::block::WriteTask(&testTask);
+    auto writeBuffer = randomStrGen(2 * OBJECTSIZE);
+    writeTask->setWriteBuffer(writeBuffer);
+    writeTask->set(offset + length - OBJECTSIZE, writeBuffer->size());
+    connectorPtr->executeTask(writeTask);
+
+    TestTask testTask2(seqId++);
+    auto writeSameTask = new fds::block::WriteSameTask(&testTask2);
+    auto zeroBuffer = std::make_shared<std::string>(LBASIZE, '\0');
+    writeSameTask->set(offset, length);
+    writeSameTask->setWriteBuffer(zeroBuffer);
+    connectorPtr->executeTask(writeSameTask);
+
+    TestTask testTask3(seqId++);
+    auto readTask = new fds::block::ReadTask(&testTask3);
+    readTask->set(offset + length - OBJECTSIZE, writeBuffer->size());
+    connectorPtr->executeTask(readTask);
+    auto expected = std::make_shared<std::string>(*writeBuffer);
+    expected->replace(0, OBJECTSIZE, OBJECTSIZE, '\0');
+    EXPECT_TRUE(connectorPtr->verifyBuffer(expected));
+
+    fds::block::UnmapTask::unmap_vec_ptr write_vec(new fds::block::UnmapTask::unmap_vec);
+    fds::block::UnmapTask::UnmapRange range;
+    range.offset = offset;
+    range.length = length + OBJECTSIZE;
+    write_vec->push_back(range);
+    TestTask testTask4(seqId++);
+    auto unmapTask = new fds::block::UnmapTask(&testTask4, std::move(write_vec));
+    connectorPtr->executeTask(unmapTask);
+
+    TestTask testTask5(seqId++);
+    auto readTask2 = new fds::block::ReadTask(&testTask5);
+    readTask2->set(offset + length - OBJECTSIZE, writeBuffer->size());
+    connectorPtr->executeTask(readTask2);
+    expected = std::make_shared<std::string>(writeBuffer->size(), '\0');
+    EXPECT_TRUE(connectorPtr->verifyBuffer(expected));
+}
+
+// Counts the WriteBlobs sent to the stub
+class CountingApiStub : public xdi::ApiStub {
+public:
+    CountingApiStub(std::shared_ptr<xdi::FdsStub> stub) : xdi::ApiStub(stub, 0) {}
+    void writeBlob(xdi::Request const& requestId, xdi::WriteBlobRequest const& request) override {
+        ++writeBlobs;
+        xdi::ApiStub::writeBlob(requestId, request);
+    }
+    size_t writeBlobs {0};
+};
+
+// An unaligned UNMAP over 40 stripe regions commits with one WriteBlob per
+// stripe, not one per region
+TEST_F(TestConnectorFixture, UnmapStripeRegionsWriteBlobs) {
+    auto counting = std::make_shared<CountingApiStub>(stubPtr);
+    auto connector = std::make_shared<TestConnector>(counting, false);
+    connector->init("countVol", 5, OBJECTSIZE);
+    uint64_t seqId = 0;
+
+    // Object 0 and the objects on both sides of the first region boundary
+    auto writeBuffer = randomStrGen(OBJECTSIZE);
+    auto writeBuffer2 = randomStrGen(2 * OBJECTSIZE);
+    TestTask testTask(seqId++);
+    auto writeTask = new fds::block::WriteTask(&testTask);
+    writeTask->setWriteBuffer(writeBuffer);
+    writeTask->set(0, writeBuffer->size());
+    connector->executeTask(writeTask);
+    TestTask testTask2(seqId++);
+    auto writeTask2 = new fds::block::WriteTask(&testTask2);
+    writeTask2->setWriteBuffer(writeBuffer2);
+    writeTask2->set(1023 * OBJECTSIZE, writeBuffer2->size());
+    connector->executeTask(writeTask2);
+    // The second write spans two stripes
+    EXPECT_EQ(3, counting->writeBlobs);
+
+    counting->writeBlobs = 0;
+    fds::block::UnmapTask::unmap_vec_ptr write_vec(new fds::block::UnmapTask::unmap_vec);
+    fds::block::UnmapTask::UnmapRange range;
+    range.offset = LBASIZE;
+    range.length = (40ull * 1024 * OBJECTSIZE) - (2 * LBASIZE);
+    write_vec->push_back(range);
+    TestTask testTask3(seqId++);
+    auto unmapTask = new fds::block::UnmapTask(&testTask3, std::move(write_vec));
+    connector->executeTask(unmapTask);
+    EXPECT_EQ(xdi::ApiErrorCode::XDI_OK, testTask3.getError());
+    EXPECT_EQ(16, counting->writeBlobs);
+
+    TestTask testTask4(seqId++);
+    auto readTask = new fds::block::ReadTask(&testTask4);
+    readTask->set(0, OBJECTSIZE);
+    connector->executeTask(readTask);
+    writeBuffer->replace(LBASIZE, OBJECTSIZE - LBASIZE, OBJECTSIZE - LBASIZE, '\0');
+    EXPECT_TRUE(connector->verifyBuffer(writeBuffer));
+
+    TestTask testTask5(seqId++);
+    auto readTask2 = new fds::block::ReadTask(&testTask5);
+    readTask2->set(1023 * OBJECTSIZE, writeBuffer2->size());
+    connector->executeTask(readTask2);
+    auto expected = std::make_shared<std::string>(writeBuffer2->size(), '\0');
+    EXPECT_TRUE(connector->verifyBuffer(expected));
+    connector->shutdown();
+}
+
+// Finished tasks go back to the connection's pool and are reused
+TEST_F(TestConnectorFixture, TaskPoolReuse) {
+    uint64_t seqId = 0;
+    auto pool = connectorPtr->getTaskPool();
+    auto writeBuffer = randomStrGen(OBJECTSIZE);
+    for (int i = 0; i < 4; ++i) {
+        TestTask testTask(seqId++);
+        auto writeTask = pool->getWrite(&testTask);
+        writeTask->setWriteBuffer(writeBuffer);
+        writeTask->set(i * OBJECTSIZE, writeBuffer->size());
+        connectorPtr->executeTask(writeTask);
+
+        TestTask testTask2(seqId++);
+        auto readTask = pool->getRead(&testTask2);
+        readTask->set(i * OBJECTSIZE, writeBuffer->size());
+        connectorPtr->executeTask(readTask);
+        EXPECT_TRUE(connectorPtr->verifyBuffer(writeBuffer));
+    }
+    auto stats = pool->getStats();
+    EXPECT_EQ(2, stats.allocations);
+    EXPECT_EQ(6, stats.reuses);
+    EXPECT_EQ(8, stats.releases);
+    EXPECT_EQ(2, stats.tasks);
+}
+
+// Unaligned reads only trim views of the objects, the partial buffers of
+// unmaps go back to the pool once the task is done
+TEST_F(TestConnectorFixture, BufferPoolReuse) {
+    uint64_t seqId = 0;
+    TestTask testTask(seqId++);
+    auto writeTask = new fds::block::WriteTask(&testTask);
+    auto writeBuffer = randomStrGen(OBJECTSIZE);
+    writeTask->setWriteBuffer(writeBuffer);
+    writeTask->set(0, writeBuffer->size());
+    connectorPtr->executeTask(writeTask);
+    auto pool = connectorPtr->getBufferPool();
+    ASSERT_TRUE(pool->enabled());
+    EXPECT_EQ(OBJECTSIZE, pool->bufferSize());
+    auto before = pool->getStats();
+
+    auto expected = std::make_shared<std::string>(*writeBuffer, LBASIZE, 2 * LBASIZE);
+    TestTask testTask2(seqId++);
+    auto readTask = new fds::block::ReadTask(&testTask2);
+    readTask->set(LBASIZE, 2 * LBASIZE);
+    connectorPtr->executeTask(readTask);
+    EXPECT_TRUE(connectorPtr->verifyBuffer(expected));
+    EXPECT_EQ(before.allocations, pool->getStats().allocations);
+
+    for (int i = 0; i < 3; ++i) {
+        TestTask unmapTestTask(seqId++);
+        fds::block::UnmapTask::unmap_vec_ptr write_vec(new fds::block::UnmapTask::unmap_vec);
+        fds::block::UnmapTask::UnmapRange range;
+        range.offset = LBASIZE;
+        range.length = LBASIZE;
+        write_vec->push_back(range);
+        auto unmapTask = new fds::block::UnmapTask(&unmapTestTask, std::move(write_vec));
+        connectorPtr->executeTask(unmapTask);
+    }
+    EXPECT_EQ(before.reuses + 2, pool->getStats().reuses);
+
+    expected->replace(0, LBASIZE, LBASIZE, '\0');
+    TestTask testTask3(seqId++);
+    readTask = new fds::block::ReadTask(&testTask3);
+    readTask->set(LBASIZE, 2 * LBASIZE);
+    connectorPtr->executeTask(readTask);
+    EXPECT_TRUE(connectorPtr->verifyBuffer(expected));
+}
+
+// Writes handed in as a buffer per object write the full objects from
+// those buffers, pieces not split at object boundaries are put together
+TEST_F(TestConnectorFixture, WriteBuffersPerObject) {
+    uint64_t seqId = 0;
+    uint64_t offset = OBJECTSIZE - LBASIZE;
+    uint32_t length = OBJECTSIZE + 2 * LBASIZE;
+    auto writeBuffer = randomStrGen(length);
+    std::vector<std::shared_ptr<std::string>> buffers;
+    connectorPtr->allocateWriteBuffers(offset, length, buffers);
+    ASSERT_EQ(3, buffers.size());
+    EXPECT_EQ(LBASIZE, buffers[0]->size());
+    EXPECT_EQ(OBJECTSIZE, buffers[1]->size());
+    EXPECT_EQ(LBASIZE, buffers[2]->size());
+    size_t copied = 0;
+    for (auto& b : buffers) {
+        b->replace(0, b->size(), *writeBuffer, copied, b->size());
+        copied += b->size();
+    }
+    auto pool = connectorPtr->getBufferPool();
+    auto allocations = pool->getStats().allocations;
+
+    TestTask testTask(seqId++);
+    auto writeTask = new fds::block::WriteTask(&testTask);
+    writeTask->set(offset, length);
+    writeTask->setWriteBuffers(std::move(buffers));
+    connectorPtr->executeTask(writeTask);
+    // Only the read-modify-writes of the partial objects need buffers
+    EXPECT_EQ(allocations + 2, pool->getStats().allocations);
+
+    TestTask testTask2(seqId++);
+    auto readTask = new fds::block::ReadTask(&testTask2);
+    readTask->set(offset, length);
+    connectorPtr->executeTask(readTask);
+    EXPECT_TRUE(connectorPtr->verifyBuffer(writeBuffer));
+
+    // Split somewhere else, every object is written from a copy
+    writeBuffer = randomStrGen(length);
+    buffers.clear();
+    buffers.push_back(std::make_shared<std::string>(*writeBuffer, 0, 2 * LBASIZE));
+    buffers.push_back(std::make_shared<std::string>(*writeBuffer, 2 * LBASIZE, length - 2 * LBASIZE));
+    TestTask testTask3(seqId++);
+    writeTask = new fds::block::WriteTask(&testTask3);
+    writeTask->set(offset, length);
+    writeTask->setWriteBuffers(std::move(buffers));
+    connectorPtr->executeTask(writeTask);
+
+    TestTask testTask4(seqId++);
+    readTask = new fds::block::ReadTask(&testTask4);
+    readTask->set(offset, length);
+    connectorPtr->executeTask(readTask);
+    EXPECT_TRUE(connectorPtr->verifyBuffer(writeBuffer));
+}
+
+// Sequential writes filling an object are written without a read and only
+// acknowledged once the combined write is committed
+TEST_F(TestConnectorFixture, WriteCombineSequential) {
+    fds::block::BlockOperations::setWriteCombineWindow(std::chrono::seconds(10));
+    auto combining = std::make_shared<TestConnector>(interfacePtr, true);
+    combining->init("combineVol", 3, OBJECTSIZE);
+    fds::block::BlockOperations::setWriteCombineWindow(std::chrono::microseconds(0));
+    ASSERT_TRUE(combining->getWriteCombiner()->enabled());
+    EXPECT_FALSE(connectorPtr->getWriteCombiner()->enabled());
+
+    uint32_t const writeSize = 4096;
+    uint64_t seqId = 0;
+    auto objectBuffer = randomStrGen(OBJECTSIZE);
+    {
+        std::lock_guard<std::mutex> lg(mutex);
+        count = 0;
+    }
+    for (uint32_t i = 0; i < OBJECTSIZE / writeSize; ++i) {
+        EXPECT_EQ(0, count);
+        auto writeTask = new fds::block::WriteTask(new TestTask(seqId++));
+        auto writeBuffer = std::make_shared<std::string>(*objectBuffer, i * writeSize, writeSize);
+        writeTask->setWriteBuffer(writeBuffer);
+        writeTask->set(OBJECTSIZE + i * writeSize, writeBuffer->size());
+        combining->executeTask(writeTask);
+    }
+    EXPECT_EQ(OBJECTSIZE / writeSize, count);
+    auto stats = combining->getWriteCombiner()->getStats();
+    EXPECT_EQ(1, stats.fullObjects);
+    EXPECT_EQ(OBJECTSIZE / writeSize - 1, stats.combined);
+    // A full object write needs nothing read
+    EXPECT_EQ(0, combining->getHoleReadsAvoided());
+    EXPECT_EQ(0, combining->getObjectCache()->getStats().misses);
+
+    // Partial writes are flushed ahead of a write to the same object that
+    // can't be combined
+    auto partialTask = new fds::block::WriteTask(new TestTask(seqId++));
+    auto partialBuffer = randomStrGen(writeSize);
+    partialTask->setWriteBuffer(partialBuffer);
+    partialTask->set(OBJECTSIZE, writeSize);
+    combining->executeTask(partialTask);
+    EXPECT_EQ(OBJECTSIZE / writeSize, count);
+    auto sameTask = new fds::block::WriteSameTask(new TestTask(seqId++));
+    auto sameBuffer = randomStrGen(LBASIZE);
+    sameTask->setWriteBuffer(sameBuffer);
+    sameTask->set(OBJECTSIZE + writeSize, LBASIZE);
+    combining->executeTask(sameTask);
+    EXPECT_EQ(OBJECTSIZE / writeSize + 2, count);
+    objectBuffer->replace(0, writeSize, *partialBuffer);
+    objectBuffer->replace(writeSize, LBASIZE, *sameBuffer);
+
+    auto readTask = new fds::block::ReadTask(new TestTask(seqId++));
+    readTask->set(OBJECTSIZE, OBJECTSIZE);
+    combining->executeTask(readTask);
+    EXPECT_TRUE(combining->verifyBuffer(objectBuffer));
+    combining->shutdown();
+}
+
+// Ranges in different stripes are committed by one WriteBlob and their
+// writes are only acknowledged once it is done
+TEST_F(TestConnectorFixture, CommitGroupMaxRanges) {
+    fds::block::BlockOperations::setCommitGroup(std::chrono::seconds(10), 2);
+    auto grouping = std::make_shared<TestConnector>(interfacePtr, true);
+    grouping->init("groupVol", 4, OBJECTSIZE);
+    fds::block::BlockOperations::setCommitGroup(std::chrono::microseconds(0), 64);
+    ASSERT_TRUE(grouping->getCommitGroup()->enabled());
+    EXPECT_FALSE(connectorPtr->getCommitGroup()->enabled());
+
+    {
+        std::lock_guard<std::mutex> lg(mutex);
+        count = 0;
+    }
+    uint64_t seqId = 0;
+    // Objects 0 and 1024 are in different stripe regions
+    std::vector<std::shared_ptr<std::string>> buffers;
+    for (uint64_t object : {0, 1024}) {
+        auto writeTask = new fds::block::WriteTask(new TestTask(seqId++));
+        buffers.push_back(randomStrGen(OBJECTSIZE));
+        writeTask->setWriteBuffer(buffers.back());
+        writeTask->set(object * OBJECTSIZE, OBJECTSIZE);
+        grouping->executeTask(writeTask);
+        // The first range waits for the second
+        EXPECT_EQ((1 == buffers.size()) ? 0 : 2, count);
+    }
+    auto stats = grouping->getCommitGroup()->getStats();
+    EXPECT_EQ(2, stats.ranges);
+    EXPECT_EQ(1, stats.commits);
+
+    for (uint64_t i = 0; i < buffers.size(); ++i) {
+        auto readTask = new fds::block::ReadTask(new TestTask(seqId++));
+        readTask->set(i * 1024 * OBJECTSIZE, OBJECTSIZE);
+        grouping->executeTask(readTask);
+        EXPECT_TRUE(grouping->verifyBuffer(buffers[i]));
+    }
+    grouping->shutdown();
+}
+
+// Writes held back by the write combiner and the commit group go out on a
+// flush, which is only responded to once they are. FUA writes don't wait.
+TEST_F(TestConnectorFixture, FlushBufferedWrites) {
+    fds::block::BlockOperations::setWriteCombineWindow(std::chrono::seconds(10));
+    fds::block::BlockOperations::setCommitGroup(std::chrono::seconds(10), 64);
+    auto flushing = std::make_shared<TestConnector>(interfacePtr, true);
+    flushing->init("flushVol", 6, OBJECTSIZE);
+    fds::block::BlockOperations::setWriteCombineWindow(std::chrono::microseconds(0));
+    fds::block::BlockOperations::setCommitGroup(std::chrono::microseconds(0), 64);
+
+    {
+        std::lock_guard<std::mutex> lg(mutex);
+        count = 0;
+    }
+    uint32_t const writeSize = 4096;
+    uint64_t seqId = 0;
+    std::vector<std::shared_ptr<std::string>> buffers;
+    for (uint64_t object : {0, 1, 2}) {
+        auto writeTask = new fds::block::WriteTask(new TestTask(seqId++));
+        buffers.push_back(randomStrGen(writeSize));
+        writeTask->setWriteBuffer(buffers.back());
+        writeTask->set(object * OBJECTSIZE, writeSize);
+        writeTask->setFua(1 == object);
+        flushing->executeTask(writeTask);
+    }
+    // Only the FUA write is done
+    EXPECT_EQ(1, count);
+
+    flushing->executeTask(new fds::block::FlushTask(new TestTask(seqId++)));
+    EXPECT_EQ(4, count);
+    EXPECT_FALSE(flushing->getWriteBarrier()->waiting());
+    EXPECT_EQ(1, flushing->getWriteBarrier()->getStats().waited);
+
+    // Nothing to wait for
+    flushing->executeTask(new fds::block::FlushTask(new TestTask(seqId++)));
+    EXPECT_EQ(5, count);
+    EXPECT_EQ(1, flushing->getWriteBarrier()->getStats().waited);
+
+    for (uint64_t i = 0; i < buffers.size(); ++i) {
+        auto readTask = new fds::block::ReadTask(new TestTask(seqId++));
+        readTask->set(i * OBJECTSIZE, writeSize);
+        flushing->executeTask(readTask);
+        EXPECT_TRUE(flushing->verifyBuffer(buffers[i]));
+    }
+    flushing->shutdown();
+}
+
+// Sequential reads get the following objects prefetched into the cache,
+// random ones don't
+TEST_F(TestConnectorFixture, ReadAheadSequential) {
+    fds::block::BlockOperations::setReadAheadWindow(2, 4);
+    auto reader = std::make_shared<TestConnector>(interfacePtr, false);
+    reader->init("readAheadVol", 5, OBJECTSIZE);
+    fds::block::BlockOperations::setReadAheadWindow(1, 16);
+    ASSERT_TRUE(reader->getReadAhead()->enabled());
+
+    uint64_t seqId = 0;
+    uint64_t const numObjects = 10;
+    std::vector<std::shared_ptr<std::string>> buffers;
+    for (uint64_t i = 0; i < numObjects; ++i) {
+        TestTask testTask(seqId++);
+        auto writeTask = new fds::block::WriteTask(&testTask);
+        buffers.push_back(randomStrGen(OBJECTSIZE));
+        writeTask->setWriteBuffer(buffers.back());
+        writeTask->set(i * OBJECTSIZE, OBJECTSIZE);
+        reader->executeTask(writeTask);
+    }
+    reader->getObjectCache()->clear();
+    reader->getBlobMetadataCache()->clear();
+
+    // Random reads, away from the objects read sequentially below
+    for (uint64_t i : {30, 17, 25, 12, 21}) {
+        TestTask testTask(seqId++);
+        auto readTask = new fds::block::ReadTask(&testTask);
+        readTask->set(i * OBJECTSIZE, LBASIZE);
+        reader->executeTask(readTask);
+    }
+    EXPECT_EQ(0, reader->getReadAhead()->getStats().prefetches);
+    reader->getObjectCache()->clear();
+    auto misses = reader->getObjectCache()->getStats().misses;
+
+    // The third read of the stream prefetches the next 2 objects, after
+    // that the window is 4 objects
+    for (uint64_t i = 0; i < numObjects; ++i) {
+        TestTask testTask(seqId++);
+        auto readTask = new fds::block::ReadTask(&testTask);
+        readTask->set(i * OBJECTSIZE, OBJECTSIZE);
+        reader->executeTask(readTask);
+        EXPECT_TRUE(reader->verifyBuffer(buffers[i]));
+    }
+    EXPECT_EQ(3, reader->getObjectCache()->getStats().misses - misses);
+    auto stats = reader->getReadAhead()->getStats();
+    EXPECT_EQ(numObjects - 3, stats.objects);
+    EXPECT_LT(0, stats.prefetches);
+}
+
+// Connections to the same volume share the cache
+TEST_F(TestConnectorFixture, ObjectCacheSharedPerVolume) {
+    auto sameVolume = std::make_shared<TestConnector>(interfacePtr, false);
+    sameVolume->init("testVol", 0, OBJECTSIZE);
+    EXPECT_EQ(connectorPtr->getObjectCache(), sameVolume->getObjectCache());
+
+    auto otherVolume = std::make_shared<TestConnector>(interfacePtr, false);
+    otherVolume->init("otherVol", 1, OBJECTSIZE);
+    EXPECT_NE(connectorPtr->getObjectCache(), otherVolume->getObjectCache());
+
+    fds::block::BlockOperations::setObjectCacheSize(0);
+    auto uncached = std::make_shared<TestConnector>(interfacePtr, false);
+    uncached->init("uncachedVol", 2, OBJECTSIZE);
+    fds::block::BlockOperations::setObjectCacheSize(64 * 1024 * 1024);
+    EXPECT_FALSE(uncached->getObjectCache()->enabled());
+
+    uint64_t seqId = 0;
+    TestTask testTask(seqId++);
+    auto writeTask = new fds::block::WriteTask(&testTask);
+    auto writeBuffer = randomStrGen(OBJECTSIZE);
+    writeTask->setWriteBuffer(writeBuffer);
+    writeTask->set(0, writeBuffer->size());
+    uncached->executeTask(writeTask);
+
+    TestTask testTask2(seqId++);
+    auto readTask = new fds::block::ReadTask(&testTask2);
+    readTask->set(0, OBJECTSIZE);
+    uncached->executeTask(readTask);
+    EXPECT_TRUE(uncached->verifyBuffer(writeBuffer));
+    EXPECT_EQ(0, uncached->getObjectCache()->getStats().hits);
+}
+
+// Connections to a volume share its engine, the same protocol handle can be
+// in flight on both and each is responded to by its own connection
+TEST_F(TestConnectorFixture, MultiConnSharedEngine) {
+    auto other = std::make_shared<TestConnector>(interfacePtr, false);
+    other->init("testVol", 0, OBJECTSIZE);
+    EXPECT_EQ(connectorPtr->getWriteCombiner(), other->getWriteCombiner());
+
+    TestTask testTask(0);
+    auto writeTask = new fds::block::WriteTask(&testTask);
+    auto writeBuffer = randomStrGen(OBJECTSIZE / 2);
+    writeTask->setWriteBuffer(writeBuffer);
+    writeTask->set(0, writeBuffer->size());
+    connectorPtr->executeTask(writeTask);
+
+    TestTask testTask2(0);
+    auto writeTask2 = new fds::block::WriteTask(&testTask2);
+    auto writeBuffer2 = randomStrGen(OBJECTSIZE / 2);
+    writeTask2->setWriteBuffer(writeBuffer2);
+    writeTask2->set(OBJECTSIZE / 2, writeBuffer2->size());
+    other->executeTask(writeTask2);
+
+    TestTask testTask3(0);
+    auto readTask = new fds::block::ReadTask(&testTask3);
+    readTask->set(0, OBJECTSIZE);
+    other->executeTask(readTask);
+    auto expected = std::make_shared<std::string>(*writeBuffer + *writeBuffer2);
+    EXPECT_TRUE(other->verifyBuffer(expected));
+
+    // Once a connection is gone the other keeps the volume going
+    connectorPtr->shutdown();
+    TestTask testTask4(0);
+    readTask = new fds::block::ReadTask(&testTask4);
+    readTask->set(0, OBJECTSIZE);
+    other->executeTask(readTask);
+    EXPECT_TRUE(other->verifyBuffer(expected));
+    std::unique_ptr<fds::block::ReadTask> refused(new fds::block::ReadTask(&testTask4));
+    EXPECT_THROW(connectorPtr->executeTask(refused.get()), fds::block::BlockError);
+}
+
+/******************************
+** Blob metadata cache tests
+******************************/
+// A read after a write knows the ObjectIds without a ReadBlob, once the
+// cached metadata expires a change made by someone else is picked up
+TEST_F(TestConnectorFixture, BlobMetadataExternalUpdate) {
+    fds::block::BlockOperations::setBlobMetadataCache(1024 * 1024, std::chrono::milliseconds(100));
+    auto connector = std::make_shared<TestConnector>(interfacePtr, false);
+    connector->init("metaVol", 3, OBJECTSIZE);
+    fds::block::BlockOperations::setBlobMetadataCache(1024 * 1024, std::chrono::milliseconds(10000));
+    auto cache = connector->getBlobMetadataCache();
+
+    uint64_t seqId = 0;
+    TestTask testTask(seqId++);
+    auto writeTask = new fds::block::WriteTask(&testTask);
+    auto writeBuffer = randomStrGen(OBJECTSIZE);
+    writeTask->setWriteBuffer(writeBuffer);
+    writeTask->set(0, writeBuffer->size());
+    connector->executeTask(writeTask);
+    EXPECT_EQ(0, cache->getStats().hits);
+
+    TestTask testTask2(seqId++);
+    auto readTask = new fds::block::ReadTask(&testTask2);
+    readTask->set(0, OBJECTSIZE);
+    connector->executeTask(readTask);
+    EXPECT_TRUE(connector->verifyBuffer(writeBuffer));
+    EXPECT_EQ(1, cache->getStats().hits);
+
+    // Another access manager replaces the object
+    auto otherBuffer = randomStrGen(OBJECTSIZE);
+    xdi::WriteObjectRequest objReq;
+    objReq.buffer = otherBuffer;
+    objReq.volId = 3;
+    xdi::ObjectDescriptor od;
+    od.objectId = stubPtr->writeObject(objReq);
+    od.length = OBJECTSIZE;
+    xdi::WriteBlobRequest blobReq;
+    blobReq.blob.blobInfo.path.volumeId = 3;
+    blobReq.blob.blobInfo.path.blobName = "BlockBlob";
+    blobReq.blob.objects.emplace(0, od);
+    ASSERT_EQ(xdi::ApiErrorCode::XDI_OK, stubPtr->writeBlob(blobReq));
+
+    TestTask testTask3(seqId++);
+    readTask = new fds::block::ReadTask(&testTask3);
+    readTask->set(0, OBJECTSIZE);
+    connector->executeTask(readTask);
+    EXPECT_TRUE(connector->verifyBuffer(writeBuffer));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    TestTask testTask4(seqId++);
+    readTask = new fds::block::ReadTask(&testTask4);
+    readTask->set(0, OBJECTSIZE);
+    connector->executeTask(readTask);
+    EXPECT_TRUE(connector->verifyBuffer(otherBuffer));
+    EXPECT_EQ(2, cache->getStats().hits);
+}
+
 // Run basic single write test multithreaded
 TEST_F(AsyncTestConnectorFixture, AsyncWriteTestSimple) {
     {
@@ -1208,6 +2146,184 @@ TEST_F(AsyncTestConnectorFixture, AsyncWriteTest_qd2_overlapping) {
     EXPECT_TRUE(connectorPtr->verifyBuffers(bufs));
 }
 
+// A flush among writes in flight is responded to once they are all done
+TEST_F(AsyncTestConnectorFixture, AsyncFlushWritesInFlight) {
+    uint32_t const writes = 16;
+    {
+        std::lock_guard<std::mutex> lg(mutex);
+        count = 0;
+        expected = writes + 1;
+    }
+    std::vector<std::shared_ptr<std::string>> buffers;
+    for (uint32_t i = 0; i < writes; ++i) {
+        auto writeTask = new fds::block::WriteTask(new TestTask(i));
+        buffers.push_back(randomStrGen(LBASIZE));
+        writeTask->setWriteBuffer(buffers.back());
+        writeTask->set((i % 4) * OBJECTSIZE + i * LBASIZE, LBASIZE);
+        connectorPtr->executeTask(writeTask);
+    }
+    connectorPtr->executeTask(new fds::block::FlushTask(new TestTask(writes)));
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        EXPECT_TRUE(cond_var.wait_for(lock, std::chrono::seconds(5), [&] { return count == expected; }));
+    }
+    EXPECT_FALSE(connectorPtr->getWriteBarrier()->waiting());
+    EXPECT_EQ(1, connectorPtr->getWriteBarrier()->getStats().barriers);
+}
+
+// A connection goes away with a write in flight, the write still finishes
+// for the other connection of the volume but nobody is responded to and the
+// task is freed
+TEST_F(AsyncTestConnectorFixture, AsyncWriteDisconnect) {
+    {
+        std::lock_guard<std::mutex> lg(mutex);
+        count = 0;
+        expected = 1;
+    }
+    // Slow enough for the connection to go first
+    auto slowPtr = std::make_shared<xdi::AsyncApiStub>(stubPtr, 50);
+    auto leaving = std::make_shared<TestConnector>(slowPtr, true);
+    leaving->init("slowVol", 6, OBJECTSIZE);
+    auto staying = std::make_shared<TestConnector>(slowPtr, true);
+    staying->init("slowVol", 6, OBJECTSIZE);
+
+    destroyed = 0;
+    auto writeBuffer = randomStrGen(OBJECTSIZE / 2);
+    auto writeTask = new fds::block::WriteTask(new CountedTestTask(0));
+    writeTask->setWriteBuffer(writeBuffer);
+    writeTask->set(0, writeBuffer->size());
+    leaving->executeTask(writeTask);
+    leaving->shutdown();
+    for (int i = 0; (i < 100) && (0 == destroyed); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(1, destroyed);
+    EXPECT_EQ(0, count);
+
+    // The write went through nonetheless
+    auto readTask = new fds::block::ReadTask(new TestTask(1));
+    readTask->set(0, writeBuffer->size());
+    staying->executeTask(readTask);
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        EXPECT_TRUE(cond_var.wait_for(lock, std::chrono::seconds(5), [&] { return count == expected; }));
+    }
+    EXPECT_TRUE(staying->verifyBuffer(writeBuffer));
+    staying->shutdown();
+}
+
+// The last connection goes away with a write in flight, the volume stops
+// and frees the task, its late responses find nothing left to finish
+TEST_F(AsyncTestConnectorFixture, AsyncStopInFlight) {
+    {
+        std::lock_guard<std::mutex> lg(mutex);
+        count = 0;
+        expected = 1;
+    }
+    auto slowPtr = std::make_shared<xdi::AsyncApiStub>(stubPtr, 50, 1);
+    auto connector = std::make_shared<TestConnector>(slowPtr, true);
+    connector->init("stopVol", 8, OBJECTSIZE);
+
+    destroyed = 0;
+    auto writeBuffer = randomStrGen(OBJECTSIZE / 2);
+    auto writeTask = new fds::block::WriteTask(new CountedTestTask(0));
+    writeTask->setWriteBuffer(writeBuffer);
+    writeTask->set(0, writeBuffer->size());
+    connector->executeTask(writeTask);
+    connector->shutdown();
+    EXPECT_EQ(1, destroyed);
+
+    slowPtr->waitIdle();
+    EXPECT_EQ(1, destroyed);
+    EXPECT_EQ(0, count);
+}
+
+// A task beyond the volume's task table fails alone with a retryable error,
+// the connection keeps going
+TEST_F(AsyncTestConnectorFixture, AsyncTaskTableFull) {
+    fds::block::BlockOperations::setTaskTableSize(2);
+    auto slowPtr = std::make_shared<xdi::AsyncApiStub>(stubPtr, 50);
+    auto connector = std::make_shared<TestConnector>(slowPtr, false);
+    connector->init("fullVol", 7, OBJECTSIZE);
+    fds::block::BlockOperations::setTaskTableSize(4096);
+
+    std::vector<std::unique_ptr<TestTask>> protoTasks;
+    auto write = [&] (uint64_t const object) {
+        protoTasks.emplace_back(new TestTask(protoTasks.size()));
+        auto writeTask = new fds::block::WriteTask(protoTasks.back().get());
+        auto writeBuffer = randomStrGen(OBJECTSIZE);
+        writeTask->setWriteBuffer(writeBuffer);
+        writeTask->set(object * OBJECTSIZE, OBJECTSIZE);
+        connector->executeTask(writeTask);
+    };
+    auto waitReleases = [&] (uint64_t const releases) {
+        for (int i = 0; (i < 500) && (releases > connector->getTaskPool()->getStats().releases); ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return connector->getTaskPool()->getStats().releases;
+    };
+    write(0);
+    write(1);
+    write(2);
+    EXPECT_EQ(xdi::ApiErrorCode::XDI_SERVICE_NOT_READY, protoTasks[2]->getError());
+    EXPECT_EQ(3, waitReleases(3));
+    EXPECT_EQ(xdi::ApiErrorCode::XDI_OK, protoTasks[0]->getError());
+    EXPECT_EQ(xdi::ApiErrorCode::XDI_OK, protoTasks[1]->getError());
+
+    // Once there is room again the retry goes through
+    write(2);
+    EXPECT_EQ(4, waitReleases(4));
+    EXPECT_EQ(xdi::ApiErrorCode::XDI_OK, protoTasks[3]->getError());
+    connector->shutdown();
+}
+
+// Two connections keep writing different halves of the same object, the
+// read-modify-writes are serialized so neither half is lost
+TEST_F(AsyncTestConnectorFixture, AsyncWriteTest_multi_conn_halves) {
+    uint32_t const rounds = 16;
+    uint32_t const half = OBJECTSIZE / 2;
+    {
+        std::lock_guard<std::mutex> lg(mutex);
+        count = 0;
+        expected = 2 * rounds;
+    }
+    auto other = std::make_shared<TestConnector>(interfacePtr, true);
+    other->init("testVol", 0, OBJECTSIZE);
+
+    std::shared_ptr<std::string> first, second;
+    for (uint32_t i = 0; i < rounds; ++i) {
+        first = randomStrGen(half);
+        second = randomStrGen(half);
+        auto writeTask = new fds::block::WriteTask(new TestTask(i));
+        writeTask->setWriteBuffer(first);
+        writeTask->set(0, half);
+        auto writeTask2 = new fds::block::WriteTask(new TestTask(i));
+        writeTask2->setWriteBuffer(second);
+        writeTask2->set(half, half);
+        connectorPtr->executeTask(writeTask);
+        other->executeTask(writeTask2);
+    }
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        EXPECT_TRUE(cond_var.wait_for(lock, std::chrono::seconds(5), [&] { return count == expected; }));
+    }
+
+    {
+        std::lock_guard<std::mutex> lg(mutex);
+        count = 0;
+        expected = 1;
+    }
+    auto readTask = new fds::block::ReadTask(new TestTask(rounds));
+    readTask->set(0, OBJECTSIZE);
+    other->executeTask(readTask);
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        EXPECT_TRUE(cond_var.wait_for(lock, std::chrono::seconds(5), [&] { return count == expected; }));
+    }
+    auto expectBuffer = std::make_shared<std::string>(*first + *second);
+    EXPECT_TRUE(other->verifyBuffer(expectBuffer));
+}
+
 // Write 128k block, partially overwritten by a smaller 8k block
 // |xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx|
 // |----------000000------------------------|
@@ -1318,6 +2434,66 @@ TEST_F(AsyncTestConnectorFixture, AsyncWriteTest_qd2_write_overlapping_writeSame
     EXPECT_TRUE(connectorPtr->verifyBuffer(writeBuffer));
 }
 
+// Two overlapping writes that both span a stripe boundary
+TEST_F(AsyncTestConnectorFixture, AsyncWriteTest_qd2_stripe_overlapping) {
+    uint32_t queueDepth = 2;
+    uint32_t writeSize = 2 * OBJECTSIZE;
+    uint64_t readOffset = STRIPE_BOUNDARY - (2 * OBJECTSIZE);
+    uint32_t readLength = 4 * OBJECTSIZE;
+    uint64_t writeOffset = readOffset + 32768;
+    uint64_t writeOffset2 = writeOffset + OBJECTSIZE;
+    uint64_t seqId = 0;
+    {
+        std::lock_guard<std::mutex> lg(mutex);
+        count = 0;
+        expected = queueDepth;
+    }
+
+    auto writeBuffer = randomStrGen(writeSize);
+    auto writeBuffer2 = randomStrGen(writeSize);
+    std::vector<std::shared_ptr<std::string>> bufs;
+    auto expectBuffer = std::make_shared<std::string>(readLength, '\0');
+    expectBuffer->replace(writeOffset - readOffset, writeSize, *writeBuffer);
+    expectBuffer->replace(writeOffset2 - readOffset, writeSize, *writeBuffer2);
+    auto expectBuffer2 = std::make_shared<std::string>(readLength, '\0');
+    expectBuffer2->replace(writeOffset2 - readOffset, writeSize, *writeBuffer2);
+    expectBuffer2->replace(writeOffset - readOffset, writeSize, *writeBuffer);
+    bufs.push_back(expectBuffer);
+    bufs.push_back(expectBuffer2);
+
+    auto testTask = new TestTask(seqId++);
+    auto testTask2 = new TestTask(seqId++);
+    auto writeTask = new fds::block::WriteTask(testTask);
+    auto writeTask2 = new fds::block::WriteTask(testTask2);
+    writeTask->setWriteBuffer(writeBuffer);
+    writeTask2->setWriteBuffer(writeBuffer2);
+    writeTask->set(writeOffset, writeBuffer->size());
+    writeTask2->set(writeOffset2, writeBuffer2->size());
+    connectorPtr->executeTask(writeTask);
+    connectorPtr->executeTask(writeTask2);
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        EXPECT_TRUE(cond_var.wait_for(lock, std::chrono::seconds(5), [&] { return count == expected; }));
+    }
+
+    {
+        std::lock_guard<std::mutex> lg(mutex);
+        count = 0;
+        expected = 1;
+    }
+
+    auto testTask3 = new TestTask(seqId++);
+    auto readTask = new fds::block::ReadTask(testTask3);
+    readTask->set(readOffset, readLength);
+    connectorPtr->executeTask(readTask);
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        EXPECT_TRUE(cond_var.wait_for(lock, std::chrono::seconds(5), [&] { return count == expected; }));
+    }
+    EXPECT_TRUE(connectorPtr->verifyBuffers(bufs));
+}
+
 int main(int argc, char* argv[]) {
     ::testing::InitGoogleTest(&argc, argv);
     xdi::SetTestLogger(xdi::createLogger("gtestBlockOperations"));
@@ -18,6 +18,8 @@
  */
 #include <gtest/gtest.h>
 
+#include <random>
+
 #include "connector/block/BlockTools.h"
 
 static const uint32_t lba_size = 512;
@@ -183,6 +185,23 @@ TEST(BlockToolsTest, LargeSpanningEndAligned) {
     EXPECT_EQ(oi.numTotalBlocks(), 21);
 }
 
+// Past 2^32 objects and longer than 4GiB
+TEST(BlockToolsTest, LargeVolume) {
+    fds::block::OffsetInfo oi;
+    uint64_t const object = (1ull << 32) + 5;
+    uint64_t const length = (6ull << 30) + 512;
+    calculateOffsets(oi, object * 131072 + 512, length, 131072);
+    EXPECT_EQ(object, oi.startBlockOffset);
+    EXPECT_EQ(object + 49152, oi.endBlockOffset);
+    EXPECT_EQ(512u, oi.startDiffOffset);
+    EXPECT_EQ(130048u, oi.endDiffOffset);
+    EXPECT_TRUE(oi.spansFullBlocks);
+    EXPECT_EQ(49151u, oi.numFullBlocks);
+    EXPECT_EQ(object + 1, oi.fullStartBlockOffset);
+    EXPECT_EQ(object + 49151, oi.fullEndBlockOffset);
+    EXPECT_EQ(49153u, oi.numTotalBlocks());
+}
+
 // MaxObjectSize of 0 was causing a coredump
 TEST(BlockToolsTest, ZeroMaxObjectSize) {
     fds::block::OffsetInfo oi;
@@ -196,6 +215,87 @@ TEST(BlockToolsTest, ZeroLength) {
 #endif
 }
 
+TEST(BlockToolsTest, ObjectGeometry) {
+    fds::block::ObjectGeometry pow2(131072);
+    EXPECT_TRUE(pow2.pow2);
+    EXPECT_EQ(17, pow2.shift);
+    EXPECT_EQ(131071, pow2.mask);
+    fds::block::ObjectGeometry odd(3 * lba_size);
+    EXPECT_FALSE(odd.pow2);
+    EXPECT_FALSE(fds::block::ObjectGeometry(0).pow2);
+    for (uint64_t offset : {0ul, 1ul, 131071ul, 131072ul, 1ul << 40, (1ul << 40) + 4097}) {
+        EXPECT_EQ(offset / 131072, pow2.object(offset));
+        EXPECT_EQ(offset % 131072, pow2.offsetInObject(offset));
+        EXPECT_EQ(offset * 131072, pow2.objectStart(offset));
+        EXPECT_EQ(offset / odd.size, odd.object(offset));
+        EXPECT_EQ(offset % odd.size, odd.offsetInObject(offset));
+        EXPECT_EQ(offset * odd.size, odd.objectStart(offset));
+    }
+}
+
+// The shift and mask path computes the same offsets as the division
+TEST(BlockToolsTest, GeometryEquivalence) {
+    std::mt19937_64 gen(1);
+    for (uint32_t objectSize : {512u, 4096u, 131072u, 1u << 20, 1u << 21, 3u * 4096}) {
+        fds::block::ObjectGeometry geometry(objectSize);
+        std::uniform_int_distribution<uint64_t> objects(0, 1ul << 20);
+        std::uniform_int_distribution<uint32_t> lbas(1, 4 * (objectSize / lba_size));
+        std::uniform_int_distribution<uint32_t> within(0, objectSize / lba_size);
+        for (int i = 0; i < 10000; ++i) {
+            uint64_t offset = objects(gen) * objectSize + within(gen) * lba_size;
+            uint32_t length = lbas(gen) * lba_size;
+            fds::block::OffsetInfo expected, oi;
+            calculateOffsets(expected, offset, length, objectSize);
+            calculateOffsets(oi, offset, length, geometry);
+            ASSERT_EQ(expected.startBlockOffset, oi.startBlockOffset);
+            ASSERT_EQ(expected.endBlockOffset, oi.endBlockOffset);
+            ASSERT_EQ(expected.startDiffOffset, oi.startDiffOffset);
+            ASSERT_EQ(expected.endDiffOffset, oi.endDiffOffset);
+            ASSERT_EQ(expected.spansFullBlocks, oi.spansFullBlocks);
+            ASSERT_EQ(expected.numFullBlocks, oi.numFullBlocks);
+            ASSERT_EQ(expected.fullStartBlockOffset, oi.fullStartBlockOffset);
+            ASSERT_EQ(expected.fullEndBlockOffset, oi.fullEndBlockOffset);
+        }
+    }
+}
+
+TEST(BlockToolsTest, FillPattern) {
+    std::string pattern;
+    for (int i = 0; i < 7; ++i) {
+        pattern += static_cast<char>('a' + i);
+    }
+    for (size_t length : {0, 3, 7, 14, 100, 4096}) {
+        std::string expected;
+        while (expected.size() < length) {
+            expected += pattern;
+        }
+        expected.resize(length);
+        std::string buf(length, '\0');
+        fds::block::fillPattern(&buf[0], length, pattern.data(), pattern.size());
+        EXPECT_EQ(expected, buf);
+    }
+}
+
+TEST(BlockToolsTest, IsZero) {
+    std::string buf(4096 + 64, '\0');
+    EXPECT_TRUE(fds::block::isZero(buf.data(), 0));
+    for (size_t start : {0, 1, 7, 31}) {
+        for (size_t length : {1, 15, 64, 127, 4096}) {
+            EXPECT_TRUE(fds::block::isZero(&buf[start], length));
+            // A single byte set anywhere in the range counts
+            for (size_t i : {size_t(0), length / 2, length - 1}) {
+                buf[start + i] = 1;
+                EXPECT_FALSE(fds::block::isZero(&buf[start], length));
+                buf[start + i] = '\0';
+            }
+            // Bytes just outside the range don't
+            buf[start + length] = 1;
+            EXPECT_TRUE(fds::block::isZero(&buf[start], length));
+            buf[start + length] = '\0';
+        }
+    }
+}
+
 int main(int argc, char* argv[]) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
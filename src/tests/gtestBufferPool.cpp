@@ -0,0 +1,112 @@
+/*
+ * gtestBufferPool.cpp
+ *
+ * Copyright (c) 2016, Andreas Griesshammer <andreas@formationds.com>
+ * Copyright (c) 2016, Formation Data Systems
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+
+#include "log/test_log.h"
+#include "connector/block/BufferPool.h"
+
+static const size_t OBJECTSIZE = 4096;
+
+TEST(BufferPool, Reuse) {
+    fds::block::BufferPool pool(OBJECTSIZE, 4);
+    EXPECT_TRUE(pool.enabled());
+    char const* data {nullptr};
+    {
+        auto buf = pool.get(OBJECTSIZE);
+        EXPECT_EQ(OBJECTSIZE, buf->size());
+        data = buf->data();
+        buf->assign(OBJECTSIZE, 'a');
+    }
+    auto stats = pool.getStats();
+    EXPECT_EQ(1, stats.allocations);
+    EXPECT_EQ(1, stats.releases);
+    EXPECT_EQ(1, stats.buffers);
+
+    // The same memory comes back, sized to what is asked for
+    auto buf = pool.get(512);
+    EXPECT_EQ(data, buf->data());
+    EXPECT_EQ(512, buf->size());
+    EXPECT_EQ(std::string(512, 'a'), *buf);
+    stats = pool.getStats();
+    EXPECT_EQ(1, stats.allocations);
+    EXPECT_EQ(1, stats.reuses);
+    EXPECT_EQ(0, stats.buffers);
+
+    // Growing back to an object doesn't reallocate either
+    buf->resize(OBJECTSIZE);
+    EXPECT_EQ(data, buf->data());
+}
+
+TEST(BufferPool, ZeroedCopy) {
+    fds::block::BufferPool pool(OBJECTSIZE, 4);
+    pool.get(OBJECTSIZE)->assign(OBJECTSIZE, 'a');
+    auto zeros = pool.zeroed(OBJECTSIZE);
+    EXPECT_EQ(std::string(OBJECTSIZE, '\0'), *zeros);
+    std::string src(100, 'b');
+    auto copy = pool.copy(src.data(), src.size());
+    EXPECT_EQ(src, *copy);
+    EXPECT_EQ(2, pool.getStats().allocations);
+}
+
+TEST(BufferPool, Limits) {
+    fds::block::BufferPool pool(OBJECTSIZE, 2);
+    {
+        std::vector<fds::block::BufferPool::buffer_ptr_type> bufs;
+        for (int i = 0; i < 4; ++i) {
+            bufs.push_back(pool.get(OBJECTSIZE));
+        }
+        // Longer than an object, allocated and never kept
+        bufs.push_back(pool.get(OBJECTSIZE * 2));
+        EXPECT_EQ(OBJECTSIZE * 2, bufs.back()->size());
+    }
+    auto stats = pool.getStats();
+    EXPECT_EQ(5, stats.allocations);
+    EXPECT_EQ(4, stats.releases);
+    EXPECT_EQ(2, stats.discards);
+    EXPECT_EQ(2, stats.buffers);
+}
+
+// Buffers outliving the pool are still released properly
+TEST(BufferPool, OutlivesPool) {
+    fds::block::BufferPool::buffer_ptr_type buf;
+    {
+        fds::block::BufferPool pool(OBJECTSIZE, 2);
+        buf = pool.get(OBJECTSIZE);
+    }
+    buf->assign(OBJECTSIZE, 'a');
+    buf.reset();
+}
+
+TEST(BufferPool, Disabled) {
+    fds::block::BufferPool pool(OBJECTSIZE, 0);
+    EXPECT_FALSE(pool.enabled());
+    pool.get(OBJECTSIZE);
+    pool.get(OBJECTSIZE);
+    auto stats = pool.getStats();
+    EXPECT_EQ(2, stats.allocations);
+    EXPECT_EQ(0, stats.reuses);
+    EXPECT_EQ(0, stats.buffers);
+}
+
+int main(int argc, char* argv[]) {
+    ::testing::InitGoogleTest(&argc, argv);
+    xdi::SetTestLogger(xdi::createLogger("gtestBufferPool"));
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,115 @@
+/*
+ * gtestCommitGroup.cpp
+ *
+ * Copyright (c) 2016, Andreas Griesshammer <andreas@formationds.com>
+ * Copyright (c) 2016, Formation Data Systems
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+#include <condition_variable>
+#include <mutex>
+
+#include "log/test_log.h"
+#include "connector/block/CommitGroup.h"
+
+// Collects whatever the group sends
+class CommitGroupFixture : public ::testing::Test {
+protected:
+    struct Sent {
+        xdi::RequestHandle                  requestId;
+        xdi::WriteBlobRequest               req;
+        std::vector<xdi::RequestHandle>     group;
+    };
+
+    std::mutex                  lock;
+    std::condition_variable     cv;
+    std::vector<Sent>           sent;
+
+    fds::block::CommitGroup::send_fn sendFn() {
+        return [this] (xdi::RequestHandle const& requestId,
+                       xdi::WriteBlobRequest& req,
+                       std::vector<xdi::RequestHandle>& group) {
+            std::lock_guard<std::mutex> lg(lock);
+            sent.push_back(Sent{requestId, req, group});
+            cv.notify_one();
+        };
+    }
+
+    static xdi::WriteBlobRequest makeRequest(xdi::ObjectOffsetVal const start, xdi::ObjectOffsetVal const numObjects) {
+        xdi::WriteBlobRequest req;
+        for (auto i = start; i < start + numObjects; ++i) {
+            xdi::ObjectDescriptor od;
+            od.objectId = std::to_string(i);
+            req.blob.objects.emplace(i, od);
+        }
+        return req;
+    }
+};
+
+// The group goes out once it has maxRanges ranges
+TEST_F(CommitGroupFixture, MaxRanges) {
+    fds::block::CommitGroup group(std::chrono::seconds(10), 3, sendFn());
+    group.add(xdi::RequestHandle{1, 0}, makeRequest(0, 2));
+    group.add(xdi::RequestHandle{2, 1}, makeRequest(10, 1));
+    EXPECT_TRUE(sent.empty());
+    group.add(xdi::RequestHandle{1, 2}, makeRequest(5, 3));
+    ASSERT_EQ(1, sent.size());
+    EXPECT_EQ(1, sent[0].requestId.handle);
+    EXPECT_EQ(0, sent[0].requestId.seq);
+    ASSERT_EQ(3, sent[0].group.size());
+    EXPECT_EQ(2, sent[0].group[1].handle);
+    EXPECT_EQ(2, sent[0].group[2].seq);
+    EXPECT_EQ(6, sent[0].req.blob.objects.size());
+    EXPECT_EQ("10", sent[0].req.blob.objects[10].objectId);
+
+    // Nothing left to send
+    group.flush();
+    EXPECT_EQ(1, sent.size());
+    auto stats = group.getStats();
+    EXPECT_EQ(3, stats.ranges);
+    EXPECT_EQ(1, stats.commits);
+}
+
+// The group goes out once the interval has passed
+TEST_F(CommitGroupFixture, Interval) {
+    fds::block::CommitGroup group(std::chrono::milliseconds(5), 64, sendFn());
+    group.add(xdi::RequestHandle{1, 0}, makeRequest(0, 1));
+    group.add(xdi::RequestHandle{2, 0}, makeRequest(1, 1));
+    std::unique_lock<std::mutex> l(lock);
+    EXPECT_TRUE(cv.wait_for(l, std::chrono::seconds(10), [this] { return false == sent.empty(); }));
+    ASSERT_EQ(1, sent.size());
+    EXPECT_EQ(2, sent[0].group.size());
+    EXPECT_EQ(2, sent[0].req.blob.objects.size());
+}
+
+TEST_F(CommitGroupFixture, Stop) {
+    fds::block::CommitGroup group(std::chrono::seconds(10), 64, sendFn());
+    EXPECT_TRUE(group.enabled());
+    group.add(xdi::RequestHandle{1, 0}, makeRequest(0, 1));
+    group.stop();
+    group.flush();
+    group.add(xdi::RequestHandle{2, 0}, makeRequest(1, 1));
+    group.flush();
+    EXPECT_TRUE(sent.empty());
+
+    fds::block::CommitGroup disabled(std::chrono::microseconds(0), 64, sendFn());
+    EXPECT_FALSE(disabled.enabled());
+}
+
+int main(int argc, char* argv[]) {
+    ::testing::InitGoogleTest(&argc, argv);
+    xdi::SetTestLogger(xdi::createLogger("gtestCommitGroup"));
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,104 @@
+/*
+ * gtestObjectCache.cpp
+ *
+ * Copyright (c) 2016, Andreas Griesshammer <andreas@formationds.com>
+ * Copyright (c) 2016, Formation Data Systems
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+
+#include "log/test_log.h"
+#include "connector/block/ObjectCache.h"
+
+// The cache has 16 shards, each gets an equal part of the limit
+static const size_t SHARDS = 16;
+static const size_t OBJECTSIZE = 1024;
+
+static std::shared_ptr<std::string> makeObject(char const c) {
+    return std::make_shared<std::string>(OBJECTSIZE, c);
+}
+
+TEST(ObjectCache, GetInsert) {
+    fds::block::ObjectCache cache(SHARDS * OBJECTSIZE * 4);
+    EXPECT_EQ(nullptr, cache.get("1"));
+    auto obj = makeObject('a');
+    cache.insert("1", obj);
+    EXPECT_EQ(obj, cache.get("1"));
+    // Empty buffers are never cached
+    cache.insert("2", std::make_shared<std::string>());
+    cache.insert("3", nullptr);
+    EXPECT_EQ(nullptr, cache.get("2"));
+    EXPECT_EQ(nullptr, cache.get("3"));
+
+    auto stats = cache.getStats();
+    EXPECT_EQ(1, stats.hits);
+    EXPECT_EQ(3, stats.misses);
+    EXPECT_EQ(1, stats.insertions);
+    EXPECT_EQ(1, stats.objects);
+    EXPECT_EQ(OBJECTSIZE, stats.bytes);
+
+    cache.clear();
+    EXPECT_EQ(nullptr, cache.get("1"));
+    EXPECT_EQ(0, cache.getStats().bytes);
+}
+
+TEST(ObjectCache, MemoryLimit) {
+    size_t limit = SHARDS * OBJECTSIZE * 2;
+    fds::block::ObjectCache cache(limit);
+    for (int i = 0; i < 1000; ++i) {
+        cache.insert(std::to_string(i), makeObject('a'));
+        EXPECT_GE(limit, cache.getStats().bytes);
+    }
+    auto stats = cache.getStats();
+    EXPECT_EQ(1000, stats.insertions);
+    EXPECT_EQ(stats.insertions - stats.objects, stats.evictions);
+    // Objects larger than a shard are not cached
+    cache.insert("big", std::make_shared<std::string>(limit, 'b'));
+    EXPECT_EQ(nullptr, cache.get("big"));
+}
+
+// Within a shard the least recently used object is evicted first
+TEST(ObjectCache, LeastRecentlyUsed) {
+    fds::block::ObjectCache cache(SHARDS * OBJECTSIZE * 2);
+    // Find three ids that end up in the same shard by filling it
+    std::vector<std::string> ids;
+    for (int i = 0; ids.size() < 3; ++i) {
+        auto id = std::to_string(i);
+        if (std::hash<std::string>()(id) % SHARDS == std::hash<std::string>()("0") % SHARDS) {
+            ids.push_back(id);
+        }
+    }
+    cache.insert(ids[0], makeObject('a'));
+    cache.insert(ids[1], makeObject('b'));
+    EXPECT_NE(nullptr, cache.get(ids[0]));
+    cache.insert(ids[2], makeObject('c'));
+    EXPECT_NE(nullptr, cache.get(ids[0]));
+    EXPECT_EQ(nullptr, cache.get(ids[1]));
+    EXPECT_NE(nullptr, cache.get(ids[2]));
+}
+
+TEST(ObjectCache, Disabled) {
+    fds::block::ObjectCache cache(0);
+    EXPECT_FALSE(cache.enabled());
+    cache.insert("1", makeObject('a'));
+    EXPECT_EQ(nullptr, cache.get("1"));
+    EXPECT_EQ(0, cache.getStats().insertions);
+}
+
+int main(int argc, char* argv[]) {
+    ::testing::InitGoogleTest(&argc, argv);
+    xdi::SetTestLogger(xdi::createLogger("gtestObjectCache"));
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,174 @@
+/*
+ * gtestTaskPool.cpp
+ *
+ * Copyright (c) 2016, Andreas Griesshammer <andreas@formationds.com>
+ * Copyright (c) 2016, Formation Data Systems
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <map>
+#include <new>
+
+#include "log/test_log.h"
+#include "connector/block/BufferPool.h"
+#include "connector/block/TaskPool.h"
+#include "connector/block/Tasks.h"
+
+// Count the allocations of the test, the default operator delete frees
+// what this allocates
+static std::atomic<uint64_t> allocations {0};
+
+void* operator new(size_t size) {
+    ++allocations;
+    if (auto p = std::malloc(size)) return p;
+    throw std::bad_alloc();
+}
+
+static const uint32_t OBJECTSIZE = 4096;
+
+struct TestTask : public fds::block::ProtoTask {
+    explicit TestTask(uint64_t const hdl) : fds::block::ProtoTask(hdl) {}
+};
+
+TEST(TaskPool, ReuseByKind) {
+    fds::block::TaskPool pool(4);
+    EXPECT_TRUE(pool.enabled());
+    TestTask p(1);
+    auto read = pool.getRead(&p);
+    auto write = pool.getWrite(&p);
+    pool.release(read);
+    pool.release(write);
+    auto stats = pool.getStats();
+    EXPECT_EQ(2, stats.allocations);
+    EXPECT_EQ(2, stats.releases);
+    EXPECT_EQ(2, stats.tasks);
+
+    // Only a task of the same kind is reused
+    auto writeSame = pool.getWriteSame(&p);
+    EXPECT_NE(static_cast<fds::block::BlockTask*>(write), writeSame);
+    EXPECT_EQ(write, pool.getWrite(&p));
+    EXPECT_EQ(read, pool.getRead(&p));
+    EXPECT_EQ(&p, read->getProtoTask());
+    stats = pool.getStats();
+    EXPECT_EQ(3, stats.allocations);
+    EXPECT_EQ(2, stats.reuses);
+    EXPECT_EQ(0, stats.tasks);
+    pool.release(read);
+    pool.release(write);
+    pool.release(writeSame);
+}
+
+TEST(TaskPool, ReleaseResets) {
+    fds::block::TaskPool pool(4);
+    TestTask p(1);
+    auto buf = std::make_shared<std::string>(OBJECTSIZE, 'a');
+    auto write = pool.getWrite(&p);
+    write->setMaxObjectSize(OBJECTSIZE);
+    write->set(OBJECTSIZE + 512, 512);
+    write->setWriteBuffer(buf);
+    write->keepBufferForWrite(0, 1, 512, fds::block::BufferView(buf));
+    std::map<uint32_t, std::string> ids {{0, "id"}};
+    write->setReadObjectIds(ids);
+    EXPECT_EQ(3, buf.use_count());
+    pool.release(write);
+
+    // The buffers are let go of on release, not on reuse
+    EXPECT_EQ(1, buf.use_count());
+    TestTask p2(2);
+    write = pool.getWrite(&p2);
+    EXPECT_EQ(&p2, write->getProtoTask());
+    EXPECT_EQ(0, write->getOffset());
+    EXPECT_EQ(0, write->getLength());
+    EXPECT_EQ(0, write->maxObjectSize());
+    EXPECT_TRUE(write->getReadObjectId(0).empty());
+    std::shared_ptr<std::string> none;
+    write->getWriteBuffer(none);
+    EXPECT_EQ(nullptr, none);
+    pool.release(write);
+}
+
+TEST(TaskPool, Limits) {
+    fds::block::TaskPool pool(1);
+    TestTask p(1);
+    auto first = pool.getRead(&p);
+    auto second = pool.getRead(&p);
+    pool.release(first);
+    pool.release(second);
+    fds::block::UnmapTask::unmap_vec_ptr write_vec(new fds::block::UnmapTask::unmap_vec);
+    pool.release(new fds::block::UnmapTask(&p, std::move(write_vec)));
+    auto stats = pool.getStats();
+    EXPECT_EQ(3, stats.releases);
+    EXPECT_EQ(2, stats.discards);
+    EXPECT_EQ(1, stats.tasks);
+
+    fds::block::TaskPool disabled(0);
+    EXPECT_FALSE(disabled.enabled());
+    disabled.release(disabled.getWrite(&p));
+    EXPECT_EQ(1, disabled.getStats().discards);
+    EXPECT_EQ(0, disabled.getStats().tasks);
+}
+
+// Once every kind of task has been used, the single object read and write
+// of a connection go through their tasks without allocating
+TEST(TaskPool, NoAllocationsAtSteadyState) {
+    fds::block::TaskPool pool(4);
+    fds::block::BufferPool buffers(OBJECTSIZE, 4);
+    TestTask p(1);
+    auto object = std::make_shared<std::string>(OBJECTSIZE, 'a');
+    auto empty = std::make_shared<std::string>(OBJECTSIZE, '\0');
+    std::map<uint32_t, std::string> ids {{0, "0123456789012345678901234567890123456789"}};
+    std::vector<std::shared_ptr<std::string>> objects;
+    objects.reserve(1);
+    std::vector<fds::block::BufferView> response;
+    response.reserve(1);
+
+    auto cycle = [&] () {
+        auto read = pool.getRead(&p);
+        read->setMaxObjectSize(OBJECTSIZE);
+        read->set(512, 1024);
+        read->setReadObjectIds(ids);
+        objects.push_back(object);
+        read->handleReadResponse(objects, empty);
+        read->swapReadBuffers(response);
+        EXPECT_EQ(1024, response.front().size());
+        response.clear();
+        read->swapReadBuffers(response);
+        pool.release(read);
+
+        auto write = pool.getWrite(&p);
+        write->setMaxObjectSize(OBJECTSIZE);
+        write->set(512, 1024);
+        write->setWriteBuffer(object);
+        write->setReadObjectIds(ids);
+        write->keepBufferForWrite(0, 0, 512, write->getWriteSlice(0, 1024, buffers));
+        EXPECT_EQ(1024, write->getBuffer(0).size());
+        pool.release(write);
+    };
+    cycle();
+    auto before = allocations.load();
+    for (int i = 0; i < 100; ++i) {
+        cycle();
+    }
+    EXPECT_EQ(before, allocations.load());
+    EXPECT_EQ(2, pool.getStats().allocations);
+}
+
+int main(int argc, char* argv[]) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
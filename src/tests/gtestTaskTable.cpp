@@ -0,0 +1,172 @@
+/*
+ * gtestTaskTable.cpp
+ *
+ * Copyright (c) 2016, Andreas Griesshammer <andreas@formationds.com>
+ * Copyright (c) 2016, Formation Data Systems
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "log/test_log.h"
+#include "connector/block/TaskTable.h"
+
+struct TestTask {
+    uint64_t handle;
+};
+
+using TestTable = fds::block::TaskTable<TestTask>;
+
+TEST(TaskTable, InsertFindRemove) {
+    TestTable table(16);
+    TestTask t1 {1}, t2 {2};
+    EXPECT_TRUE(table.insert(t1.handle, &t1));
+    EXPECT_TRUE(table.insert(t2.handle, &t2));
+    EXPECT_EQ(&t1, table.find(1));
+    EXPECT_EQ(&t2, table.find(2));
+    EXPECT_EQ(nullptr, table.find(3));
+    // Duplicate handles are refused
+    EXPECT_FALSE(table.insert(t1.handle, &t2));
+    // Only the task that was inserted can be removed, and only once
+    EXPECT_FALSE(table.remove(1, &t2));
+    EXPECT_TRUE(table.remove(1, &t1));
+    EXPECT_FALSE(table.remove(1, &t1));
+    EXPECT_EQ(nullptr, table.find(1));
+    EXPECT_EQ(&t2, table.find(2));
+    // Handle can be reused once removed
+    EXPECT_TRUE(table.insert(t1.handle, &t1));
+    EXPECT_EQ(&t1, table.find(1));
+}
+
+TEST(TaskTable, Full) {
+    TestTable table(10);
+    ASSERT_EQ(16, table.capacity());
+    std::vector<TestTask> tasks(17);
+    for (uint64_t i = 0; i < tasks.size(); ++i) {
+        tasks[i].handle = i << 32;
+        EXPECT_EQ(i < 16, table.insert(tasks[i].handle, &tasks[i]));
+    }
+    // Every entry is still found with the table full
+    for (uint64_t i = 0; i < 16; ++i) {
+        EXPECT_EQ(&tasks[i], table.find(tasks[i].handle));
+    }
+    EXPECT_TRUE(table.remove(tasks[3].handle, &tasks[3]));
+    EXPECT_TRUE(table.insert(tasks[16].handle, &tasks[16]));
+    EXPECT_EQ(&tasks[16], table.find(tasks[16].handle));
+    EXPECT_EQ(nullptr, table.find(tasks[3].handle));
+}
+
+// A task put back under a new handle isn't found under its old one
+TEST(TaskTable, ReusedTask) {
+    TestTable table(16);
+    TestTask t1 {1};
+    EXPECT_TRUE(table.insert(1, &t1));
+    EXPECT_TRUE(table.remove(1, &t1));
+    t1.handle = 2;
+    EXPECT_TRUE(table.insert(2, &t1));
+    EXPECT_EQ(nullptr, table.find(1));
+    EXPECT_FALSE(table.remove(1, &t1));
+    EXPECT_EQ(&t1, table.find(2));
+}
+
+// The probe length follows the entries in the table back down
+TEST(TaskTable, ProbeShrinks) {
+    TestTable table(16);
+    std::vector<TestTask> tasks(16);
+    for (uint64_t i = 0; i < tasks.size(); ++i) {
+        tasks[i].handle = i << 32;
+        EXPECT_TRUE(table.insert(tasks[i].handle, &tasks[i]));
+    }
+    EXPECT_LT(0, table.probeLength());
+    for (auto& t : tasks) {
+        EXPECT_TRUE(table.remove(t.handle, &t));
+    }
+    EXPECT_EQ(0, table.probeLength());
+
+    for (uint64_t i = 0; i < tasks.size(); ++i) {
+        EXPECT_TRUE(table.insert(tasks[i].handle, &tasks[i]));
+    }
+    table.drain([] (TestTask*) {});
+    EXPECT_EQ(0, table.probeLength());
+}
+
+TEST(TaskTable, Drain) {
+    TestTable table(64);
+    std::vector<TestTask> tasks(32);
+    for (uint64_t i = 0; i < tasks.size(); ++i) {
+        tasks[i].handle = i;
+        EXPECT_TRUE(table.insert(i, &tasks[i]));
+    }
+    size_t drained = 0;
+    table.drain([&drained] (TestTask*) { ++drained; });
+    EXPECT_EQ(tasks.size(), drained);
+    for (auto& t : tasks) {
+        EXPECT_EQ(nullptr, table.find(t.handle));
+        EXPECT_FALSE(table.remove(t.handle, &t));
+    }
+}
+
+// Tasks are inserted by one thread while several completion threads
+// look them up and race to remove them, every task is removed once.
+TEST(TaskTable, ConcurrentCompletions) {
+    static const uint64_t NUMTASKS = 1 << 16;
+    static const uint32_t NUMTHREADS = 4;
+    TestTable table(256);
+    std::vector<TestTask> tasks(NUMTASKS);
+    std::atomic<uint64_t> inserted {0};
+    std::atomic<uint64_t> removed {0};
+
+    std::vector<std::thread> completions;
+    for (uint32_t t = 0; t < NUMTHREADS; ++t) {
+        completions.emplace_back([&] {
+            uint64_t next = 0;
+            while (NUMTASKS > next) {
+                if (next >= inserted.load()) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                auto task = table.find(next);
+                if ((nullptr != task) && table.remove(next, task)) {
+                    EXPECT_EQ(next, task->handle);
+                    ++removed;
+                }
+                ++next;
+            }
+        });
+    }
+    for (uint64_t i = 0; i < NUMTASKS; ++i) {
+        tasks[i].handle = i;
+        // Keep a bounded number in flight like a connector would
+        while (false == table.insert(i, &tasks[i])) {
+            std::this_thread::yield();
+        }
+        ++inserted;
+    }
+    for (auto& t : completions) {
+        t.join();
+    }
+    // Whatever the completion threads raced past is still in the table
+    table.drain([&removed] (TestTask*) { ++removed; });
+    EXPECT_EQ(NUMTASKS, removed.load());
+}
+
+int main(int argc, char* argv[]) {
+    ::testing::InitGoogleTest(&argc, argv);
+    xdi::SetTestLogger(xdi::createLogger("gtestTaskTable"));
+    return RUN_ALL_TESTS();
+}
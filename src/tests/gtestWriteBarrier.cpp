@@ -0,0 +1,94 @@
+/*
+ * gtestWriteBarrier.cpp
+ *
+ * Copyright (c) 2016, Andreas Griesshammer <andreas@formationds.com>
+ * Copyright (c) 2016, Formation Data Systems
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+
+#include "log/test_log.h"
+#include "connector/block/Tasks.h"
+#include "connector/block/WriteBarrier.h"
+
+// Nothing to wait for without writes in flight
+TEST(WriteBarrier, NoWrites) {
+    fds::block::WriteBarrier barrier;
+    fds::block::FlushTask flush(nullptr);
+    EXPECT_FALSE(barrier.wait(&flush));
+    EXPECT_FALSE(barrier.waiting());
+
+    // A write started and done in between doesn't change that
+    std::vector<fds::block::BlockTask*> passed;
+    barrier.done(barrier.start(), passed);
+    EXPECT_TRUE(passed.empty());
+    EXPECT_FALSE(barrier.wait(&flush));
+    auto stats = barrier.getStats();
+    EXPECT_EQ(2, stats.barriers);
+    EXPECT_EQ(0, stats.waited);
+}
+
+// A task waits for the writes started before it, not the ones after
+TEST(WriteBarrier, WritesBefore) {
+    fds::block::WriteBarrier barrier;
+    fds::block::FlushTask flush(nullptr);
+    std::vector<fds::block::BlockTask*> passed;
+    auto first = barrier.start();
+    auto second = barrier.start();
+    EXPECT_TRUE(barrier.wait(&flush));
+    EXPECT_TRUE(barrier.waiting());
+    auto later = barrier.start();
+
+    barrier.done(second, passed);
+    EXPECT_TRUE(passed.empty());
+    barrier.done(first, passed);
+    ASSERT_EQ(1, passed.size());
+    EXPECT_EQ(&flush, passed[0]);
+    EXPECT_FALSE(barrier.waiting());
+
+    passed.clear();
+    barrier.done(later, passed);
+    EXPECT_TRUE(passed.empty());
+}
+
+// Tasks pass in order as the epochs they wait for are done
+TEST(WriteBarrier, Epochs) {
+    fds::block::WriteBarrier barrier;
+    fds::block::FlushTask flush1(nullptr), flush2(nullptr), flush3(nullptr);
+    std::vector<fds::block::BlockTask*> passed;
+    auto first = barrier.start();
+    EXPECT_TRUE(barrier.wait(&flush1));
+    auto second = barrier.start();
+    EXPECT_TRUE(barrier.wait(&flush2));
+    // Still held back by second
+    EXPECT_TRUE(barrier.wait(&flush3));
+
+    // Later writes done first hold nothing back
+    barrier.done(second, passed);
+    EXPECT_TRUE(passed.empty());
+    barrier.done(first, passed);
+    ASSERT_EQ(3, passed.size());
+    EXPECT_EQ(&flush1, passed[0]);
+    EXPECT_EQ(&flush2, passed[1]);
+    EXPECT_EQ(&flush3, passed[2]);
+    EXPECT_FALSE(barrier.waiting());
+    EXPECT_EQ(3, barrier.getStats().waited);
+}
+
+int main(int argc, char* argv[]) {
+    ::testing::InitGoogleTest(&argc, argv);
+    xdi::SetTestLogger(xdi::createLogger("gtestWriteBarrier"));
+    return RUN_ALL_TESTS();
+}
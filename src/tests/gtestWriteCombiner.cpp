@@ -0,0 +1,168 @@
+/*
+ * gtestWriteCombiner.cpp
+ *
+ * Copyright (c) 2016, Andreas Griesshammer <andreas@formationds.com>
+ * Copyright (c) 2016, Formation Data Systems
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+#include <condition_variable>
+#include <mutex>
+
+#include "log/test_log.h"
+#include "connector/block/BufferPool.h"
+#include "connector/block/Tasks.h"
+#include "connector/block/WriteCombiner.h"
+
+static const uint32_t OBJECTSIZE = 16384;
+static const uint32_t WRITESIZE = 4096;
+
+class TestTask : public fds::block::ProtoTask {
+public:
+    TestTask(uint64_t const hdl) : fds::block::ProtoTask(hdl) {}
+};
+
+// Owns the tasks and collects whatever the combiner flushes
+class CombinerFixture : public ::testing::Test {
+protected:
+    std::mutex                                          lock;
+    std::condition_variable                             cv;
+    std::vector<fds::block::WriteTask*>                 flushed;
+    std::vector<std::unique_ptr<TestTask>>              protoTasks;
+    std::vector<std::unique_ptr<fds::block::WriteTask>> tasks;
+    std::shared_ptr<fds::block::BufferPool>             pool {std::make_shared<fds::block::BufferPool>(OBJECTSIZE, 4)};
+
+    fds::block::WriteCombiner::flush_fn flushFn() {
+        return [this] (fds::block::WriteTask* t) {
+            std::lock_guard<std::mutex> lg(lock);
+            flushed.push_back(t);
+            cv.notify_one();
+        };
+    }
+
+    fds::block::WriteTask* makeTask(uint64_t const offset, uint32_t const length, char const c) {
+        protoTasks.emplace_back(new TestTask(protoTasks.size()));
+        tasks.emplace_back(new fds::block::WriteTask(protoTasks.back().get()));
+        auto buf = std::make_shared<std::string>(length, c);
+        tasks.back()->setWriteBuffer(buf);
+        tasks.back()->set(offset, length);
+        return tasks.back().get();
+    }
+
+    std::string bufferOf(fds::block::WriteTask* t) {
+        std::shared_ptr<std::string> buf;
+        t->getWriteBuffer(buf);
+        return *buf;
+    }
+};
+
+// Sequential writes filling an object go out as one full object write
+TEST_F(CombinerFixture, FullObject) {
+    fds::block::WriteCombiner combiner(OBJECTSIZE, std::chrono::seconds(10), pool, flushFn());
+    std::string expected;
+    for (uint32_t i = 0; i < OBJECTSIZE / WRITESIZE; ++i) {
+        EXPECT_TRUE(flushed.empty());
+        EXPECT_TRUE(combiner.add(makeTask(OBJECTSIZE + i * WRITESIZE, WRITESIZE, 'a' + i)));
+        expected += std::string(WRITESIZE, 'a' + i);
+    }
+    ASSERT_EQ(1, flushed.size());
+    EXPECT_EQ(tasks.front().get(), flushed.front());
+    EXPECT_EQ(OBJECTSIZE, flushed.front()->getOffset());
+    EXPECT_EQ(OBJECTSIZE, flushed.front()->getLength());
+    EXPECT_EQ(expected, bufferOf(flushed.front()));
+
+    std::vector<fds::block::WriteTask*> combined;
+    flushed.front()->swapCombined(combined);
+    EXPECT_EQ(OBJECTSIZE / WRITESIZE - 1, combined.size());
+    // The full object is the pooled buffer it was combined in
+    EXPECT_EQ(1, pool->getStats().allocations);
+
+    auto stats = combiner.getStats();
+    EXPECT_EQ(OBJECTSIZE / WRITESIZE - 1, stats.combined);
+    EXPECT_EQ(1, stats.flushes);
+    EXPECT_EQ(1, stats.fullObjects);
+    EXPECT_EQ(0, stats.objects);
+}
+
+// Overlapping writes are combined with the later one winning, a write
+// that isn't adjacent flushes what is buffered for the object
+TEST_F(CombinerFixture, OverlapAndGap) {
+    fds::block::WriteCombiner combiner(OBJECTSIZE, std::chrono::seconds(10), pool, flushFn());
+    EXPECT_TRUE(combiner.add(makeTask(1024, 2048, 'a')));
+    EXPECT_TRUE(combiner.add(makeTask(2048, 2048, 'b')));
+    EXPECT_TRUE(flushed.empty());
+    EXPECT_TRUE(combiner.add(makeTask(3 * WRITESIZE, WRITESIZE, 'c')));
+    ASSERT_EQ(1, flushed.size());
+    EXPECT_EQ(1024, flushed.front()->getOffset());
+    EXPECT_EQ(3072, flushed.front()->getLength());
+    EXPECT_EQ(std::string(1024, 'a') + std::string(2048, 'b'), bufferOf(flushed.front()));
+    // The object combined in went back to the pool, the write has a copy
+    EXPECT_EQ(2, pool->getStats().allocations);
+    EXPECT_EQ(1, pool->getStats().buffers);
+
+    // A lone write is flushed untouched
+    combiner.flush(0, 0);
+    ASSERT_EQ(2, flushed.size());
+    EXPECT_EQ(tasks.back().get(), flushed.back());
+    EXPECT_EQ(3 * WRITESIZE, flushed.back()->getOffset());
+    EXPECT_EQ(WRITESIZE, flushed.back()->getLength());
+    EXPECT_EQ(0, combiner.getStats().objects);
+}
+
+// Buffered writes go out once the window has passed
+TEST_F(CombinerFixture, Window) {
+    fds::block::WriteCombiner combiner(OBJECTSIZE, std::chrono::milliseconds(5), pool, flushFn());
+    EXPECT_TRUE(combiner.add(makeTask(0, WRITESIZE, 'a')));
+    EXPECT_TRUE(combiner.add(makeTask(WRITESIZE, WRITESIZE, 'b')));
+    std::unique_lock<std::mutex> l(lock);
+    EXPECT_TRUE(cv.wait_for(l, std::chrono::seconds(10), [this] { return false == flushed.empty(); }));
+    ASSERT_EQ(1, flushed.size());
+    EXPECT_EQ(2 * WRITESIZE, flushed.front()->getLength());
+}
+
+// Full objects, writes spanning objects and a disabled combiner don't buffer
+TEST_F(CombinerFixture, NotCombined) {
+    fds::block::WriteCombiner combiner(OBJECTSIZE, std::chrono::seconds(10), pool, flushFn());
+    EXPECT_FALSE(combiner.add(makeTask(0, OBJECTSIZE, 'a')));
+    EXPECT_FALSE(combiner.add(makeTask(OBJECTSIZE - WRITESIZE, 2 * WRITESIZE, 'a')));
+
+    fds::block::WriteCombiner disabled(OBJECTSIZE, std::chrono::microseconds(0), pool, flushFn());
+    EXPECT_FALSE(disabled.enabled());
+    EXPECT_FALSE(disabled.add(makeTask(0, WRITESIZE, 'a')));
+
+    combiner.stop();
+    EXPECT_FALSE(combiner.add(makeTask(0, WRITESIZE, 'a')));
+    EXPECT_TRUE(flushed.empty());
+}
+
+// Stopping hands out what is still buffered instead of losing the writes
+TEST_F(CombinerFixture, StopFlushes) {
+    fds::block::WriteCombiner combiner(OBJECTSIZE, std::chrono::seconds(10), pool, flushFn());
+    EXPECT_TRUE(combiner.add(makeTask(0, WRITESIZE, 'a')));
+    EXPECT_TRUE(combiner.add(makeTask(WRITESIZE, WRITESIZE, 'b')));
+    EXPECT_TRUE(combiner.add(makeTask(OBJECTSIZE, WRITESIZE, 'c')));
+    EXPECT_TRUE(flushed.empty());
+    combiner.stop();
+    ASSERT_EQ(2, flushed.size());
+    EXPECT_EQ(2 * WRITESIZE, flushed.front()->getLength());
+    EXPECT_EQ(tasks.back().get(), flushed.back());
+    EXPECT_EQ(0, combiner.getStats().objects);
+}
+
+int main(int argc, char* argv[]) {
+    ::testing::InitGoogleTest(&argc, argv);
+    xdi::SetTestLogger(xdi::createLogger("gtestWriteCombiner"));
+    return RUN_ALL_TESTS();
+}
@@ -337,6 +337,128 @@ TEST_F(TestWriteContextFixture, TestExclusiveAccess) {
     EXPECT_EQ(fds::block::WriteContext::ReadBlobResult::OK, ctx->addReadBlob(30, 35, nullptr, true));
 }
 
+// Test lookups with many disjoint ranges in flight
+// Every range should complete on its own
+TEST_F(TestWriteContextFixture, ManyDisjointRanges) {
+    for (xdi::ObjectOffsetVal start = 0; start < 300; start += 3) {
+        EXPECT_EQ(fds::block::WriteContext::ReadBlobResult::OK, ctx->addReadBlob(start, start + 1, nullptr, false));
+        EXPECT_TRUE(ctx->addPendingWrite(start, start + 1, nullptr));
+    }
+    EXPECT_EQ(100, ctx->getNumPendingBlobs());
+
+    // Nothing touching a range is available
+    EXPECT_EQ(fds::block::WriteContext::ReadBlobResult::UNAVAILABLE, ctx->addReadBlob(148, 152, nullptr, true));
+    EXPECT_EQ(fds::block::WriteContext::ReadBlobResult::UNAVAILABLE, ctx->addReadBlob(151, 151, nullptr, true));
+    EXPECT_FALSE(ctx->addPendingWrite(302, 310, nullptr));
+
+    xdi::WriteBlobRequest req;
+    fds::block::WriteContext::PendingTasks q;
+    ctx->updateOffset(150, "1");
+    EXPECT_FALSE(ctx->getWriteBlobRequest(150, req, q));
+    ctx->updateOffset(151, "2");
+    EXPECT_TRUE(ctx->getWriteBlobRequest(151, req, q));
+    ASSERT_EQ(2, req.blob.objects.size());
+    EXPECT_EQ("1", req.blob.objects[150].objectId);
+    EXPECT_EQ("2", req.blob.objects[151].objectId);
+    EXPECT_EQ(99, ctx->getNumPendingBlobs());
+
+    // A new range touching the awaiting range has to wait for it
+    EXPECT_EQ(fds::block::WriteContext::ReadBlobResult::PENDING, ctx->addReadBlob(151, 152, nullptr, false));
+    fds::block::WriteContext::PendingTasks awaitingQ;
+    ctx->completeBlobWrite(150, awaitingQ);
+    EXPECT_EQ(1, awaitingQ.size());
+
+    // The gaps between the ranges are still available
+    EXPECT_EQ(fds::block::WriteContext::ReadBlobResult::OK, ctx->addReadBlob(2, 2, nullptr, true));
+    EXPECT_EQ(fds::block::WriteContext::ReadBlobResult::OK, ctx->addReadBlob(296, 296, nullptr, true));
+}
+
+// Test a huge range updated as a whole
+// Only the offsets with their own update get split out
+TEST_F(TestWriteContextFixture, HugeRangeExtents) {
+    xdi::ObjectOffsetVal const end = 75000000;
+    EXPECT_EQ(fds::block::WriteContext::ReadBlobResult::OK, ctx->addReadBlob(0, end, nullptr, true));
+    EXPECT_TRUE(ctx->addPendingWrite(0, end, nullptr));
+
+    xdi::RequestHandle h1 {1, 0};
+    xdi::RequestHandle h2 {2, 0};
+    EXPECT_EQ(fds::block::WriteContext::QueueResult::FirstEntry, ctx->queue_update(1, end - 1, h1));
+    ctx->triggerWrite(1, end - 1);
+    // Range is already queued so this fails as a whole
+    EXPECT_EQ(fds::block::WriteContext::QueueResult::Failure, ctx->queue_update(0, 2, h2));
+    EXPECT_EQ(fds::block::WriteContext::QueueResult::FirstEntry, ctx->queue_update(0, h2));
+    EXPECT_EQ(fds::block::WriteContext::QueueResult::FirstEntry, ctx->queue_update(end, h2));
+    // Update on a single offset inside the range
+    EXPECT_EQ(fds::block::WriteContext::QueueResult::AddedEntry, ctx->queue_update(500, h2));
+
+    ctx->updateOffset(0, "1");
+    ctx->updateOffset(end, "1");
+    ctx->updateOffset(1, end - 1, "2");
+
+    xdi::WriteBlobRequest req;
+    fds::block::WriteContext::PendingTasks q;
+    EXPECT_FALSE(ctx->getWriteBlobRequest(0, req, q));
+    auto popped = ctx->pop(500);
+    EXPECT_TRUE(popped.first);
+    EXPECT_EQ(2, popped.second.handle);
+    EXPECT_FALSE(ctx->pop(501).first);
+    ctx->triggerWrite(500);
+    ctx->updateOffset(500, "3");
+
+    // Check the result on a smaller range as the request has an entry per object
+    EXPECT_EQ(1, ctx->getNumPendingBlobs());
+    EXPECT_TRUE(ctx->failWriteBlobRequest(end, q));
+    EXPECT_EQ(0, ctx->getNumPendingBlobs());
+
+    EXPECT_EQ(fds::block::WriteContext::ReadBlobResult::OK, ctx->addReadBlob(0, 9, nullptr, true));
+    EXPECT_TRUE(ctx->addPendingWrite(0, 9, nullptr));
+    EXPECT_EQ(fds::block::WriteContext::QueueResult::FirstEntry, ctx->queue_update(0, 9, h1));
+    EXPECT_EQ(fds::block::WriteContext::QueueResult::AddedEntry, ctx->queue_update(4, h2));
+    ctx->updateOffset(0, 9, "2");
+    EXPECT_FALSE(ctx->getWriteBlobRequest(4, req, q));
+    EXPECT_TRUE(ctx->pop(4).first);
+    ctx->updateOffset(4, "3");
+    EXPECT_TRUE(ctx->getWriteBlobRequest(4, req, q));
+    ASSERT_EQ(10, req.blob.objects.size());
+    for (xdi::ObjectOffsetVal i = 0; i < 10; ++i) {
+        EXPECT_EQ((4 == i) ? "3" : "2", req.blob.objects[i].objectId);
+    }
+}
+
+// The regions of a stripe form one range, the WriteBlob request and the
+// committed extents are in volume offsets
+TEST(WriteContextStripeTest, StripeRegions) {
+    // Regions of 4 objects over 2 stripes, this is stripe 1
+    fds::block::WriteContext ctx(1, path, OBJECTSIZE, 4, 2, 1);
+    xdi::RequestHandle h1 {1, 0};
+    EXPECT_EQ(fds::block::WriteContext::ReadBlobResult::OK, ctx.addReadBlob(5, 21, nullptr, true));
+    EXPECT_EQ(1, ctx.getNumPendingBlobs());
+    EXPECT_FALSE(ctx.isRangeAvailable(12, 15));
+    EXPECT_TRUE(ctx.addPendingWrite(5, 21, nullptr));
+    EXPECT_EQ(fds::block::WriteContext::QueueResult::FirstEntry, ctx.queue_update(5, 21, h1));
+    ctx.updateOffset(5, 21, "1");
+
+    xdi::WriteBlobRequest req;
+    fds::block::WriteContext::PendingTasks q;
+    EXPECT_TRUE(ctx.getWriteBlobRequest(13, req, q));
+    ASSERT_EQ(9, req.blob.objects.size());
+    std::vector<xdi::ObjectOffsetVal> offsets;
+    for (auto const& o : req.blob.objects) {
+        offsets.push_back(o.first);
+    }
+    EXPECT_EQ(std::vector<xdi::ObjectOffsetVal>({5, 6, 7, 12, 13, 14, 15, 20, 21}), offsets);
+
+    fds::block::WriteContext::ObjectExtents committed;
+    ctx.completeBlobWrite(21, q, committed);
+    ASSERT_EQ(3, committed.size());
+    EXPECT_EQ(5, committed[0].start);
+    EXPECT_EQ(3, committed[0].numObjects);
+    EXPECT_EQ(12, committed[1].start);
+    EXPECT_EQ(4, committed[1].numObjects);
+    EXPECT_EQ(20, committed[2].start);
+    EXPECT_EQ(2, committed[2].numObjects);
+}
+
 int main(int argc, char* argv[]) {
     ::testing::InitGoogleTest(&argc, argv);
     xdi::SetTestLogger(xdi::createLogger("gtestWriteContext"));